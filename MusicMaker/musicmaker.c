@@ -6,329 +6,2424 @@
 #include <string.h>
 #include <storage/storage.h>
 
-// Enumeration für die Notenwerte und Pausen
+#include "musicmaker_sheet.h"
+#include "musicmaker_midi.h"
+#include "musicmaker_voice.h"
+#include "musicmaker_song.h"
+#include "musicmaker_tone.h"
+
+#define TAG "MusicMaker"
+
+// Enumeration für den Anzeigemodus
+typedef enum {
+    ModeNotes, ModeMenu, ModeExit, ModePlay, ModeSave, ModeLoad, ModeSong, ModeRecord
+} DisplayMode;
+
+#define MAX_FILENAME_LENGTH 10
+#define NOTE_SPACING 15
+#define NOTE_X(index) ((index) * NOTE_SPACING + 10)
+#define NOTE_Y(note) (43 - 3 * (note)->step)
+#define NOTE_STORE_MIN_CAPACITY 32
+#define NOTE_STORE_HEAP_RESERVE 4096
+
+// Lückenpuffer für die Noten in einem zusammenhängenden Speicherblock. Die Lücke folgt
+// dem Cursor, so dass Einfügen und Löschen an der Cursorposition O(1) kosten.
+typedef struct {
+    Note* buffer;
+    uint32_t capacity;
+    uint32_t gap_start;
+    uint32_t gap_end;
+} NoteStore;
+
+// Änderungsjournal für Rückgängig/Wiederholen: ein Ring aus Einträgen zu je 8 Byte, die Größe muss
+// eine Zweierpotenz sein. Ist der Ring voll, wird die älteste Änderung überschrieben.
+#define EDIT_JOURNAL_SIZE 64
+_Static_assert((EDIT_JOURNAL_SIZE & (EDIT_JOURNAL_SIZE - 1)) == 0, "EDIT_JOURNAL_SIZE must be a power of two");
+
+typedef enum {
+    EditSet, EditInsert, EditDelete
+} EditOp;
+
+// Eintrag im Journal: Art, Muster und Index in einem Wort, dazu die Note vor und nach der Änderung.
+// Das Muster legt fest, zu welchem Muster eine Note an einer Mustergrenze wieder eingefügt wird,
+// bei EditSet bleibt es 0.
+typedef struct {
+    uint32_t op_index;
+    Note before;
+    Note after;
+} EditRecord;
+
+#define EDIT_RECORD(op, pattern, index) (((uint32_t)(index) << 7) | ((pattern) << 2) | (op))
+#define EDIT_OP(record) ((EditOp)((record)->op_index & 0x03))
+#define EDIT_PATTERN(record) (((record)->op_index >> 2) & 0x1F)
+#define EDIT_INDEX(record) ((record)->op_index >> 7)
+_Static_assert(SONG_PATTERNS_MAX <= 32, "EDIT_RECORD stores the pattern in 5 bits");
+
+typedef struct {
+    EditRecord records[EDIT_JOURNAL_SIZE];
+    uint32_t cursor;
+    uint32_t undo_count;
+    uint32_t redo_count;
+} EditJournal;
+
+// Puffergrößen für das Lesen und Schreiben der Notenblätter
+#define SHEET_DIRECTORY "/ext/apps_assets/musicmaker"
+#define SHEET_IO_BUFFER_SIZE 64
+#define SHEET_WRITE_BUFFER_SIZE 512
+#define SHEET_TEMP_SUFFIX ".tmp"
+
+// Speicherformate, im Speichermodus wechselt Links zwischen ihnen
 typedef enum {
-    NoteWhole, NoteHalf, NoteQuarter, NoteEighth, NoteSixteenth,
-    RestWhole, RestHalf, RestQuarter, RestEighth, RestSixteenth
-} NoteValue;
+    SaveFormatSheet, SaveFormatMidi, SaveFormatFmf, SaveFormatRtttl, SaveFormatCount
+} SaveFormat;
+
+static const char* const save_extensions[SaveFormatCount] = {SHEET_EXTENSION, MIDI_EXTENSION, FMF_EXTENSION, RTTTL_EXTENSION};
+
+// Lesepuffer für das blockweise Einlesen einer Datei
+typedef struct {
+    File* file;
+    uint8_t buffer[SHEET_IO_BUFFER_SIZE];
+    size_t length;
+    size_t offset;
+    uint32_t bytes_read;
+} SheetReader;
+
+// Schreibpuffer, geschrieben wird nur in ganzen Blöcken der SD-Karte
+typedef struct {
+    File* file;
+    uint8_t buffer[SHEET_WRITE_BUFFER_SIZE];
+    size_t length;
+    uint32_t bytes_written;
+    uint32_t writes;
+    bool ok;
+} SheetWriter;
+
+// Ladebildschirm: im Speicher liegen nur die sichtbaren Zeilen und einige Einträge davor und danach
+#define BROWSER_VISIBLE_ROWS 5
+#define BROWSER_PREFETCH 3
+#define BROWSER_WINDOW_SIZE (BROWSER_VISIBLE_ROWS + 2 * BROWSER_PREFETCH)
+#define BROWSER_NAME_LENGTH 64
+
+// Pfad eines Notenblattes, der Dateiname beginnt direkt hinter dem Verzeichnis
+#define SHEET_PATH_LENGTH (sizeof(SHEET_DIRECTORY) + BROWSER_NAME_LENGTH)
+#define SHEET_PATH_NAME(path) ((path) + sizeof(SHEET_DIRECTORY))
+
+// Index mit den Kenndaten aller Notenblätter, damit der Ladebildschirm keine Datei öffnen muss.
+// Die Datensätze haben eine feste Größe und werden direkt angesprungen und überschrieben. Der Kopf
+// hält einen Prüfwert über Namen und Größen im Verzeichnis, solange er stimmt, entfällt der Abgleich.
+#define SHEET_INDEX_PATH SHEET_DIRECTORY "/.index"
+#define SHEET_INDEX_MAGIC "MMIX"
+#define SHEET_INDEX_VERSION 2
+#define SHEET_INDEX_KEY_RESERVE 4096
+
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint8_t version;
+    uint8_t record_size;
+    uint32_t count;
+    uint32_t directory;
+} SheetIndexHeader;
+
+// Datensatz je Datei: Zeitstempel und Größe zum Erkennen von Änderungen, dann die Kenndaten des
+// Notenblattes. Ist valid 0, konnte die Datei nicht gelesen werden.
+typedef struct __attribute__((packed)) {
+    char name[BROWSER_NAME_LENGTH];
+    uint32_t timestamp;
+    uint32_t size;
+    uint32_t note_count;
+    uint32_t duration_ms;
+    uint16_t tempo_bpm;
+    uint8_t pattern_count;
+    uint8_t valid;
+} SheetIndexRecord;
+
+// Schlüssel je Datensatz, nur diese liegen für alle Dateien im Speicher
+typedef struct {
+    uint32_t hash;
+    uint32_t sort_key;
+    uint32_t record;
+    bool seen;
+} SheetIndexKey;
+
+// Sortierungen des Ladebildschirms, Links und Rechts wechseln zwischen ihnen
+typedef enum {
+    BrowserSortIndex, BrowserSortDate, BrowserSortLength, BrowserSortCount
+} BrowserSort;
+
+static const char* const browser_sort_titles[BrowserSortCount] = {"Files:", "Newest:", "Longest:"};
+
+// Ladebildschirm über dem Index: die Schlüssel aller Dateien werden im Speicher sortiert, die
+// Datensätze für das Fenster bei Bedarf aus dem geöffneten Index nachgelesen
+typedef struct {
+    Storage* storage;
+    File* index;
+    SheetIndexKey* keys;
+    int key_count;
+    int key_capacity;
+    int dropped;
+    BrowserSort sort;
+    char path[SHEET_PATH_LENGTH];
+    SheetIndexRecord rows[BROWSER_WINDOW_SIZE];
+    int first;
+    int count;
+    int selected;
+    int top;
+} FileBrowser;
+
+// Der Wiedergabe-Thread ruft die Lautsprecher-HAL und die Protokollausgabe auf, der freie Rest wird
+// in Debug-Builds beim Beenden protokolliert
+#define PLAYER_STACK_SIZE 2048
+#define PLAYER_QUEUE_SIZE 8
+#define PREVIEW_DURATION_MS 100
+#define FRAME_STATS_INTERVAL 64
+
+#define TEMPO_STEP_BPM 5
+#define SONG_VISIBLE_ROWS 5
+
+// Aufnahme: die fünf Tasten des Steuerkreuzes spielen fünf Stufen ab der Note unter dem Cursor,
+// quantisiert wird auf Sechzehntel. Pausen werden auf einen Takt gekürzt.
+#define RECORD_RING_SIZE 32
+#define RECORD_KEYS 5
+#define RECORD_REST_MAX_UNITS 16
+_Static_assert((RECORD_RING_SIZE & (RECORD_RING_SIZE - 1)) == 0, "RECORD_RING_SIZE must be a power of two");
+
+// Tastenereignis mit Zeitstempel in Millisekunden und Taktzyklus für die Latenzmessung
+typedef struct {
+    uint32_t tick;
+    uint32_t cycles;
+    uint8_t key;
+    uint8_t type;
+} RecordEvent;
+
+// Ringpuffer zwischen Eingabe-Callback und Hauptschleife mit genau einem Schreiber und einem Leser.
+// head schreibt nur der Callback, tail nur die Hauptschleife, daher braucht es weder Sperre noch
+// Speicheranforderung. Ist der Ring voll, wird das Ereignis verworfen und gezählt.
+typedef struct {
+    RecordEvent events[RECORD_RING_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+    uint32_t capture_cycles_max;
+} RecordRing;
+
+// Zustand der Aufnahme. Die zuletzt angeschlagene Note bleibt offen, bis der nächste Anschlag oder
+// das Ende der Aufnahme ihre Länge und die folgende Pause festlegt. Positionen in Sechzehnteln
+// zählen ab dem ersten Anschlag.
+typedef struct {
+    RecordRing ring;
+    uint8_t base_step;
+    int8_t octave;
+    uint8_t pattern;
+    bool pending;
+    bool released;
+    uint8_t pending_key;
+    uint32_t origin_tick;
+    uint32_t off_tick;
+    uint32_t written_units;
+    uint32_t notes;
+    uint32_t cut;
+    uint32_t latency_total_us;
+    uint32_t latency_max_us;
+    uint32_t latency_count;
+} Recorder;
+
+// Befehle für den Wiedergabe-Thread
+typedef enum {
+    PlayerCommandPlay, PlayerCommandPause, PlayerCommandStop, PlayerCommandSeek, PlayerCommandPreview, PlayerCommandExit
+} PlayerCommandType;
+
+// Bei PlayerCommandSeek gibt note_index die Richtung an (-1 oder 1), bei PlayerCommandPreview
+// hält ein Wert ungleich 0 den Ton bis zum nächsten Befehl
+typedef struct {
+    PlayerCommandType type;
+    int note_index;
+    Note note;
+} PlayerCommand;
+
+// Zustand des Wiedergabe-Threads
+typedef enum {
+    PlayerStopped, PlayerPlaying, PlayerPaused
+} PlayerState;
+
+// Zeitsteuerung des Sequenzers, alle Flanken liegen auf absoluten Ticks ab dem Anker
+typedef struct {
+    uint32_t anchor;
+    uint64_t position_us;
+    uint32_t deadline;
+    bool gate_open;
+    uint32_t edges;
+    uint32_t jitter_total;
+    uint32_t jitter_max;
+    int32_t drift_ms;
+    Note note;
+    uint64_t note_on_us;
+    uint32_t gate_us;
+    bool voice_active;
+    uint32_t voice_period_us;
+    uint32_t voice_deadline;
+    uint32_t voice_steps;
+    uint32_t voice_ticks;
+    uint32_t voice_cycles_total;
+    uint32_t voice_cycles_max;
+} SequencerTiming;
+
+// Struktur zur Verwaltung des Notenblattes
+typedef struct {
+    NoteStore notes;
+    Song song;
+    EditJournal journal;
+    int current_note_index;
+    int scroll_offset;
+    DisplayMode mode;
+    DisplayMode press_mode;
+    int menu_index;
+    int song_index;
+    char save_name[MAX_FILENAME_LENGTH];
+    int save_name_length;
+    int save_name_index;
+    SaveFormat save_format;
+    FileBrowser browser;
+    Recorder recorder;
+    FuriMutex* mutex;
+    FuriMessageQueue* input_queue;
+    FuriMessageQueue* player_queue;
+    FuriThread* player_thread;
+    ViewPort* view_port;
+    volatile PlayerState player_state;
+    volatile int play_index;
+    volatile uint32_t play_position;
+    SongCursor play_cursor;
+    int tempo_bpm;
+    int voice_preset;
+    SequencerTiming timing;
+    char status[24];
+    uint32_t frame_time_total;
+    uint32_t frame_time_max;
+    uint32_t frame_count;
+} NoteSheet;
+
+// Menu options
+const char* menu_options[] = {
+    "1. Play", "2. Save", "3. Load", "4. New", "5. Tempo", "6. Chord", "7. Sound", "8. Pattern", "9. Song", "10. Record",
+    "11. Undo", "12. Redo", "13. Exit"
+};
+#define MENU_TEMPO 4
+#define MENU_CHORD 5
+#define MENU_SOUND 6
+#define MENU_PATTERN 7
+#define MENU_OPTIONS_COUNT (sizeof(menu_options) / sizeof(menu_options[0]))
+#define MENU_VISIBLE_ROWS 6
+
+// Funktion zum Senden eines Befehls an den Wiedergabe-Thread
+void player_send(NoteSheet* sheet, PlayerCommandType type, int note_index) {
+    PlayerCommand command = {.type = type, .note_index = note_index};
+    furi_message_queue_put(sheet->player_queue, &command, FuriWaitForever);
+}
+
+// Funktion zum Abspielen eines kurzen Tons
+void play_short_sound(NoteSheet* sheet, Note* note) {
+    PlayerCommand command = {.type = PlayerCommandPreview, .note = *note};
+    furi_message_queue_put(sheet->player_queue, &command, 0);
+}
+
+// Funktion zum Ermitteln der Anzahl der Noten
+uint32_t note_store_count(const NoteStore* store) {
+    return store->capacity - (store->gap_end - store->gap_start);
+}
+
+// Funktion zum Zugriff auf eine Note über ihren Index
+Note* note_store_get(NoteStore* store, uint32_t index) {
+    return &store->buffer[index < store->gap_start ? index : index + (store->gap_end - store->gap_start)];
+}
+
+// Funktion zum Verschieben der Lücke, die Kosten entsprechen der zurückgelegten Strecke
+void note_store_move_gap(NoteStore* store, uint32_t index) {
+    if(index < store->gap_start) {
+        uint32_t count = store->gap_start - index;
+        memmove(&store->buffer[store->gap_end - count], &store->buffer[index], count * sizeof(Note));
+        store->gap_start -= count;
+        store->gap_end -= count;
+    } else if(index > store->gap_start) {
+        uint32_t count = index - store->gap_start;
+        memmove(&store->buffer[store->gap_start], &store->buffer[store->gap_end], count * sizeof(Note));
+        store->gap_start += count;
+        store->gap_end += count;
+    }
+}
+
+// Funktion zum Ändern der Kapazität, der Teil hinter der Lücke wandert an das neue Ende
+bool note_store_resize(NoteStore* store, uint32_t capacity) {
+    uint32_t tail = store->capacity - store->gap_end;
+    if(capacity > store->capacity) {
+        if(memmgr_heap_get_max_free_block() < capacity * sizeof(Note) + NOTE_STORE_HEAP_RESERVE) {
+            return false;
+        }
+        store->buffer = realloc(store->buffer, capacity * sizeof(Note));
+        memmove(&store->buffer[capacity - tail], &store->buffer[store->gap_end], tail * sizeof(Note));
+    } else {
+        memmove(&store->buffer[capacity - tail], &store->buffer[store->gap_end], tail * sizeof(Note));
+        store->buffer = realloc(store->buffer, capacity * sizeof(Note));
+    }
+    store->gap_end = capacity - tail;
+    store->capacity = capacity;
+    return true;
+}
+
+// Funktion zum Einfügen einer Note vor dem Index, gibt false zurück wenn der Speicher nicht reicht
+bool note_store_insert(NoteStore* store, uint32_t index, Note note) {
+    if(store->gap_start == store->gap_end && !note_store_resize(store, store->capacity * 2)) {
+        return false;
+    }
+    note_store_move_gap(store, index);
+    store->buffer[store->gap_start++] = note;
+    return true;
+}
+
+// Funktion zum Löschen der Note am Index, bei geringer Belegung wird der Block verkleinert
+void note_store_delete(NoteStore* store, uint32_t index) {
+    note_store_move_gap(store, index);
+    store->gap_end++;
+    if(store->capacity > NOTE_STORE_MIN_CAPACITY && note_store_count(store) < store->capacity / 4) {
+        note_store_resize(store, store->capacity / 2);
+    }
+}
+
+// Funktion zum Leeren des Speichers, es bleibt nur die Mindestgröße belegt
+void note_store_clear(NoteStore* store) {
+    free(store->buffer);
+    store->buffer = malloc(NOTE_STORE_MIN_CAPACITY * sizeof(Note));
+    store->capacity = NOTE_STORE_MIN_CAPACITY;
+    store->gap_start = 0;
+    store->gap_end = NOTE_STORE_MIN_CAPACITY;
+}
+
+// Funktion zum Freigeben des Speichers
+void note_store_free(NoteStore* store) {
+    free(store->buffer);
+    store->buffer = NULL;
+    store->capacity = 0;
+    store->gap_start = 0;
+    store->gap_end = 0;
+}
+
+// Funktion zum Leeren des Journals, etwa nach dem Laden eines anderen Blattes
+void journal_clear(EditJournal* journal) {
+    journal->cursor = 0;
+    journal->undo_count = 0;
+    journal->redo_count = 0;
+}
+
+// Funktion zum Aufzeichnen einer Änderung, verwirft alle wiederholbaren Einträge
+void journal_record(EditJournal* journal, EditOp op, uint8_t pattern, uint32_t index, Note before, Note after) {
+    if(op == EditSet && memcmp(&before, &after, sizeof(Note)) == 0) {
+        return;
+    }
+    EditRecord* record = &journal->records[journal->cursor & (EDIT_JOURNAL_SIZE - 1)];
+    record->op_index = EDIT_RECORD(op, pattern, index);
+    record->before = before;
+    record->after = after;
+    journal->cursor++;
+    journal->undo_count = MIN(journal->undo_count + 1, (uint32_t)EDIT_JOURNAL_SIZE);
+    journal->redo_count = 0;
+}
+
+// Funktion zum Einfügen einer Note in ein Muster, gibt false zurück wenn der Speicher nicht reicht
+bool sheet_insert_note(NoteSheet* sheet, uint8_t pattern, uint32_t index, Note note) {
+    if(!note_store_insert(&sheet->notes, index, note)) {
+        return false;
+    }
+    sheet->song.pattern_lengths[pattern]++;
+    return true;
+}
+
+// Funktion zum Löschen einer Note aus einem Muster
+void sheet_delete_note(NoteSheet* sheet, uint8_t pattern, uint32_t index) {
+    note_store_delete(&sheet->notes, index);
+    sheet->song.pattern_lengths[pattern]--;
+}
+
+// Funktion zum Anwenden eines Eintrags in eine Richtung, gibt false zurück wenn der Speicher nicht reicht
+bool journal_apply(NoteSheet* sheet, const EditRecord* record, bool undo) {
+    uint32_t index = EDIT_INDEX(record);
+    EditOp op = EDIT_OP(record);
+    if(op == EditSet) {
+        *note_store_get(&sheet->notes, index) = undo ? record->before : record->after;
+        return true;
+    }
+    if((op == EditInsert) == undo) {
+        sheet_delete_note(sheet, EDIT_PATTERN(record), index);
+        return true;
+    }
+    return sheet_insert_note(sheet, EDIT_PATTERN(record), index, op == EditInsert ? record->after : record->before);
+}
+
+// Funktion zum Erstellen eines neuen Notenblattes
+void new_note_sheet(NoteSheet* sheet) {
+    Note note = {.step = 1, .value = NoteWhole};
+    journal_clear(&sheet->journal);
+    note_store_clear(&sheet->notes);
+    song_init(&sheet->song);
+    sheet_insert_note(sheet, 0, 0, note);
+    sheet->current_note_index = 0;
+    sheet->scroll_offset = 0;
+}
+
+// Funktion zum Messen kurzer Zeiträume in Mikrosekunden
+uint32_t elapsed_us(uint32_t start_cycles) {
+    return (DWT->CYCCNT - start_cycles) / furi_hal_cortex_instructions_per_microsecond();
+}
+
+// Funktion zum Lesen eines Bytes, der Puffer wird bei Bedarf nachgeladen
+bool sheet_reader_next(SheetReader* reader, uint8_t* byte) {
+    if(reader->offset >= reader->length) {
+        reader->length = storage_file_read(reader->file, reader->buffer, sizeof(reader->buffer));
+        reader->offset = 0;
+        reader->bytes_read += reader->length;
+        if(reader->length == 0) {
+            return false;
+        }
+    }
+    *byte = reader->buffer[reader->offset++];
+    return true;
+}
+
+// Funktion zum Anhängen einer Note an das letzte Muster beim Laden, gibt false zurück wenn der
+// Speicher nicht reicht
+bool load_append_note(NoteSheet* sheet, Note note) {
+    return sheet_insert_note(sheet, sheet->song.pattern_count - 1, note_store_count(&sheet->notes), note);
+}
+
+// Funktion zum Lesen mehrerer Bytes, die in die Prüfsumme eingehen
+bool load_bytes(SheetReader* reader, void* data, size_t length, uint32_t* checksum) {
+    uint8_t* bytes = data;
+    for(size_t i = 0; i < length; i++) {
+        if(!sheet_reader_next(reader, &bytes[i])) {
+            return false;
+        }
+    }
+    *checksum = sheet_crc32(*checksum, bytes, length);
+    return true;
+}
+
+// Funktion zum Lesen des Song-Abschnitts ab Version 2, ältere Blätter bestehen aus einem Muster
+bool load_song(SheetReader* reader, const SheetHeader* header, Song* song, uint32_t* checksum) {
+    song_init(song);
+    if(header->version == SHEET_VERSION_FLAT) {
+        song->pattern_lengths[0] = header->note_count;
+        return true;
+    }
+    SongChunk chunk;
+    if(!load_bytes(reader, &chunk, sizeof(chunk), checksum) || chunk.pattern_count == 0 ||
+       chunk.pattern_count > SONG_PATTERNS_MAX || chunk.entry_count == 0 || chunk.entry_count > SONG_ENTRIES_MAX) {
+        return false;
+    }
+    song->pattern_count = chunk.pattern_count;
+    song->entry_count = chunk.entry_count;
+    return load_bytes(reader, song->pattern_lengths, chunk.pattern_count * sizeof(uint32_t), checksum) &&
+           load_bytes(reader, song->entries, chunk.entry_count * sizeof(SongEntry), checksum) &&
+           song_valid(song, header->note_count);
+}
+
+// Funktion zum Laden des Binärformats, liest die Datensätze einzeln durch den Puffer. Die Noten
+// werden Muster für Muster angehängt, abgeschnittene Muster werden entsprechend kürzer.
+bool load_binary_notes(NoteSheet* sheet, SheetReader* reader, const SheetHeader* header, uint32_t* skipped) {
+    uint32_t checksum = 0;
+    Song* song = &sheet->song;
+    if(!load_song(reader, header, song, &checksum)) {
+        return false;
+    }
+    // Die gespeicherte Länge eines Musters wird gelesen, bevor es beim Anhängen neu gezählt wird
+    uint8_t pattern = 0;
+    uint32_t pattern_end = song->pattern_lengths[0];
+    song->pattern_lengths[0] = 0;
+    for(uint32_t i = 0; i < header->note_count; i++) {
+        while(i == pattern_end) {
+            pattern_end += song->pattern_lengths[++pattern];
+            song->pattern_lengths[pattern] = 0;
+        }
+        uint8_t record[sizeof(SheetRecord)];
+        for(uint8_t j = 0; j < header->record_size; j++) {
+            uint8_t byte;
+            if(!sheet_reader_next(reader, &byte)) {
+                return false;
+            }
+            checksum = sheet_crc32(checksum, &byte, 1);
+            if(j < sizeof(record)) {
+                record[j] = byte;
+            }
+        }
+        Note note = sheet_record_note(record, MIN(header->record_size, sizeof(record)));
+        if(!sheet_insert_note(sheet, pattern, note_store_count(&sheet->notes), note)) {
+            (*skipped)++;
+        }
+    }
+    for(pattern++; pattern < song->pattern_count; pattern++) {
+        song->pattern_lengths[pattern] = 0;
+    }
+    return checksum == header->checksum;
+}
+
+// Funktion zum Importieren des alten Textformats "x,y,wert;" ohne die ganze Datei zu puffern
+bool load_text_notes(NoteSheet* sheet, SheetReader* reader, uint32_t* skipped) {
+    int fields[3] = {0, 0, 0};
+    int field = 0;
+    bool negative = false;
+    bool has_digits = false;
+    uint8_t byte;
+
+    while(sheet_reader_next(reader, &byte)) {
+        if(byte >= '0' && byte <= '9') {
+            if(field < 3) {
+                fields[field] = fields[field] * 10 + (byte - '0');
+            }
+            has_digits = true;
+        } else if(byte == '-') {
+            negative = true;
+        } else if(byte == ',' || byte == ';') {
+            if(field < 3 && negative) {
+                fields[field] = -fields[field];
+            }
+            negative = false;
+            field++;
+            if(byte == ';') {
+                if(field == 3 && has_digits) {
+                    uint8_t record[] = {y_position_step(fields[1]), fields[2] >= 0 ? fields[2] : NoteWhole};
+                    if(!load_append_note(sheet, sheet_record_note(record, sizeof(record)))) {
+                        (*skipped)++;
+                    }
+                }
+                fields[0] = fields[1] = fields[2] = 0;
+                field = 0;
+                has_digits = false;
+            }
+        } else if(byte != '\r' && byte != '\n' && byte != ' ') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Kontext für den MIDI-Import, Noten über den freien Speicher hinaus werden gezählt
+typedef struct {
+    NoteSheet* sheet;
+    uint32_t* skipped;
+} MidiImport;
+
+// Funktion zum Übernehmen einer Note aus dem MIDI-Parser
+void load_midi_note(void* context, Note note) {
+    MidiImport* import = context;
+    if(!load_append_note(import->sheet, note)) {
+        (*import->skipped)++;
+    }
+}
+
+// Funktion zum Importieren einer MIDI-Datei, der Parser liest sie Byte für Byte durch den Puffer
+bool load_midi_notes(NoteSheet* sheet, SheetReader* reader, uint32_t* skipped) {
+    MidiImport import = {.sheet = sheet, .skipped = skipped};
+    MidiReader midi;
+    midi_reader_init(&midi, load_midi_note, &import);
+
+    uint8_t byte;
+    while(midi.state != MidiStateDone && sheet_reader_next(reader, &byte)) {
+        if(!midi_reader_feed(&midi, byte)) {
+            return false;
+        }
+    }
+    if(!midi_reader_finish(&midi)) {
+        return false;
+    }
+    sheet->tempo_bpm = midi_reader_tempo_bpm(&midi);
+    FURI_LOG_D(TAG, "MIDI format %u, track %u, division %u, %u bytes parser state", midi.format, midi.track - 1, midi.division, sizeof(midi));
+    return true;
+}
+
+// Kontext für den Klingelton-Import, jeder Eintrag einer Sammlung wird zu einem eigenen Muster
+typedef struct {
+    NoteSheet* sheet;
+    uint32_t* skipped;
+} ToneImport;
+
+// Funktion zum Übernehmen einer Note aus dem Tokenizer, der erste Ton eines Eintrags legt sein Muster an
+void load_tone_note(void* context, uint32_t entry, Note note) {
+    ToneImport* import = context;
+    Song* song = &import->sheet->song;
+    if(entry >= song->pattern_count) {
+        song->pattern_lengths[song->pattern_count] = 0;
+        song->entries[song->entry_count].pattern = song->pattern_count;
+        song->entries[song->entry_count].repeat = 1;
+        song->pattern_count++;
+        song->entry_count++;
+    }
+    if(!load_append_note(import->sheet, note)) {
+        (*import->skipped)++;
+    }
+}
+
+// Funktion zum Importieren von RTTTL oder FMF, gelesen wird nur bis zum letzten Eintrag, der noch
+// ein freies Muster bekommt
+bool load_tone_notes(NoteSheet* sheet, SheetReader* reader, ToneFormat format, uint32_t* skipped) {
+    ToneImport import = {.sheet = sheet, .skipped = skipped};
+    ToneReader tone;
+    tone_reader_init(&tone, format, SONG_PATTERNS_MAX, load_tone_note, &import);
+
+    uint8_t byte;
+    while(tone.state != ToneStateDone && sheet_reader_next(reader, &byte)) {
+        tone_reader_feed(&tone, byte);
+    }
+    if(!tone_reader_finish(&tone)) {
+        return false;
+    }
+    sheet->tempo_bpm = tone_reader_tempo_bpm(&tone);
+    if(tone.entries > 1) {
+        snprintf(sheet->status, sizeof(sheet->status), "%s%lu songs", tone.state == ToneStateDone ? "First " : "", tone.entries);
+    }
+    FURI_LOG_D(TAG, "%s: %lu entries, %lu notes, %lu invalid tokens", format == ToneFormatFmf ? "FMF" : "RTTTL", tone.entries, tone.notes, tone.skipped);
+    return true;
+}
+
+// Funktion zum Einlesen einer geöffneten Datei in ein Notenblatt, das Format wird am Inhalt erkannt
+bool load_sheet_file(NoteSheet* sheet, File* file, uint32_t* skipped) {
+    uint32_t start = DWT->CYCCNT;
+    size_t heap_before = memmgr_get_free_heap();
+    SheetReader reader = {.file = file};
+    SheetHeader header;
+    const char* format = "binary";
+    ToneFormat tone_format;
+    bool success;
+
+    note_store_clear(&sheet->notes);
+    song_init(&sheet->song);
+    journal_clear(&sheet->journal);
+
+    // Den ersten Block einmal lesen und das Format an diesen Bytes erkennen. Sie bleiben im Puffer,
+    // so dass auch Dateien, die kürzer als der Kopf eines Binärblatts sind, vollständig gelesen werden.
+    reader.length = storage_file_read(file, reader.buffer, sizeof(reader.buffer));
+    reader.bytes_read = reader.length;
+    bool binary = reader.length >= sizeof(header) && memcmp(reader.buffer, SHEET_MAGIC, sizeof(header.magic)) == 0;
+    bool midi = reader.length >= strlen(MIDI_MAGIC) && memcmp(reader.buffer, MIDI_MAGIC, strlen(MIDI_MAGIC)) == 0;
+    bool tone = !binary && !midi && tone_detect(reader.buffer, reader.length, &tone_format);
+
+    if(binary) {
+        memcpy(&header, reader.buffer, sizeof(header));
+        reader.offset = sizeof(header);
+        success = header.version >= SHEET_VERSION_FLAT && header.version <= SHEET_VERSION &&
+                  header.record_size >= SHEET_RECORD_MIN_SIZE && load_binary_notes(sheet, &reader, &header, skipped);
+        if(success && header.tempo_bpm >= TEMPO_MIN_BPM && header.tempo_bpm <= TEMPO_MAX_BPM) {
+            sheet->tempo_bpm = header.tempo_bpm;
+        }
+    } else if(midi) {
+        format = "midi";
+        success = load_midi_notes(sheet, &reader, skipped);
+    } else if(tone) {
+        format = tone_format == ToneFormatFmf ? "fmf" : "rtttl";
+        success = load_tone_notes(sheet, &reader, tone_format, skipped);
+    } else {
+        format = "text";
+        success = load_text_notes(sheet, &reader, skipped);
+    }
+
+    FURI_LOG_I(
+        TAG,
+        "Loaded %lu notes in %u patterns from %lu bytes (%s) in %lu us, heap %u -> %u bytes free",
+        note_store_count(&sheet->notes),
+        sheet->song.pattern_count,
+        reader.bytes_read,
+        format,
+        elapsed_us(start),
+        heap_before,
+        memmgr_get_free_heap());
+    return success && note_store_count(&sheet->notes) > 0;
+}
+
+// Funktion zum Berechnen eines Streuwerts (FNV-1a) für die Suche nach Dateinamen im Index
+uint32_t sheet_index_hash(const char* name) {
+    uint32_t hash = 2166136261UL;
+    while(*name) {
+        hash = (hash ^ (uint8_t)*name++) * 16777619UL;
+    }
+    return hash;
+}
+
+// Funktion zum Lesen eines Datensatzes an seiner festen Position
+bool sheet_index_read(File* file, uint32_t record, SheetIndexRecord* entry) {
+    return storage_file_seek(file, sizeof(SheetIndexHeader) + record * sizeof(SheetIndexRecord), true) &&
+           storage_file_read(file, entry, sizeof(*entry)) == sizeof(*entry);
+}
+
+// Funktion zum Schreiben eines Datensatzes an seiner festen Position
+bool sheet_index_write(File* file, uint32_t record, const SheetIndexRecord* entry) {
+    return storage_file_seek(file, sizeof(SheetIndexHeader) + record * sizeof(SheetIndexRecord), true) &&
+           storage_file_write(file, entry, sizeof(*entry)) == sizeof(*entry);
+}
+
+// Funktion zum Schreiben des Dateikopfs mit der Anzahl der Datensätze und dem Prüfwert des
+// Verzeichnisses, 0 erzwingt beim nächsten Öffnen einen Abgleich
+bool sheet_index_write_header(File* file, uint32_t count, uint32_t directory) {
+    SheetIndexHeader header = {
+        .magic = SHEET_INDEX_MAGIC,
+        .version = SHEET_INDEX_VERSION,
+        .record_size = sizeof(SheetIndexRecord),
+        .count = count,
+        .directory = directory,
+    };
+    return storage_file_seek(file, 0, true) && storage_file_write(file, &header, sizeof(header)) == sizeof(header);
+}
+
+// Funktion zum Öffnen des Index, ein fehlender oder unlesbarer Index wird leer neu angelegt.
+// Gibt die Anzahl der Datensätze zurück oder -1, wenn die Datei nicht geöffnet werden kann.
+int sheet_index_open(Storage* storage, File* file, uint32_t* directory) {
+    storage_simply_mkdir(storage, SHEET_DIRECTORY);
+    if(!storage_file_open(file, SHEET_INDEX_PATH, FSAM_READ_WRITE, FSOM_OPEN_ALWAYS)) {
+        return -1;
+    }
+    SheetIndexHeader header;
+    if(storage_file_read(file, &header, sizeof(header)) == sizeof(header) &&
+       memcmp(header.magic, SHEET_INDEX_MAGIC, sizeof(header.magic)) == 0 && header.version == SHEET_INDEX_VERSION &&
+       header.record_size == sizeof(SheetIndexRecord) && header.count <= INT32_MAX / sizeof(SheetIndexRecord) &&
+       storage_file_size(file) >= sizeof(header) + (uint64_t)header.count * sizeof(SheetIndexRecord)) {
+        *directory = header.directory;
+        return header.count;
+    }
+    *directory = 0;
+    if(storage_file_seek(file, 0, true) && storage_file_truncate(file) && sheet_index_write_header(file, 0, 0)) {
+        return 0;
+    }
+    storage_file_close(file);
+    return -1;
+}
+
+// Funktion zum Eintragen der Kenndaten eines geladenen Notenblattes. Die Dauer wird je Muster einmal
+// summiert und mit den Wiederholungen verrechnet, ohne den Song auszurollen.
+void sheet_index_measure(NoteSheet* sheet, SheetIndexRecord* entry) {
+    Song* song = &sheet->song;
+    uint64_t duration_us = 0;
+    uint32_t index = 0;
+    for(uint8_t pattern = 0; pattern < song->pattern_count; pattern++) {
+        uint64_t pattern_us = 0;
+        for(uint32_t end = index + song->pattern_lengths[pattern]; index < end; index++) {
+            pattern_us += note_duration_us(note_store_get(&sheet->notes, index)->value, sheet->tempo_bpm);
+        }
+        duration_us += pattern_us * song_pattern_repeats(song, pattern);
+    }
+    entry->note_count = song_length(song);
+    entry->duration_ms = duration_us / 1000;
+    entry->tempo_bpm = sheet->tempo_bpm;
+    entry->pattern_count = song->pattern_count;
+    entry->valid = 1;
+}
+
+// Funktion zum Erfassen der Kenndaten einer Datei und des daraus geladenen Notenblattes. Ohne
+// Notenblatt wird die Datei als unlesbar eingetragen.
+void sheet_index_describe(NoteSheet* sheet, Storage* storage, const char* path, SheetIndexRecord* entry) {
+    FileInfo info;
+    uint32_t timestamp = 0;
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->name, sizeof(entry->name), "%s", SHEET_PATH_NAME(path));
+    if(storage_common_stat(storage, path, &info) == FSE_OK) {
+        entry->size = info.size;
+    }
+    storage_common_timestamp(storage, path, &timestamp);
+    entry->timestamp = timestamp;
+    if(sheet) {
+        sheet_index_measure(sheet, entry);
+    }
+}
+
+// Funktion zum Eintragen eines gerade gespeicherten oder geladenen Notenblattes, der Datensatz der
+// Datei wird überschrieben oder angehängt. Unveränderte Datensätze werden nicht neu geschrieben.
+void sheet_index_update(NoteSheet* sheet, Storage* storage, const char* path) {
+    uint32_t start = DWT->CYCCNT;
+    File* file = storage_file_alloc(storage);
+    uint32_t directory;
+    int count = sheet_index_open(storage, file, &directory);
+    if(count >= 0) {
+        SheetIndexRecord entry = {0};
+        SheetIndexRecord update;
+        int record = 0;
+        while(record < count && sheet_index_read(file, record, &entry) && strcmp(entry.name, SHEET_PATH_NAME(path)) != 0) {
+            record++;
+        }
+        sheet_index_describe(sheet, storage, path, &update);
+        bool changed = record == count || memcmp(&entry, &update, sizeof(entry)) != 0;
+        if(changed) {
+            sheet_index_write(file, record, &update);
+            if(record == count) {
+                sheet_index_write_header(file, count + 1, directory);
+            }
+        }
+        storage_file_close(file);
+        FURI_LOG_D(TAG, "Index %s record %d of %d in %lu us", changed ? "wrote" : "kept", record, count, elapsed_us(start));
+    }
+    storage_file_free(file);
+}
+
+// Funktion zum Laden der Noten aus einer Datei, der Index wird dabei gleich aktualisiert
+void load_notes(NoteSheet* sheet, const char* name) {
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    if(storage) {
+        char path[128];
+        snprintf(path, sizeof(path), "%s/%s", SHEET_DIRECTORY, name);
+
+        File* file = storage_file_alloc(storage);
+        if(storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+            uint32_t skipped = 0;
+            bool success = load_sheet_file(sheet, file, &skipped);
+            storage_file_close(file);
+
+            if(!success) {
+                new_note_sheet(sheet);
+                snprintf(sheet->status, sizeof(sheet->status), "Invalid sheet");
+            } else {
+                if(skipped > 0) {
+                    snprintf(sheet->status, sizeof(sheet->status), "Cut %lu notes", skipped);
+                }
+                sheet_index_update(sheet, storage, path);
+            }
+            sheet->current_note_index = 0;
+            sheet->scroll_offset = 0;
+        }
+        storage_file_free(file);
+        furi_record_close(RECORD_STORAGE);
+    }
+}
+
+// Zustand beim Auswerten eines Binärblatts für den Index, liegt wegen des Songs auf dem Heap
+typedef struct {
+    SheetReader reader;
+    SheetHeader header;
+    Song song;
+} SheetScan;
+
+// Funktion zum Auswerten eines Binärblatts ohne Notenspeicher: gelesen werden Kopf und
+// Song-Abschnitt, von den Datensätzen zählt nur der Notenwert für die Dauer, die Prüfsumme wird
+// mitgerechnet. Gibt false zurück, wenn die Datei kein Binärblatt ist.
+bool sheet_index_scan_binary(File* file, SheetIndexRecord* entry) {
+    SheetScan* scan = malloc(sizeof(SheetScan));
+    SheetReader* reader = &scan->reader;
+    SheetHeader* header = &scan->header;
+    memset(reader, 0, sizeof(*reader));
+    reader->file = file;
+    uint32_t checksum = 0;
+    bool binary = load_bytes(reader, header, sizeof(*header), &checksum) &&
+                  memcmp(header->magic, SHEET_MAGIC, sizeof(header->magic)) == 0;
+    checksum = 0;
+    if(!binary || header->version < SHEET_VERSION_FLAT || header->version > SHEET_VERSION ||
+       header->record_size < SHEET_RECORD_MIN_SIZE || !load_song(reader, header, &scan->song, &checksum)) {
+        free(scan);
+        return binary;
+    }
+    int tempo_bpm = header->tempo_bpm >= TEMPO_MIN_BPM && header->tempo_bpm <= TEMPO_MAX_BPM ? header->tempo_bpm :
+                                                                                              TEMPO_DEFAULT_BPM;
+    uint64_t duration_us = 0;
+    uint8_t pattern = 0;
+    uint32_t pattern_end = scan->song.pattern_lengths[0];
+    uint32_t repeats = song_pattern_repeats(&scan->song, 0);
+    bool complete = true;
+    for(uint32_t i = 0; i < header->note_count && complete; i++) {
+        while(i == pattern_end) {
+            pattern_end += scan->song.pattern_lengths[++pattern];
+            repeats = song_pattern_repeats(&scan->song, pattern);
+        }
+        uint8_t record[sizeof(SheetRecord)];
+        for(uint8_t j = 0; j < header->record_size && complete; j++) {
+            uint8_t byte;
+            complete = sheet_reader_next(reader, &byte);
+            checksum = sheet_crc32(checksum, &byte, 1);
+            if(j < sizeof(record)) {
+                record[j] = byte;
+            }
+        }
+        Note note = sheet_record_note(record, MIN(header->record_size, sizeof(record)));
+        duration_us += (uint64_t)note_duration_us(note.value, tempo_bpm) * repeats;
+    }
+    if(complete && checksum == header->checksum && header->note_count > 0) {
+        entry->note_count = song_length(&scan->song);
+        entry->duration_ms = duration_us / 1000;
+        entry->tempo_bpm = tempo_bpm;
+        entry->pattern_count = scan->song.pattern_count;
+        entry->valid = 1;
+    }
+    free(scan);
+    return true;
+}
+
+// Funktion zum Auswerten einer neuen oder geänderten Datei für den Index, das aktuelle Blatt bleibt
+// unberührt. Binärblätter werden nur durchgelesen, die übrigen Formate haben keinen Kopf mit den
+// Kenndaten und werden in ein eigenes Notenblatt geladen. Gekürzte Blätter gelten als unlesbar,
+// bis sie geladen werden.
+void sheet_index_scan(Storage* storage, const char* path, SheetIndexRecord* entry) {
+    sheet_index_describe(NULL, storage, path, entry);
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING) && !sheet_index_scan_binary(file, entry) &&
+       storage_file_seek(file, 0, true)) {
+        NoteSheet* scratch = malloc(sizeof(NoteSheet));
+        memset(scratch, 0, sizeof(NoteSheet));
+        scratch->tempo_bpm = TEMPO_DEFAULT_BPM;
+        uint32_t skipped = 0;
+        if(load_sheet_file(scratch, file, &skipped) && skipped == 0) {
+            sheet_index_measure(scratch, entry);
+        }
+        note_store_free(&scratch->notes);
+        free(scratch);
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+}
+
+// Funktion zum Prüfen, ob ein Verzeichniseintrag ladbar ist. Übersprungen werden Ordner, leere,
+// temporäre und versteckte Dateien wie der Index.
+bool browser_is_sheet(const char* name, const FileInfo* file_info) {
+    size_t name_length = strlen(name);
+    size_t suffix_length = strlen(SHEET_TEMP_SUFFIX);
+    bool temporary = name_length >= suffix_length && strcmp(name + name_length - suffix_length, SHEET_TEMP_SUFFIX) == 0;
+    return !file_info_is_dir(file_info) && file_info->size > 0 && !temporary && name[0] != '.';
+}
+
+// Funktion zum Ablesen des Sortierschlüssels aus einem Datensatz
+uint32_t browser_sort_key(BrowserSort sort, const SheetIndexRecord* entry) {
+    if(sort == BrowserSortDate) {
+        return entry->timestamp;
+    } else if(sort == BrowserSortLength) {
+        return entry->duration_ms;
+    }
+    return 0;
+}
+
+// Funktion zum Suchen eines Dateinamens über die Streuwerte, der Name wird am Datensatz geprüft.
+// Gibt den Schlüssel zurück oder -1.
+int browser_find(FileBrowser* browser, const char* name, uint32_t hash, SheetIndexRecord* entry) {
+    for(int i = 0; i < browser->key_count; i++) {
+        if(browser->keys[i].hash == hash && sheet_index_read(browser->index, browser->keys[i].record, entry) &&
+           strcmp(entry->name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Funktion zum Anlegen eines weiteren Schlüssels. Die Schlüssel wachsen mit dem Verzeichnis, nur
+// wenn der Speicher nicht mehr reicht, wird die Datei gezählt und -1 zurückgegeben.
+int browser_add_key(FileBrowser* browser) {
+    if(browser->key_count == browser->key_capacity) {
+        int capacity = MAX(16, browser->key_capacity * 2);
+        if(memmgr_heap_get_max_free_block() < capacity * sizeof(SheetIndexKey) + SHEET_INDEX_KEY_RESERVE) {
+            browser->dropped++;
+            return -1;
+        }
+        browser->key_capacity = capacity;
+        browser->keys = realloc(browser->keys, browser->key_capacity * sizeof(SheetIndexKey));
+    }
+    browser->keys[browser->key_count].record = browser->key_count;
+    browser->keys[browser->key_count].seen = false;
+    return browser->key_count++;
+}
+
+// Funktion zum Berechnen des Prüfwerts eines Verzeichnisses aus Namen und Größen der Notenblätter.
+// Die Einträge werden addiert, damit die Reihenfolge im Verzeichnis keine Rolle spielt.
+uint32_t browser_directory_check(File* dir, char* name, size_t name_size) {
+    FileInfo file_info;
+    uint32_t check = 1;
+    while(storage_dir_read(dir, &file_info, name, name_size)) {
+        if(browser_is_sheet(name, &file_info)) {
+            check += sheet_index_hash(name) ^ ((uint32_t)file_info.size * 2654435761UL);
+        }
+    }
+    return check == 0 ? 1 : check;
+}
+
+// Funktion zum Abgleichen des Index mit dem Verzeichnis. Zuerst wird nur das Verzeichnis gelesen,
+// stimmt sein Prüfwert mit dem gespeicherten überein, bleibt der Index wie er ist. Sonst werden die
+// Dateien über Namen und Größe zugeordnet, ausgewertet werden nur neue und in der Größe geänderte
+// Dateien; eine Änderung bei gleicher Größe zeigt erst das nächste Laden der Datei. Datensätze
+// gelöschter Dateien werden durch den letzten ersetzt.
+void browser_sync(FileBrowser* browser, int stored, uint32_t stored_directory) {
+    uint32_t start = DWT->CYCCNT;
+    int files = 0;
+    int scanned = 0;
+    int removed = 0;
+    uint32_t directory = 0;
+    File* dir = storage_file_alloc(browser->storage);
+    if(storage_dir_open(dir, SHEET_DIRECTORY)) {
+        FileInfo file_info;
+        char* name = SHEET_PATH_NAME(browser->path);
+        snprintf(browser->path, sizeof(browser->path), "%s/", SHEET_DIRECTORY);
+        directory = browser_directory_check(dir, name, BROWSER_NAME_LENGTH);
+        if(directory == stored_directory) {
+            storage_dir_close(dir);
+            storage_file_free(dir);
+            FURI_LOG_I(TAG, "Index unchanged: %d files checked in %lu us", browser->key_count, elapsed_us(start));
+            return;
+        }
+        storage_dir_rewind(dir);
+        while(storage_dir_read(dir, &file_info, name, BROWSER_NAME_LENGTH)) {
+            if(!browser_is_sheet(name, &file_info)) {
+                continue;
+            }
+            files++;
+            uint32_t hash = sheet_index_hash(name);
+            SheetIndexRecord entry;
+            int key = browser_find(browser, name, hash, &entry);
+            if(key < 0 || entry.size != file_info.size) {
+                if(key < 0 && (key = browser_add_key(browser)) < 0) {
+                    continue;
+                }
+                sheet_index_scan(browser->storage, browser->path, &entry);
+                sheet_index_write(browser->index, browser->keys[key].record, &entry);
+                browser->keys[key].hash = hash;
+                scanned++;
+            }
+            browser->keys[key].sort_key = browser_sort_key(browser->sort, &entry);
+            browser->keys[key].seen = true;
+        }
+        storage_dir_close(dir);
+    }
+    storage_file_free(dir);
+
+    // Die Schlüssel verweisen immer auf die Datensätze 0 bis key_count - 1
+    int records = browser->key_count;
+    for(int i = 0; i < browser->key_count;) {
+        if(browser->keys[i].seen) {
+            i++;
+            continue;
+        }
+        uint16_t hole = browser->keys[i].record;
+        SheetIndexRecord last;
+        records--;
+        if(hole != records && sheet_index_read(browser->index, records, &last) &&
+           sheet_index_write(browser->index, hole, &last)) {
+            for(int j = 0; j < browser->key_count; j++) {
+                if(browser->keys[j].record == records) {
+                    browser->keys[j].record = hole;
+                }
+            }
+        }
+        browser->keys[i] = browser->keys[--browser->key_count];
+        removed++;
+    }
+    // Fehlen Dateien mangels Speicher, wird beim nächsten Öffnen erneut abgeglichen
+    if(browser->dropped > 0) {
+        directory = 0;
+        FURI_LOG_W(TAG, "Index: no memory for %d of %d files", browser->dropped, files);
+    }
+    if(scanned > 0 || removed > 0 || browser->key_count != stored || directory != stored_directory) {
+        sheet_index_write_header(browser->index, browser->key_count, directory);
+        if(storage_file_seek(browser->index, sizeof(SheetIndexHeader) + browser->key_count * sizeof(SheetIndexRecord), true)) {
+            storage_file_truncate(browser->index);
+        }
+    }
+    FURI_LOG_I(
+        TAG, "Index synced: %d files, %d scanned, %d removed in %lu us", files, scanned, removed, elapsed_us(start));
+}
+
+// Funktion zum Vergleichen der Schlüssel, absteigend nach Sortierschlüssel, sonst nach Datensatz
+int browser_compare_keys(const void* a, const void* b) {
+    const SheetIndexKey* key_a = a;
+    const SheetIndexKey* key_b = b;
+    if(key_a->sort_key != key_b->sort_key) {
+        return key_a->sort_key < key_b->sort_key ? 1 : -1;
+    }
+    return key_a->record - key_b->record;
+}
+
+// Funktion zum Verschieben des Fensters auf einen neuen ersten Eintrag. Vorwärts werden die
+// vorhandenen Zeilen weitergeschoben, sonst werden die Datensätze aus dem Index nachgelesen.
+void browser_fill(FileBrowser* browser, int first) {
+    uint32_t start = DWT->CYCCNT;
+    int reads = 0;
+    int keep = 0;
+    if(first >= browser->first && first <= browser->first + browser->count) {
+        keep = browser->first + browser->count - first;
+        memmove(&browser->rows[0], &browser->rows[first - browser->first], keep * sizeof(SheetIndexRecord));
+    }
+    browser->first = first;
+    browser->count = keep;
+    while(browser->count < BROWSER_WINDOW_SIZE && first + browser->count < browser->key_count &&
+          sheet_index_read(browser->index, browser->keys[first + browser->count].record, &browser->rows[browser->count])) {
+        browser->count++;
+        reads++;
+    }
+    FURI_LOG_D(TAG, "Browser window %d+%d, %d records read in %lu us", first, browser->count, reads, elapsed_us(start));
+}
+
+// Funktion zum Sortieren der Schlüssel im Speicher, die Auswahl springt an den Anfang
+void browser_order(FileBrowser* browser) {
+    qsort(browser->keys, browser->key_count, sizeof(SheetIndexKey), browser_compare_keys);
+    browser->first = 0;
+    browser->count = 0;
+    browser->selected = 0;
+    browser->top = 0;
+    browser_fill(browser, 0);
+}
+
+// Funktion zum Sortieren nach einer anderen Kenngröße. Ohne Sortierschlüssel ergibt sich die
+// Reihenfolge im Index, in der die Schlüssel dann in einem Durchgang neu gelesen werden.
+void browser_sort(FileBrowser* browser, BrowserSort sort) {
+    SheetIndexRecord entry;
+    browser->sort = sort;
+    for(int i = 0; i < browser->key_count; i++) {
+        browser->keys[i].sort_key = 0;
+    }
+    if(sort != BrowserSortIndex) {
+        qsort(browser->keys, browser->key_count, sizeof(SheetIndexKey), browser_compare_keys);
+        for(int i = 0; i < browser->key_count; i++) {
+            if(sheet_index_read(browser->index, browser->keys[i].record, &entry)) {
+                browser->keys[i].sort_key = browser_sort_key(sort, &entry);
+            }
+        }
+    }
+    browser_order(browser);
+}
+
+// Funktion zum Öffnen des Ladebildschirms: der Index wird einmal der Reihe nach gelesen, mit dem
+// Verzeichnis abgeglichen und sortiert
+void browser_open(FileBrowser* browser) {
+    browser->storage = furi_record_open(RECORD_STORAGE);
+    browser->index = storage_file_alloc(browser->storage);
+    browser->keys = NULL;
+    browser->key_count = 0;
+    browser->key_capacity = 0;
+    browser->dropped = 0;
+    browser->first = 0;
+    browser->count = 0;
+    browser->selected = 0;
+    browser->top = 0;
+    uint32_t directory;
+    int records = sheet_index_open(browser->storage, browser->index, &directory);
+    if(records < 0) {
+        storage_file_free(browser->index);
+        browser->index = NULL;
+        furi_record_close(RECORD_STORAGE);
+        return;
+    }
+    SheetIndexRecord entry;
+    for(int record = 0; record < records && sheet_index_read(browser->index, record, &entry); record++) {
+        int key = browser_add_key(browser);
+        if(key < 0) {
+            // Ohne alle Schlüssel im Speicher gilt der Prüfwert nicht, der Abgleich zählt die fehlenden Dateien
+            browser->dropped = 0;
+            directory = 0;
+            break;
+        }
+        browser->keys[key].hash = sheet_index_hash(entry.name);
+        browser->keys[key].sort_key = browser_sort_key(browser->sort, &entry);
+    }
+    browser_sync(browser, records, directory);
+    browser_order(browser);
+}
+
+// Funktion zum Schließen des Index
+void browser_close(FileBrowser* browser) {
+    if(browser->index) {
+        storage_file_close(browser->index);
+        storage_file_free(browser->index);
+        furi_record_close(RECORD_STORAGE);
+        browser->index = NULL;
+        browser->count = 0;
+    }
+    free(browser->keys);
+    browser->keys = NULL;
+    browser->key_count = 0;
+    browser->key_capacity = 0;
+}
+
+// Funktion zum Auswählen eines Eintrags, das Fenster wird bei Bedarf nachgeladen.
+// Am letzten Eintrag bleibt die Auswahl stehen.
+void browser_select(FileBrowser* browser, int selected) {
+    if(selected < 0 || selected >= browser->key_count) {
+        return;
+    }
+    int top = MAX(MIN(browser->top, selected), selected - BROWSER_VISIBLE_ROWS + 1);
+    if(top < browser->first) {
+        browser_fill(browser, MAX(0, top - 2 * BROWSER_PREFETCH));
+    } else if(top + BROWSER_VISIBLE_ROWS + BROWSER_PREFETCH > browser->first + browser->count &&
+              browser->first + browser->count < browser->key_count) {
+        browser_fill(browser, MAX(0, top - BROWSER_PREFETCH));
+    }
+    if(selected < browser->first + browser->count) {
+        browser->selected = selected;
+        browser->top = top;
+    }
+}
+
+// Funktion zum Abfragen eines Datensatzes im Fenster
+const SheetIndexRecord* browser_row(FileBrowser* browser, int index) {
+    return index >= browser->first && index < browser->first + browser->count ? &browser->rows[index - browser->first] : NULL;
+}
+
+// Funktion zum Ändern des Tons
+void change_note_value(NoteSheet* sheet, Note* note, NoteValue new_value) {
+    note->value = new_value;
+    play_short_sound(sheet, note);
+}
+
+// Vorgerasterte Notensymbole (XBM), je Notenwert mit Hals nach unten und nach oben.
+// Der Versatz bezieht sich auf den Notenkopf bzw. bei Pausen auf die mittlere Notenlinie.
+typedef struct {
+    uint8_t width;
+    uint8_t height;
+    int8_t offset_x;
+    int8_t offset_y;
+    const uint8_t* bitmap;
+} NoteGlyph;
+
+static const uint8_t glyph_note_whole_bits[] = {0x1c, 0x22, 0x41, 0x41, 0x41, 0x22, 0x1c};
+static const uint8_t glyph_note_half_down_bits[] = {0x1c, 0x22, 0x41, 0x41, 0x41, 0x23, 0x1d, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01};
+static const uint8_t glyph_note_half_up_bits[] = {0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x5c, 0x62, 0x41, 0x41, 0x41, 0x22, 0x1c};
+static const uint8_t glyph_note_quarter_down_bits[] = {0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x3f, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01};
+static const uint8_t glyph_note_quarter_up_bits[] = {0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7f, 0x7f, 0x7f, 0x7f, 0x3f, 0x3f};
+static const uint8_t glyph_note_eighth_down_bits[] = {0xf8, 0x01, 0xf8, 0x01, 0xf8, 0x01, 0xf8, 0x01, 0xf8, 0x01, 0xf8, 0x01, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x04, 0x00, 0x02, 0x00, 0x01, 0x00};
+static const uint8_t glyph_note_eighth_up_bits[] = {0x00, 0x02, 0x00, 0x01, 0x80, 0x00, 0x40, 0x00, 0x40, 0x00, 0x40, 0x00, 0x40, 0x00, 0x40, 0x00, 0x40, 0x00, 0x40, 0x00, 0x7f, 0x00, 0x7f, 0x00, 0x7f, 0x00, 0x7f, 0x00, 0x3f, 0x00, 0x3f, 0x00};
+static const uint8_t glyph_note_sixteenth_down_bits[] = {0xf8, 0x01, 0xf8, 0x01, 0xf8, 0x01, 0xf8, 0x01, 0xf8, 0x01, 0xf8, 0x01, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x0c, 0x00, 0x0a, 0x00, 0x09, 0x00, 0x04, 0x00, 0x02, 0x00, 0x01, 0x00};
+static const uint8_t glyph_note_sixteenth_up_bits[] = {0x00, 0x02, 0x00, 0x01, 0x80, 0x00, 0x40, 0x02, 0x40, 0x01, 0xc0, 0x00, 0x40, 0x00, 0x40, 0x00, 0x40, 0x00, 0x40, 0x00, 0x7f, 0x00, 0x7f, 0x00, 0x7f, 0x00, 0x7f, 0x00, 0x3f, 0x00, 0x3f, 0x00};
+static const uint8_t glyph_rest_whole_bits[] = {0x3f, 0x3f};
+static const uint8_t glyph_rest_half_bits[] = {0x3f, 0x3f};
+static const uint8_t glyph_rest_quarter_bits[] = {0x0f, 0x0f, 0x0f, 0x0f};
+static const uint8_t glyph_rest_eighth_bits[] = {0x04, 0x04, 0x04, 0x04, 0x0f, 0x0f, 0x0f, 0x0f};
+static const uint8_t glyph_rest_sixteenth_bits[] = {0x01, 0x01, 0x06, 0x06, 0x04, 0x04, 0x0f, 0x0f, 0x0f, 0x0f};
+
+static const NoteGlyph note_glyphs[][2] = {
+    {{7, 7, -3, -3, glyph_note_whole_bits}, {7, 7, -3, -3, glyph_note_whole_bits}},
+    {{7, 14, -3, -3, glyph_note_half_down_bits}, {7, 14, -3, -10, glyph_note_half_up_bits}},
+    {{6, 14, -3, -3, glyph_note_quarter_down_bits}, {7, 13, -3, -10, glyph_note_quarter_up_bits}},
+    {{9, 17, -6, -3, glyph_note_eighth_down_bits}, {10, 16, -3, -13, glyph_note_eighth_up_bits}},
+    {{9, 17, -6, -3, glyph_note_sixteenth_down_bits}, {10, 16, -3, -13, glyph_note_sixteenth_up_bits}},
+    {{6, 2, -3, 2, glyph_rest_whole_bits}, {6, 2, -3, 2, glyph_rest_whole_bits}},
+    {{6, 2, -3, -2, glyph_rest_half_bits}, {6, 2, -3, -2, glyph_rest_half_bits}},
+    {{4, 4, -2, -2, glyph_rest_quarter_bits}, {4, 4, -2, -2, glyph_rest_quarter_bits}},
+    {{4, 8, -2, -6, glyph_rest_eighth_bits}, {4, 8, -2, -6, glyph_rest_eighth_bits}},
+    {{4, 10, -2, -8, glyph_rest_sixteenth_bits}, {4, 10, -2, -8, glyph_rest_sixteenth_bits}},
+};
+
+static const uint8_t glyph_sharp_bits[] = {0x0a, 0x1f, 0x0a, 0x1f, 0x0a};
+static const uint8_t glyph_chord_major_bits[] = {0x11, 0x1b, 0x15, 0x11, 0x11};
+static const uint8_t glyph_chord_minor_bits[] = {0x00, 0x0b, 0x15, 0x15, 0x15};
+static const uint8_t glyph_chord_seventh_bits[] = {0x1f, 0x10, 0x08, 0x04, 0x04};
+static const uint8_t* const chord_glyphs[] = {NULL, glyph_chord_major_bits, glyph_chord_minor_bits, glyph_chord_seventh_bits};
+static const uint8_t glyph_flat_bits[] = {0x01, 0x01, 0x01, 0x07, 0x05, 0x03};
+
+// Funktion zum Finden der ersten sichtbaren Note, die x-Position ergibt sich direkt aus dem Index
+int first_visible_note(NoteSheet* sheet) {
+    int offset = sheet->scroll_offset - NOTE_X(0);
+    return offset <= 0 ? 0 : (offset + NOTE_SPACING - 1) / NOTE_SPACING;
+}
+
+// Funktion zum Erfassen der Zeichenzeit, ausgegeben wird der Durchschnitt über mehrere Bilder
+void frame_stats_record(NoteSheet* sheet, uint32_t frame_us) {
+    sheet->frame_time_total += frame_us;
+    sheet->frame_time_max = MAX(sheet->frame_time_max, frame_us);
+    if(++sheet->frame_count == FRAME_STATS_INTERVAL) {
+        FURI_LOG_D(
+            TAG,
+            "Draw %lu notes: avg %lu us, max %lu us",
+            note_store_count(&sheet->notes),
+            sheet->frame_time_total / FRAME_STATS_INTERVAL,
+            sheet->frame_time_max);
+        sheet->frame_time_total = 0;
+        sheet->frame_time_max = 0;
+        sheet->frame_count = 0;
+    }
+}
+
+// Drawing the five lines on the canvas
+void draw_music_lines(Canvas* canvas, void* ctx) {
+    NoteSheet* sheet = (NoteSheet*)ctx;
+
+    canvas_clear(canvas);
+
+    if(sheet->mode == ModeMenu) {
+        int menu_top = MAX(0, sheet->menu_index - MENU_VISIBLE_ROWS + 1);
+        for(int i = menu_top; i < (int)MENU_OPTIONS_COUNT && i < menu_top + MENU_VISIBLE_ROWS; i++) {
+            int y_position = 10 + (i - menu_top) * 10;
+            if(i == sheet->menu_index) {
+                canvas_draw_str(canvas, 10, y_position, ">");
+            }
+            if(i == MENU_TEMPO) {
+                char tempo[20];
+                snprintf(tempo, sizeof(tempo), "%s: %d", menu_options[i], sheet->tempo_bpm);
+                canvas_draw_str(canvas, 20, y_position, tempo);
+            } else if(i == MENU_CHORD) {
+                char chord[20];
+                Note* current_note = note_store_get(&sheet->notes, sheet->current_note_index);
+                snprintf(chord, sizeof(chord), "%s: %s", menu_options[i], current_note->chord ? chord_names[current_note->chord] : "-");
+                canvas_draw_str(canvas, 20, y_position, chord);
+            } else if(i == MENU_SOUND) {
+                char sound[20];
+                snprintf(sound, sizeof(sound), "%s: %s", menu_options[i], voice_presets[sheet->voice_preset].name);
+                canvas_draw_str(canvas, 20, y_position, sound);
+            } else if(i == MENU_PATTERN) {
+                char pattern[20];
+                snprintf(
+                    pattern,
+                    sizeof(pattern),
+                    "%s: %c/%c",
+                    menu_options[i],
+                    'A' + song_pattern_at(&sheet->song, sheet->current_note_index),
+                    'A' + sheet->song.pattern_count - 1);
+                canvas_draw_str(canvas, 20, y_position, pattern);
+            } else {
+                canvas_draw_str(canvas, 20, y_position, menu_options[i]);
+            }
+        }
+    } else if(sheet->mode == ModeSave) {
+        canvas_draw_str(canvas, 10, 10, "Save as:");
+        canvas_draw_str(canvas, 10, 20, sheet->save_name);
+        int mark_x = 10 + sheet->save_name_index * 6;
+        canvas_draw_box(canvas, mark_x, 30, 6, 1);
+        char format[24];
+        snprintf(format, sizeof(format), "< Format: %s", save_extensions[sheet->save_format]);
+        canvas_draw_str(canvas, 10, 50, format);
+    } else if(sheet->mode == ModeLoad) {
+        FileBrowser* browser = &sheet->browser;
+        char line[32];
+        if(browser->dropped > 0) {
+            snprintf(line, sizeof(line), "< %s %d, %d hidden", browser_sort_titles[browser->sort], browser->key_count, browser->dropped);
+        } else {
+            snprintf(line, sizeof(line), "< %s %d", browser_sort_titles[browser->sort], browser->key_count);
+        }
+        canvas_draw_str(canvas, 10, 10, line);
+        for(int row = 0; row < BROWSER_VISIBLE_ROWS; row++) {
+            const SheetIndexRecord* entry = browser_row(browser, browser->top + row);
+            if(!entry) {
+                break;
+            }
+            if(browser->top + row == browser->selected) {
+                canvas_draw_str(canvas, 10, 20 + row * 10, ">");
+            }
+            canvas_draw_str(canvas, 20, 20 + row * 10, entry->name);
+            if(entry->valid) {
+                snprintf(line, sizeof(line), "%lu:%02lu", entry->duration_ms / 60000, entry->duration_ms / 1000 % 60);
+            } else {
+                snprintf(line, sizeof(line), "?");
+            }
+            canvas_draw_str_aligned(canvas, 124, 20 + row * 10, AlignRight, AlignBottom, line);
+        }
+        if(browser->key_count == 0) {
+            canvas_draw_str(canvas, 20, 20, "No sheets");
+        }
+    } else if(sheet->mode == ModeSong) {
+        Song* song = &sheet->song;
+        char line[24];
+        snprintf(line, sizeof(line), "Song: %lu notes", song_length(song));
+        canvas_draw_str(canvas, 10, 10, line);
+        int top = MAX(0, sheet->song_index - SONG_VISIBLE_ROWS + 1);
+        for(int i = top; i < song->entry_count && i < top + SONG_VISIBLE_ROWS; i++) {
+            int y_position = 20 + (i - top) * 10;
+            if(i == sheet->song_index) {
+                canvas_draw_str(canvas, 10, y_position, ">");
+            }
+            snprintf(line, sizeof(line), "%d. %c x%u", i + 1, 'A' + song->entries[i].pattern, song->entries[i].repeat);
+            canvas_draw_str(canvas, 20, y_position, line);
+        }
+    } else {
+        int start_y = 10;
+        int line_spacing = 6;
+
+        for(int i = 0; i < 5; i++) {
+            canvas_draw_line(canvas, 0, start_y + i * line_spacing, 128, start_y + i * line_spacing);
+        }
+
+        uint32_t frame_start = DWT->CYCCNT;
+        int total_notes = note_store_count(&sheet->notes);
+        int first_note = first_visible_note(sheet);
+        uint8_t pattern = song_pattern_at(&sheet->song, first_note);
+        uint32_t pattern_end = song_pattern_start(&sheet->song, pattern) + sheet->song.pattern_lengths[pattern];
+        for(int i = first_note; i < total_notes; i++) {
+            Note* note = note_store_get(&sheet->notes, i);
+            int x_position = NOTE_X(i) - sheet->scroll_offset;
+            if(x_position >= 128) {
+                break;
+            }
+
+            // Doppelter Taktstrich vor dem Anfang jedes weiteren Musters
+            if((uint32_t)i == pattern_end) {
+                canvas_draw_line(canvas, x_position - 11, start_y, x_position - 11, start_y + 4 * line_spacing);
+                canvas_draw_line(canvas, x_position - 9, start_y, x_position - 9, start_y + 4 * line_spacing);
+                while((uint32_t)i == pattern_end && pattern + 1 < sheet->song.pattern_count) {
+                    pattern_end += sheet->song.pattern_lengths[++pattern];
+                }
+            }
+
+            const NoteGlyph* glyph = &note_glyphs[note->value][NOTE_Y(note) > 25];
+            int y_position = note->value >= RestWhole ? start_y + 2 * line_spacing : NOTE_Y(note);
+            canvas_draw_xbm(canvas, x_position + glyph->offset_x, y_position + glyph->offset_y, glyph->width, glyph->height, glyph->bitmap);
+            if(note->value >= RestWhole) {
+                continue;
+            }
+            if(note->accidental == AccidentalSharp) {
+                canvas_draw_xbm(canvas, x_position - 9, y_position - 2, 5, 5, glyph_sharp_bits);
+            } else if(note->accidental == AccidentalFlat) {
+                canvas_draw_xbm(canvas, x_position - 8, y_position - 4, 3, 6, glyph_flat_bits);
+            }
+            // Oktavverschiebung als Punkte über bzw. unter den Notenlinien, Akkordzeichen ganz oben
+            for(int octave = 0; octave < abs(note->octave); octave++) {
+                canvas_draw_dot(canvas, x_position - 2 + 2 * octave, note->octave > 0 ? 6 : 48);
+            }
+            if(note->chord != ChordNone) {
+                canvas_draw_xbm(canvas, x_position - 2, 0, 5, 5, chord_glyphs[note->chord]);
+            }
+        }
+        frame_stats_record(sheet, elapsed_us(frame_start));
+
+        int current_x_position = NOTE_X(sheet->current_note_index) - sheet->scroll_offset;
+        if(current_x_position >= 0 && current_x_position < 128) {
+            canvas_draw_circle(canvas, current_x_position, 58, 2);
+        }
+
+        char note_number[24];
+        if(sheet->mode == ModePlay) {
+            int play_index = MIN(sheet->play_index, total_notes - 1);
+            int play_x_position = NOTE_X(play_index) - sheet->scroll_offset;
+            if(play_x_position >= 0 && play_x_position < 128) {
+                canvas_draw_line(canvas, play_x_position, start_y - 4, play_x_position, start_y + 4 * line_spacing + 4);
+            }
+            snprintf(
+                note_number,
+                sizeof(note_number),
+                "%s %lu/%lu",
+                sheet->player_state == PlayerPaused ? "Pause" : "Play",
+                sheet->play_position + 1,
+                song_length(&sheet->song));
+        } else if(sheet->mode == ModeRecord) {
+            Recorder* recorder = &sheet->recorder;
+            snprintf(
+                note_number,
+                sizeof(note_number),
+                "Rec %lu %lu/%lu us",
+                recorder->notes,
+                recorder->latency_count ? recorder->latency_total_us / recorder->latency_count : 0,
+                recorder->latency_max_us);
+        } else if(sheet->status[0] != '\0') {
+            snprintf(note_number, sizeof(note_number), "%s", sheet->status);
+        } else {
+            // Muster und Position im Muster, z.B. "Note: B:3 C#4 maj"
+            Note* current_note = note_store_get(&sheet->notes, sheet->current_note_index);
+            int midi = note_midi(current_note);
+            uint8_t current_pattern = song_pattern_at(&sheet->song, sheet->current_note_index);
+            int pattern_note = sheet->current_note_index - song_pattern_start(&sheet->song, current_pattern) + 1;
+            if(current_note->value < RestWhole && midi >= 0) {
+                snprintf(
+                    note_number,
+                    sizeof(note_number),
+                    "Note: %c:%d %s%d %s",
+                    'A' + current_pattern,
+                    pattern_note,
+                    pitch_names[midi % 12],
+                    midi / 12 - 1,
+                    chord_names[current_note->chord]);
+            } else {
+                snprintf(note_number, sizeof(note_number), "Note: %c:%d", 'A' + current_pattern, pattern_note);
+            }
+        }
+        canvas_draw_str(canvas, 0, 64, note_number);
+    }
+
+    canvas_commit(canvas);
+}
+
+// Funktion zum Starten eines Tons (Frequenz in Hz * 65536, Pegel in Q15), der Lautsprecher bleibt
+// bis player_release belegt. Erst hier wird für die HAL in float umgerechnet.
+void player_voice(uint32_t frequency_q16, uint16_t level) {
+    if(furi_hal_speaker_is_mine() || furi_hal_speaker_acquire(1000)) {
+        furi_hal_speaker_start(frequency_q16 / 65536.0f, level / (float)VOICE_LEVEL_MAX);
+    }
+}
+
+// Funktion zum Starten eines Tons mit vollem Pegel
+void player_note_on(uint32_t frequency_q16) {
+    player_voice(frequency_q16, VOICE_LEVEL_MAX);
+}
+
+// Funktion zum Stoppen des aktuellen Tons
+void player_note_off(void) {
+    if(furi_hal_speaker_is_mine()) {
+        furi_hal_speaker_stop();
+    }
+}
+
+// Funktion zum Freigeben des Lautsprechers
+void player_release(void) {
+    if(furi_hal_speaker_is_mine()) {
+        furi_hal_speaker_stop();
+        furi_hal_speaker_release();
+    }
+}
+
+// Funktion zum Verschieben der Ansicht, so dass die Note sichtbar ist
+void scroll_to_note(NoteSheet* sheet, int index) {
+    int x_position = NOTE_X(index);
+    if(x_position - sheet->scroll_offset > 128) {
+        sheet->scroll_offset = x_position - 128 + 10;
+    } else if(x_position - sheet->scroll_offset < 0) {
+        sheet->scroll_offset = x_position - 10;
+    }
+}
+
+// Funktion zum Setzen des Zeitankers, alle folgenden Flanken beziehen sich darauf
+void sequencer_anchor(SequencerTiming* timing, bool reset_stats) {
+    timing->anchor = furi_get_tick();
+    timing->position_us = 0;
+    timing->deadline = timing->anchor;
+    timing->gate_open = false;
+    timing->voice_active = false;
+    if(reset_stats) {
+        timing->edges = 0;
+        timing->jitter_total = 0;
+        timing->jitter_max = 0;
+        timing->drift_ms = 0;
+        timing->voice_ticks = 0;
+        timing->voice_cycles_total = 0;
+        timing->voice_cycles_max = 0;
+    }
+}
+
+// Funktion zum Umrechnen einer Songposition in einen absoluten Tick
+uint32_t sequencer_tick_at(SequencerTiming* timing, uint64_t position_us) {
+    return timing->anchor + (uint32_t)(position_us * furi_kernel_get_tick_frequency() / 1000000);
+}
+
+// Funktion zum Erfassen der Verspätung einer Flanke
+void sequencer_record_edge(SequencerTiming* timing, uint32_t late_ticks) {
+    uint32_t late_ms = late_ticks * 1000 / furi_kernel_get_tick_frequency();
+    timing->edges++;
+    timing->jitter_total += late_ms;
+    if(late_ms > timing->jitter_max) {
+        timing->jitter_max = late_ms;
+    }
+}
+
+// Funktion zum Beenden eines Songs mit Ausgabe der gemessenen Abweichungen
+void sequencer_finish(NoteSheet* sheet) {
+    SequencerTiming* timing = &sheet->timing;
+    uint32_t elapsed_ms = (furi_get_tick() - timing->anchor) * 1000 / furi_kernel_get_tick_frequency();
+    timing->drift_ms = (int32_t)(elapsed_ms - (uint32_t)(timing->position_us / 1000));
+    FURI_LOG_I(
+        TAG,
+        "%lu notes from %u patterns @ %d BPM: jitter avg %lu ms, max %lu ms, drift %ld ms",
+        sheet->play_position,
+        sheet->song.pattern_count,
+        sheet->tempo_bpm,
+        timing->edges ? timing->jitter_total / timing->edges : 0,
+        timing->jitter_max,
+        timing->drift_ms);
+    if(timing->voice_ticks > 0) {
+        FURI_LOG_I(
+            TAG,
+            "Voice %s: %lu ticks, avg %lu cycles, max %lu cycles (%lu us)",
+            voice_presets[sheet->voice_preset].name,
+            timing->voice_ticks,
+            timing->voice_cycles_total / timing->voice_ticks,
+            timing->voice_cycles_max,
+            timing->voice_cycles_max / furi_hal_cortex_instructions_per_microsecond());
+    }
+}
+
+// Funktion zum Einschalten einer Note. Arpeggio, Hüllkurve und Vibrato laufen danach in
+// Schritten, die wie die Notenflanken auf absoluten Zeitpunkten ab dem Einschalten liegen.
+void sequencer_voice_on(NoteSheet* sheet, Note note, uint32_t gate_us) {
+    SequencerTiming* timing = &sheet->timing;
+    const VoicePreset* preset = &voice_presets[sheet->voice_preset];
+    int midi = note_midi(&note);
+    bool sounding = note.value < RestWhole && midi >= 0;
+
+    timing->note = note;
+    timing->note_on_us = timing->position_us;
+    timing->gate_us = gate_us;
+    timing->voice_steps = 0;
+    timing->voice_period_us = voice_modulates(preset) ? VOICE_TICK_US : (note.chord != ChordNone ? ARPEGGIO_STEP_US : 0);
+    timing->voice_active = sounding && timing->voice_period_us > 0;
+    timing->voice_deadline = sequencer_tick_at(timing, timing->position_us + timing->voice_period_us);
+    if(sounding) {
+        player_voice(voice_frequency(preset, midi_frequencies[midi], 0), voice_level(preset, 0, gate_us));
+    } else {
+        player_note_off();
+    }
+}
+
+// Funktion für einen Modulationsschritt: wählt den Akkordton und berechnet Vibrato und Pegel,
+// nach dem Ausklingen wird der Lautsprecher abgeschaltet
+void sequencer_voice_tick(NoteSheet* sheet) {
+    SequencerTiming* timing = &sheet->timing;
+    const VoicePreset* preset = &voice_presets[sheet->voice_preset];
+    uint32_t start = DWT->CYCCNT;
+
+    timing->voice_steps++;
+    uint32_t since_on_us = timing->voice_steps * timing->voice_period_us;
+    uint8_t member = arpeggio_member(&timing->note, since_on_us);
+    uint32_t frequency = voice_frequency(preset, midi_frequencies[note_chord_midi(&timing->note, member)], since_on_us);
+    uint16_t level = voice_level(preset, since_on_us, timing->gate_us);
+    if(since_on_us >= timing->gate_us && level == 0) {
+        player_note_off();
+        timing->voice_active = false;
+    } else {
+        player_voice(frequency, level);
+    }
+    timing->voice_deadline = sequencer_tick_at(timing, timing->note_on_us + since_on_us + timing->voice_period_us);
+
+    uint32_t cycles = DWT->CYCCNT - start;
+    timing->voice_ticks++;
+    timing->voice_cycles_total += cycles;
+    if(cycles > timing->voice_cycles_max) {
+        timing->voice_cycles_max = cycles;
+    }
+}
+
+// Wiedergabe-Thread: arbeitet die Befehlswarteschlange ab und schaltet die Noten
+// an absoluten Zeitpunkten ein und aus, jeder Befehl unterbricht das Warten sofort.
+// Akkorde, Hüllkurve und Vibrato laufen in Zwischenschritten im selben Zeitraster.
+int32_t player_worker(void* ctx) {
+    NoteSheet* sheet = (NoteSheet*)ctx;
+    SequencerTiming* timing = &sheet->timing;
+    PlayerCommand command;
+    bool running = true;
+    bool previewing = false;
+
+    while(running) {
+        uint32_t timeout = FuriWaitForever;
+
+        if(sheet->player_state == PlayerPlaying) {
+            bool voice = timing->voice_active && (int32_t)(timing->voice_deadline - timing->deadline) < 0;
+            if(voice && (int32_t)(timing->voice_deadline - furi_get_tick()) <= 0) {
+                sequencer_voice_tick(sheet);
+                continue;
+            }
+            int32_t remaining = (int32_t)((voice ? timing->voice_deadline : timing->deadline) - furi_get_tick());
+            if(remaining <= 0) {
+                sequencer_record_edge(timing, -remaining);
+                if(timing->gate_open) {
+                    // Ausschaltflanke, die nächste Note beginnt am Ende der aktuellen. Mit
+                    // Ausklingzeit schaltet der letzte Modulationsschritt den Ton ab.
+                    if(voice_presets[sheet->voice_preset].release_us == 0 || !timing->voice_active) {
+                        player_note_off();
+                        timing->voice_active = false;
+                    }
+                    timing->gate_open = false;
+                    timing->deadline = sequencer_tick_at(timing, timing->position_us);
+                    furi_mutex_acquire(sheet->mutex, FuriWaitForever);
+                    song_cursor_next(&sheet->song, &sheet->play_cursor);
+                    sheet->play_position++;
+                    furi_mutex_release(sheet->mutex);
+                    continue;
+                }
+
+                furi_mutex_acquire(sheet->mutex, FuriWaitForever);
+                if(song_cursor_done(&sheet->song, &sheet->play_cursor)) {
+                    sequencer_finish(sheet);
+                    sheet->player_state = PlayerStopped;
+                    sheet->play_index = 0;
+                    if(sheet->mode == ModePlay) {
+                        sheet->mode = ModeNotes;
+                    }
+                    furi_mutex_release(sheet->mutex);
+                    player_release();
+                    view_port_update(sheet->view_port);
+                    continue;
+                }
+                sheet->play_index = song_cursor_index(&sheet->play_cursor);
+                Note note = *note_store_get(&sheet->notes, sheet->play_index);
+                scroll_to_note(sheet, sheet->play_index);
+                furi_mutex_release(sheet->mutex);
 
-// Enumeration für den Anzeigemodus
-typedef enum {
-    ModeNotes, ModeMenu, ModeExit, ModePlay, ModeSave, ModeLoad
-} DisplayMode;
+                // Einschaltflanke, die Ausschaltflanke folgt nach der klingenden Dauer
+                uint32_t duration_us = note_duration_us(note.value, sheet->tempo_bpm);
+                sequencer_voice_on(sheet, note, note_gate_us(duration_us));
+                timing->deadline = sequencer_tick_at(timing, timing->position_us + note_gate_us(duration_us));
+                timing->position_us += duration_us;
+                timing->gate_open = true;
+                view_port_update(sheet->view_port);
+                continue;
+            }
+            timeout = remaining;
+        } else if(previewing) {
+            timeout = PREVIEW_DURATION_MS;
+        }
 
-// Struktur zur Verwaltung der Noten
-typedef struct {
-    int32_t x_position;
-    int32_t y_position;
-    NoteValue value;
-} Note;
+        if(furi_message_queue_get(sheet->player_queue, &command, timeout) != FuriStatusOk) {
+            if(previewing) {
+                previewing = false;
+                player_release();
+            }
+            continue;
+        }
 
-// Maximale Anzahl der Noten
-#define MAX_NOTES 128
-#define MAX_FILENAME_LENGTH 10
-#define MAX_FILES 30
+        previewing = false;
+        switch(command.type) {
+            case PlayerCommandPlay:
+                if(sheet->player_state == PlayerStopped) {
+                    furi_mutex_acquire(sheet->mutex, FuriWaitForever);
+                    song_cursor_start(&sheet->song, &sheet->play_cursor);
+                    sheet->play_index = song_cursor_index(&sheet->play_cursor);
+                    sheet->play_position = 0;
+                    furi_mutex_release(sheet->mutex);
+                    sequencer_anchor(timing, true);
+                } else if(sheet->player_state == PlayerPaused) {
+                    sequencer_anchor(timing, false);
+                }
+                sheet->player_state = PlayerPlaying;
+                break;
+            case PlayerCommandPause:
+                if(sheet->player_state == PlayerPlaying) {
+                    sheet->player_state = PlayerPaused;
+                    player_release();
+                }
+                break;
+            case PlayerCommandStop:
+                sheet->player_state = PlayerStopped;
+                sheet->play_index = 0;
+                player_release();
+                break;
+            case PlayerCommandSeek: {
+                // Gesprungen wird im ausgerollten Song, über das letzte Muster hinaus nicht
+                furi_mutex_acquire(sheet->mutex, FuriWaitForever);
+                SongCursor cursor = sheet->play_cursor;
+                bool backward = command.note_index < 0;
+                bool moved = backward ? song_cursor_prev(&sheet->song, &cursor) : song_cursor_next(&sheet->song, &cursor);
+                moved = moved && sheet->player_state != PlayerStopped;
+                if(moved) {
+                    sheet->play_cursor = cursor;
+                    sheet->play_position = backward ? sheet->play_position - 1 : sheet->play_position + 1;
+                    sheet->play_index = song_cursor_index(&cursor);
+                }
+                furi_mutex_release(sheet->mutex);
+                if(moved && sheet->player_state == PlayerPlaying) {
+                    player_note_off();
+                    sequencer_anchor(timing, false);
+                }
+                break;
+            }
+            case PlayerCommandPreview:
+                if(sheet->player_state == PlayerStopped) {
+                    int midi = note_midi(&command.note);
+                    if(midi >= 0) {
+                        player_note_on(midi_frequencies[midi]);
+                        previewing = command.note_index == 0;
+                    } else {
+                        player_release();
+                    }
+                }
+                break;
+            case PlayerCommandExit:
+                running = false;
+                break;
+        }
+        view_port_update(sheet->view_port);
+    }
 
-// Struktur zur Verwaltung des Notenblattes
-typedef struct {
-    Note notes[MAX_NOTES];
-    int current_note_index;
-    int total_notes;
-    int scroll_offset;
-    DisplayMode mode;
-    int menu_index;
-    char save_name[MAX_FILENAME_LENGTH];
-    int save_name_length;
-    int save_name_index;
-    char* file_list[MAX_FILES];
-    int total_files;
-} NoteSheet;
+    player_release();
+#ifdef FURI_DEBUG
+    FURI_LOG_D(
+        TAG,
+        "Player stack: %lu of %u bytes never used",
+        furi_thread_get_stack_space(furi_thread_get_current_id()),
+        PLAYER_STACK_SIZE);
+#endif
+    return 0;
+}
 
-// Menu options
-const char* menu_options[] = {
-    "1. Play", "2. Save", "3. Load", "4. New", "5. Exit"
-};
-#define MENU_OPTIONS_COUNT (sizeof(menu_options) / sizeof(menu_options[0]))
+// Funktion zum Schreiben des Pufferinhalts in die Datei
+void sheet_writer_flush(SheetWriter* writer) {
+    if(writer->length > 0 && writer->ok) {
+        writer->ok = storage_file_write(writer->file, writer->buffer, writer->length) == writer->length;
+        writer->bytes_written += writer->length;
+        writer->writes++;
+    }
+    writer->length = 0;
+}
 
-// Frequenzen für die Noten (B3 bis F5)
-const float note_frequencies[] = {
-    246.94, 261.63, 293.66, 329.63, 349.23, 392.00, 440.00, 493.88, 523.25, 587.33, 659.25, 698.46
-};
+// Funktion zum gepufferten Schreiben, ein voller Puffer wird sofort geschrieben
+void sheet_writer_put(SheetWriter* writer, const void* data, size_t length) {
+    const uint8_t* bytes = data;
+    while(length > 0) {
+        size_t chunk = MIN(length, sizeof(writer->buffer) - writer->length);
+        memcpy(writer->buffer + writer->length, bytes, chunk);
+        writer->length += chunk;
+        bytes += chunk;
+        length -= chunk;
+        if(writer->length == sizeof(writer->buffer)) {
+            sheet_writer_flush(writer);
+        }
+    }
+}
 
-// Dauer für die Notenwerte (in Millisekunden)
-const int note_durations[] = {
-    1000, 500, 250, 125, 62
-};
+// Funktion zum Schreiben des Notenblattes im eigenen Binärformat, gespeichert werden die Muster
+// und die Reihenfolge, nicht der ausgerollte Song
+void save_sheet_content(NoteSheet* sheet, SheetWriter* writer) {
+    Song* song = &sheet->song;
+    bool flat = song_is_flat(song);
+    SongChunk chunk = {.pattern_count = song->pattern_count, .entry_count = song->entry_count};
+    SheetHeader header = {
+        .version = flat ? SHEET_VERSION_FLAT : SHEET_VERSION,
+        .record_size = sizeof(SheetRecord),
+        .tempo_bpm = sheet->tempo_bpm,
+        .note_count = note_store_count(&sheet->notes),
+    };
+    memcpy(header.magic, SHEET_MAGIC, sizeof(header.magic));
+    if(!flat) {
+        header.checksum = sheet_crc32(header.checksum, (uint8_t*)&chunk, sizeof(chunk));
+        header.checksum = sheet_crc32(header.checksum, (uint8_t*)song->pattern_lengths, chunk.pattern_count * sizeof(uint32_t));
+        header.checksum = sheet_crc32(header.checksum, (uint8_t*)song->entries, chunk.entry_count * sizeof(SongEntry));
+    }
+    for(uint32_t i = 0; i < header.note_count; i++) {
+        SheetRecord record = sheet_record(note_store_get(&sheet->notes, i));
+        header.checksum = sheet_crc32(header.checksum, (uint8_t*)&record, sizeof(record));
+    }
 
-// Funktion zum Abspielen eines Tons
-void play_sound(float frequency, uint32_t duration_ms) {
-    if(furi_hal_speaker_acquire(1000)) {
-        furi_hal_speaker_start(frequency, 1.0);
-        furi_delay_ms(duration_ms);
-        furi_hal_speaker_stop();
-        furi_hal_speaker_release();
+    sheet_writer_put(writer, &header, sizeof(header));
+    if(!flat) {
+        sheet_writer_put(writer, &chunk, sizeof(chunk));
+        sheet_writer_put(writer, song->pattern_lengths, chunk.pattern_count * sizeof(uint32_t));
+        sheet_writer_put(writer, song->entries, chunk.entry_count * sizeof(SongEntry));
+    }
+    for(uint32_t i = 0; i < header.note_count; i++) {
+        SheetRecord record = sheet_record(note_store_get(&sheet->notes, i));
+        sheet_writer_put(writer, &record, sizeof(record));
     }
 }
 
-// Funktion zum Abspielen eines kurzen Tons
-void play_short_sound(Note* note) {
-    int frequency_index = (43 - note->y_position) / 3;
-    if(frequency_index >= 0 && frequency_index < 12) {
-        play_sound(note_frequencies[frequency_index], 100);
+// Funktion zum Schreiben des Notenblattes als MIDI-Datei (Typ 0), die Spurlänge wird
+// vorab aus denselben Ereignissen berechnet. MIDI kennt keine Muster, der Song wird beim
+// Schreiben über den Cursor ausgerollt.
+void save_midi_content(NoteSheet* sheet, SheetWriter* writer) {
+    Song* song = &sheet->song;
+    SongCursor cursor;
+    uint32_t tempo_us = 60000000UL / sheet->tempo_bpm;
+    uint8_t events[MIDI_NOTE_EVENTS_MAX];
+    uint32_t delta = 0;
+    uint32_t track_length = 7 + 3;
+    for(song_cursor_start(song, &cursor); !song_cursor_done(song, &cursor); song_cursor_next(song, &cursor)) {
+        track_length += midi_note_events(note_store_get(&sheet->notes, song_cursor_index(&cursor)), &delta, events);
     }
+    track_length += midi_vlq(delta, events);
+
+    const uint8_t header[] = {
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, MIDI_EXPORT_DIVISION >> 8, MIDI_EXPORT_DIVISION & 0xFF,
+        'M', 'T', 'r', 'k', track_length >> 24, track_length >> 16, track_length >> 8, track_length,
+        0, 0xFF, 0x51, 3, tempo_us >> 16, tempo_us >> 8, tempo_us,
+    };
+    sheet_writer_put(writer, header, sizeof(header));
+    delta = 0;
+    for(song_cursor_start(song, &cursor); !song_cursor_done(song, &cursor); song_cursor_next(song, &cursor)) {
+        sheet_writer_put(
+            writer, events, midi_note_events(note_store_get(&sheet->notes, song_cursor_index(&cursor)), &delta, events));
+    }
+    sheet_writer_put(writer, events, midi_vlq(delta, events));
+    sheet_writer_put(writer, (const uint8_t[]){0xFF, 0x2F, 0}, 3);
 }
 
-// Funktion zum Freigeben des Speichers
-void free_memory(NoteSheet* sheet) {
-    for(int i = 0; i < sheet->total_files; i++) {
-        free(sheet->file_list[i]);
-        sheet->file_list[i] = NULL;
+// Funktion zum Schreiben des Notenblattes als RTTTL-Klingelton oder im Flipper Music Format, der
+// Song wird wie beim MIDI-Export beim Schreiben ausgerollt
+void save_tone_content(NoteSheet* sheet, SheetWriter* writer, ToneFormat format) {
+    Song* song = &sheet->song;
+    SongCursor cursor;
+    char text[TONE_HEADER_SIZE];
+    const char* separator = tone_separator(format);
+    sheet_writer_put(writer, text, tone_header(format, sheet->save_name, sheet->tempo_bpm, text, sizeof(text)));
+    for(song_cursor_start(song, &cursor); !song_cursor_done(song, &cursor);) {
+        sheet_writer_put(writer, text, tone_note_token(note_store_get(&sheet->notes, song_cursor_index(&cursor)), format, text));
+        if(song_cursor_next(song, &cursor)) {
+            sheet_writer_put(writer, separator, strlen(separator));
+        }
     }
-    sheet->total_files = 0;
+    sheet_writer_put(writer, "\n", 1);
 }
 
-// Funktion zum Laden der Noten aus einer Datei
-void load_notes(NoteSheet* sheet) {
-    const char* dir = "/ext/apps_assets/musicmaker";
+// Funktion zum Speichern der Noten in eine Datei, geschrieben wird in eine
+// temporäre Datei, die erst nach vollständigem Schreiben die alte ersetzt
+void save_notes(NoteSheet* sheet, SaveFormat format) {
     Storage* storage = furi_record_open(RECORD_STORAGE);
     if(storage) {
         char path[128];
-        snprintf(path, sizeof(path), "%s/%s", dir, sheet->file_list[sheet->menu_index]);
+        char temp_path[128];
+        snprintf(path, sizeof(path), "%s/%s%s", SHEET_DIRECTORY, sheet->save_name, save_extensions[format]);
+        snprintf(temp_path, sizeof(temp_path), "%s%s", path, SHEET_TEMP_SUFFIX);
 
-        File* file = storage_file_alloc(storage);
-        if(storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING)) {
-            sheet->total_notes = 0;
-            char buffer[4096];
-            int read = storage_file_read(file, buffer, sizeof(buffer) - 1);
-            if(read > 0) {
-                buffer[read] = '\0';
-                char* token = strtok(buffer, ";");
-                while(token != NULL && sheet->total_notes < MAX_NOTES) {
-                    int x_position, y_position, value;
-                    if(sscanf(token, "%d,%d,%d", &x_position, &y_position, &value) == 3) {
-                        Note* note = &sheet->notes[sheet->total_notes++];
-                        note->x_position = x_position;
-                        note->y_position = y_position;
-                        note->value = (NoteValue)value;
-                    }
-                    token = strtok(NULL, ";");
-                }
+        uint32_t start = DWT->CYCCNT;
+        storage_simply_mkdir(storage, SHEET_DIRECTORY);
+        SheetWriter* writer = malloc(sizeof(SheetWriter));
+        writer->file = storage_file_alloc(storage);
+        writer->length = 0;
+        writer->bytes_written = 0;
+        writer->writes = 0;
+        writer->ok = storage_file_open(writer->file, temp_path, FSAM_WRITE, FSOM_CREATE_ALWAYS);
+        if(writer->ok) {
+            if(format == SaveFormatMidi) {
+                save_midi_content(sheet, writer);
+            } else if(format == SaveFormatFmf || format == SaveFormatRtttl) {
+                save_tone_content(sheet, writer, format == SaveFormatFmf ? ToneFormatFmf : ToneFormatRtttl);
+            } else {
+                save_sheet_content(sheet, writer);
             }
-            sheet->current_note_index = 0;
-            storage_file_close(file);
+            sheet_writer_flush(writer);
+            writer->ok = storage_file_sync(writer->file) && writer->ok;
+            storage_file_close(writer->file);
         }
-        storage_file_free(file);
+        storage_file_free(writer->file);
+
+        bool ok = writer->ok;
+        if(ok) {
+            // Ältere Firmware überschreibt beim Umbenennen nicht
+            if(storage_common_rename(storage, temp_path, path) != FSE_OK) {
+                storage_common_remove(storage, path);
+                ok = storage_common_rename(storage, temp_path, path) == FSE_OK;
+            }
+        } else {
+            storage_common_remove(storage, temp_path);
+        }
+        if(ok) {
+            sheet_index_update(sheet, storage, path);
+        }
+
+        FURI_LOG_I(
+            TAG,
+            "Saved %lu notes in %u patterns (%lu bytes, %lu writes) in %lu us",
+            note_store_count(&sheet->notes),
+            sheet->song.pattern_count,
+            writer->bytes_written,
+            writer->writes,
+            elapsed_us(start));
+        snprintf(sheet->status, sizeof(sheet->status), "%s", ok ? (format != SaveFormatSheet ? "Exported" : "Saved") : "Save failed");
+
+        free(writer);
         furi_record_close(RECORD_STORAGE);
     }
 }
 
-// Funktion zum Auflisten der Dateien im Verzeichnis
-void list_files(NoteSheet* sheet) {
-    free_memory(sheet);
-    Storage* storage = furi_record_open(RECORD_STORAGE);
-    File* file = storage_file_alloc(storage);
-    sheet->total_files = 0;
+// Funktion zum Zuordnen der Spieltasten zu Stufen, von links nach rechts aufsteigend
+int record_key_index(InputKey key) {
+    switch(key) {
+        case InputKeyLeft:
+            return 0;
+        case InputKeyDown:
+            return 1;
+        case InputKeyOk:
+            return 2;
+        case InputKeyUp:
+            return 3;
+        case InputKeyRight:
+            return 4;
+        default:
+            return -1;
+    }
+}
 
-    const char* dir = "/ext/apps_assets/musicmaker";
+// Funktion zum Erfassen eines Tastenereignisses im Eingabe-Callback, blockiert nie
+void record_capture(RecordRing* ring, const InputEvent* input_event) {
+    uint32_t start = DWT->CYCCNT;
+    uint32_t head = ring->head;
+    if(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= RECORD_RING_SIZE) {
+        ring->dropped++;
+        return;
+    }
+    RecordEvent* event = &ring->events[head & (RECORD_RING_SIZE - 1)];
+    event->tick = furi_get_tick();
+    event->cycles = start;
+    event->key = input_event->key;
+    event->type = input_event->type;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    ring->capture_cycles_max = MAX(ring->capture_cycles_max, DWT->CYCCNT - start);
+}
 
-    if(storage_dir_open(file, dir)) {
-        FileInfo file_info;
-        char file_name[MAX_FILENAME_LENGTH];
+// Funktion zum Entnehmen des ältesten Ereignisses in der Hauptschleife
+bool record_ring_pop(RecordRing* ring, RecordEvent* event) {
+    uint32_t tail = ring->tail;
+    if(tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    *event = ring->events[tail & (RECORD_RING_SIZE - 1)];
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
 
-        while(storage_dir_read(file, &file_info, file_name, sizeof(file_name))) {
-            if(file_info.size > 0) {
-                sheet->file_list[sheet->total_files++] = strdup(file_name);
-            }
+// Funktion zum Runden eines Zeitpunkts auf das Sechzehntelraster beim aktuellen Tempo
+uint32_t record_units(NoteSheet* sheet, uint32_t tick) {
+    uint32_t unit_us = note_duration_us(NoteSixteenth, sheet->tempo_bpm);
+    return ((uint64_t)(tick - sheet->recorder.origin_tick) * 1000 + unit_us / 2) / unit_us;
+}
+
+// Funktion zum Eintragen einer Dauer in Sechzehnteln hinter dem Cursor. Wie beim Import wird der
+// nicht darstellbare Rest einer Note als Pause notiert.
+void record_emit(NoteSheet* sheet, Note note, bool rest, uint32_t units) {
+    Recorder* recorder = &sheet->recorder;
+    while(units > 0) {
+        uint8_t value = NoteWhole;
+        while((16U >> value) > units) {
+            value++;
+        }
+        note.value = rest ? value + RestWhole : value;
+        uint32_t index = sheet->current_note_index + 1;
+        if(sheet_insert_note(sheet, recorder->pattern, index, note)) {
+            journal_record(&sheet->journal, EditInsert, recorder->pattern, index, note, note);
+            sheet->current_note_index = index;
+        } else {
+            recorder->cut++;
         }
+        units -= 16U >> value;
+        rest = true;
+    }
+    scroll_to_note(sheet, sheet->current_note_index);
+}
 
-        storage_dir_close(file);
+// Funktion zum Abschließen der offenen Note. Sie endet beim Loslassen, spätestens beim nächsten
+// Anschlag, und dauert mindestens ein Sechzehntel; bis zum nächsten Anschlag folgt eine Pause.
+void record_flush(NoteSheet* sheet, uint32_t next_tick, bool has_next) {
+    Recorder* recorder = &sheet->recorder;
+    if(!recorder->pending) {
+        return;
     }
+    uint32_t off_tick = recorder->released ? recorder->off_tick : next_tick;
+    if(has_next && (int32_t)(off_tick - next_tick) > 0) {
+        off_tick = next_tick;
+    }
+    Note note = {.step = recorder->base_step + recorder->pending_key, .octave = recorder->octave};
+    uint32_t off = record_units(sheet, off_tick);
+    uint32_t units = off > recorder->written_units ? off - recorder->written_units : 1;
+    record_emit(sheet, note, false, units);
+    recorder->written_units += units;
+    if(has_next) {
+        uint32_t next = record_units(sheet, next_tick);
+        if(next > recorder->written_units) {
+            record_emit(sheet, note, true, MIN(next - recorder->written_units, (uint32_t)RECORD_REST_MAX_UNITS));
+            recorder->written_units = next;
+        }
+    }
+    recorder->notes++;
+    recorder->pending = false;
+}
 
-    storage_file_free(file);
-    furi_record_close(RECORD_STORAGE);
+// Funktion zum Auswerten der erfassten Ereignisse, angeschlagene Töne klingen bis zum Loslassen
+void record_drain(NoteSheet* sheet) {
+    Recorder* recorder = &sheet->recorder;
+    RecordEvent event;
+    while(record_ring_pop(&recorder->ring, &event)) {
+        uint32_t latency_us = elapsed_us(event.cycles);
+        recorder->latency_total_us += latency_us;
+        recorder->latency_max_us = MAX(recorder->latency_max_us, latency_us);
+        recorder->latency_count++;
+
+        int key = record_key_index(event.key);
+        if(event.type == InputTypePress) {
+            if(recorder->pending) {
+                record_flush(sheet, event.tick, true);
+            } else if(recorder->notes == 0) {
+                recorder->origin_tick = event.tick;
+            }
+            recorder->pending = true;
+            recorder->released = false;
+            recorder->pending_key = key;
+            PlayerCommand command = {
+                .type = PlayerCommandPreview,
+                .note_index = 1,
+                .note = {.step = recorder->base_step + key, .octave = recorder->octave, .value = NoteQuarter},
+            };
+            furi_message_queue_put(sheet->player_queue, &command, 0);
+        } else if(recorder->pending && !recorder->released && key == recorder->pending_key) {
+            recorder->released = true;
+            recorder->off_tick = event.tick;
+            PlayerCommand command = {.type = PlayerCommandStop};
+            furi_message_queue_put(sheet->player_queue, &command, 0);
+        }
+    }
 }
 
-// Funktion zum Erstellen eines neuen Notenblattes
-void new_note_sheet(NoteSheet* sheet) {
-    sheet->total_notes = 1;
-    sheet->current_note_index = 0;
-    sheet->scroll_offset = 0;
-    sheet->notes[0].x_position = 10;
-    sheet->notes[0].y_position = 40;
-    sheet->notes[0].value = NoteWhole;
+// Funktion zum Starten der Aufnahme hinter der Note unter dem Cursor, deren Stufe die tiefste Taste ist
+void record_start(NoteSheet* sheet) {
+    Recorder* recorder = &sheet->recorder;
+    Note* current_note = note_store_get(&sheet->notes, sheet->current_note_index);
+    memset(recorder, 0, sizeof(Recorder));
+    recorder->base_step = MIN(current_note->step, NOTE_STEP_MAX - (RECORD_KEYS - 1));
+    recorder->octave = current_note->octave;
+    recorder->pattern = song_pattern_at(&sheet->song, sheet->current_note_index);
+    sheet->status[0] = '\0';
+    sheet->mode = ModeRecord;
 }
 
-// Funktion zum Ändern des Tons
-void change_note_value(Note* note, NoteValue new_value) {
-    note->value = new_value;
-    play_short_sound(note);
+// Funktion zum Beenden der Aufnahme, die offene Note endet jetzt bzw. beim Loslassen
+void record_stop(NoteSheet* sheet) {
+    Recorder* recorder = &sheet->recorder;
+    record_drain(sheet);
+    record_flush(sheet, furi_get_tick(), false);
+    player_send(sheet, PlayerCommandStop, 0);
+    sheet->mode = ModeNotes;
+    FURI_LOG_I(
+        TAG,
+        "Recorded %lu notes from %lu events, latency %lu us avg %lu us max, capture %lu cycles max, %lu dropped",
+        recorder->notes,
+        recorder->latency_count,
+        recorder->latency_count ? recorder->latency_total_us / recorder->latency_count : 0,
+        recorder->latency_max_us,
+        recorder->ring.capture_cycles_max,
+        recorder->ring.dropped);
+    if(recorder->cut > 0 || recorder->ring.dropped > 0) {
+        snprintf(sheet->status, sizeof(sheet->status), "Cut %lu notes", recorder->cut + recorder->ring.dropped);
+    } else {
+        snprintf(sheet->status, sizeof(sheet->status), "Recorded %lu notes", recorder->notes);
+    }
 }
 
-// Drawing the five lines on the canvas
-void draw_music_lines(Canvas* canvas, void* ctx) {
-    NoteSheet* sheet = (NoteSheet*)ctx;
+// Funktion zum chromatischen Verschieben einer Note innerhalb der Notenlinien, Vorzeichen werden
+// als Kreuz notiert; gibt false zurück wenn der Ton außerhalb der Notenlinien oder des MIDI-Bereichs läge
+bool note_transpose(Note* note, int semitones) {
+    Note base = {.step = note->step, .accidental = note->accidental};
+    int pitch = note_midi(&base) + semitones;
+    for(uint8_t step = 0; step <= NOTE_STEP_MAX; step++) {
+        if(staff_pitches[step] == pitch || staff_pitches[step] + 1 == pitch) {
+            Note transposed = *note;
+            transposed.step = step;
+            transposed.accidental = staff_pitches[step] == pitch ? AccidentalNone : AccidentalSharp;
+            if(note_midi(&transposed) < 0) {
+                return false;
+            }
+            *note = transposed;
+            return true;
+        }
+    }
+    return false;
+}
 
-    canvas_clear(canvas);
+// Funktion zum Verschieben einer Note um eine Oktave, solange sie im MIDI-Bereich bleibt
+bool note_shift_octave(Note* note, int direction) {
+    Note shifted = *note;
+    int octave = note->octave + direction;
+    if(octave < -8 || octave > 7) {
+        return false;
+    }
+    shifted.octave = octave;
+    if(note_midi(&shifted) < 0) {
+        return false;
+    }
+    *note = shifted;
+    return true;
+}
 
-    if(sheet->mode == ModeMenu) {
-        for(int i = 0; i < (int)MENU_OPTIONS_COUNT; i++) {
-            if(i == sheet->menu_index) {
-                canvas_draw_str(canvas, 10, 10 + i * 10, ">");
-            }
-            canvas_draw_str(canvas, 20, 10 + i * 10, menu_options[i]);
+// Funktion zur Eingabe im Notenmodus: Hoch/Runter kurz um einen Halbton, lang um eine Oktave
+void process_notes_input(NoteSheet* sheet, InputEvent* input_event) {
+    Note* current_note = note_store_get(&sheet->notes, sheet->current_note_index);
+    Note before = *current_note;
+    int total_notes = note_store_count(&sheet->notes);
+    uint8_t pattern = song_pattern_at(&sheet->song, sheet->current_note_index);
+    int direction = input_event->key == InputKeyUp ? 1 : -1;
+
+    sheet->status[0] = '\0';
+    if(input_event->type == InputTypeLong) {
+        if(note_shift_octave(current_note, direction)) {
+            play_short_sound(sheet, current_note);
         }
-    } else if(sheet->mode == ModeSave) {
-        canvas_draw_str(canvas, 10, 10, "Save as:");
-        canvas_draw_str(canvas, 10, 20, sheet->save_name);
-        int mark_x = 10 + sheet->save_name_index * 6;
-        canvas_draw_box(canvas, mark_x, 30, 6, 1);
-    } else if(sheet->mode == ModeLoad) {
-        canvas_draw_str(canvas, 10, 10, "Files:");
-        for(int i = 0; i < sheet->total_files; i++) {
-            if(i == sheet->menu_index) {
-                canvas_draw_str(canvas, 10, 20 + i * 10, ">");
+    } else if(note_transpose(current_note, direction)) {
+        play_short_sound(sheet, current_note);
+    } else if(direction < 0) {
+        if(current_note->value < RestWhole) {
+            current_note->value = (NoteValue)((int)current_note->value + RestWhole);
+        } else if(sheet->song.pattern_lengths[pattern] > 1) {
+            // Ein Muster behält immer mindestens eine Note
+            sheet_delete_note(sheet, pattern, sheet->current_note_index);
+            journal_record(&sheet->journal, EditDelete, pattern, sheet->current_note_index, before, before);
+            if(sheet->current_note_index >= total_notes - 1) {
+                sheet->current_note_index = total_notes - 2;
             }
-            canvas_draw_str(canvas, 20, 20 + i * 10, sheet->file_list[i]);
+            return;
+        } else {
+            Note note = {.step = 0, .value = NoteWhole};
+            *current_note = note;
         }
+    }
+    journal_record(&sheet->journal, EditSet, 0, sheet->current_note_index, before, *current_note);
+}
+
+// Funktion zum Rückgängigmachen bzw. Wiederholen der letzten Änderung, der Cursor springt an ihre Stelle
+void journal_step(NoteSheet* sheet, bool undo) {
+    EditJournal* journal = &sheet->journal;
+    if(undo ? journal->undo_count == 0 : journal->redo_count == 0) {
+        snprintf(sheet->status, sizeof(sheet->status), "%s", undo ? "Nothing to undo" : "Nothing to redo");
+        return;
+    }
+    uint32_t position = undo ? journal->cursor - 1 : journal->cursor;
+    const EditRecord* record = &journal->records[position & (EDIT_JOURNAL_SIZE - 1)];
+    if(!journal_apply(sheet, record, undo)) {
+        snprintf(sheet->status, sizeof(sheet->status), "Out of memory");
+        return;
+    }
+    if(undo) {
+        journal->cursor--;
+        journal->undo_count--;
+        journal->redo_count++;
     } else {
-        int start_y = 10;
-        int line_spacing = 6;
+        journal->cursor++;
+        journal->undo_count++;
+        journal->redo_count--;
+    }
 
-        for(int i = 0; i < 5; i++) {
-            canvas_draw_line(canvas, 0, start_y + i * line_spacing, 128, start_y + i * line_spacing);
-        }
+    int total_notes = note_store_count(&sheet->notes);
+    sheet->current_note_index = MIN((int)EDIT_INDEX(record), total_notes - 1);
+    scroll_to_note(sheet, sheet->current_note_index);
+    snprintf(sheet->status, sizeof(sheet->status), "%s %lu/%lu", undo ? "Undo" : "Redo", journal->undo_count, journal->undo_count + journal->redo_count);
+}
 
-        for(int i = 0; i < sheet->total_notes; i++) {
-            Note* note = &sheet->notes[i];
-            int x_position = note->x_position - sheet->scroll_offset;
-
-            if(x_position >= 0 && x_position < 128) {
-                switch(note->value) {
-                    case NoteWhole:
-                        canvas_draw_circle(canvas, x_position, note->y_position, 3);
-                        break;
-                    case NoteHalf:
-                        canvas_draw_circle(canvas, x_position, note->y_position, 3);
-                        if(note->y_position <= 25) {
-                            canvas_draw_line(canvas, x_position - 3, note->y_position, x_position - 3, note->y_position + 10);
-                        } else {
-                            canvas_draw_line(canvas, x_position + 3, note->y_position, x_position + 3, note->y_position - 10);
-                        }
-                        break;
-                    case NoteQuarter:
-                        canvas_draw_box(canvas, x_position - 3, note->y_position - 3, 6, 6);
-                        if(note->y_position <= 25) {
-                            canvas_draw_line(canvas, x_position - 3, note->y_position, x_position - 3, note->y_position + 10);
-                        } else {
-                            canvas_draw_line(canvas, x_position + 3, note->y_position, x_position + 3, note->y_position - 10);
-                        }
-                        break;
-                    case NoteEighth:
-                        canvas_draw_box(canvas, x_position - 3, note->y_position - 3, 6, 6);
-                        if(note->y_position <= 25) {
-                            canvas_draw_line(canvas, x_position - 3, note->y_position, x_position - 3, note->y_position + 10);
-                            canvas_draw_line(canvas, x_position - 3, note->y_position + 10, x_position - 6, note->y_position + 13);
-                        } else {
-                            canvas_draw_line(canvas, x_position + 3, note->y_position, x_position + 3, note->y_position - 10);
-                            canvas_draw_line(canvas, x_position + 3, note->y_position - 10, x_position + 6, note->y_position - 13);
-                        }
-                        break;
-                    case NoteSixteenth:
-                        canvas_draw_box(canvas, x_position - 3, note->y_position - 3, 6, 6);
-                        if(note->y_position <= 25) {
-                            canvas_draw_line(canvas, x_position - 3, note->y_position, x_position - 3, note->y_position + 10);
-                            canvas_draw_line(canvas, x_position - 3, note->y_position + 10, x_position - 6, note->y_position + 13);
-                            canvas_draw_line(canvas, x_position - 3, note->y_position + 7, x_position - 6, note->y_position + 10);
-                        } else {
-                            canvas_draw_line(canvas, x_position + 3, note->y_position, x_position + 3, note->y_position - 10);
-                            canvas_draw_line(canvas, x_position + 3, note->y_position - 10, x_position + 6, note->y_position - 13);
-                            canvas_draw_line(canvas, x_position + 3, note->y_position - 7, x_position + 6, note->y_position - 10);
-                        }
-                        break;
-                    case RestWhole:
-                        canvas_draw_box(canvas, x_position - 3, start_y + 2 * line_spacing + 2, 6, 2);
-                        break;
-                    case RestHalf:
-                        canvas_draw_box(canvas, x_position - 3, start_y + 2 * line_spacing - 2, 6, 2);
-                        break;
-                    case RestQuarter:
-                        canvas_draw_box(canvas, x_position - 2, start_y + 2 * line_spacing - 2, 4, 4);
-                        break;
-                    case RestEighth:
-                        canvas_draw_box(canvas, x_position - 2, start_y + 2 * line_spacing - 2, 4, 4);
-                        canvas_draw_line(canvas, x_position, start_y + 2 * line_spacing - 2, x_position, start_y + 2 * line_spacing - 6);
-                        break;
-                    case RestSixteenth:
-                        canvas_draw_box(canvas, x_position - 2, start_y + 2 * line_spacing - 2, 4, 4);
-                        canvas_draw_line(canvas, x_position, start_y + 2 * line_spacing - 2, x_position, start_y + 2 * line_spacing - 6);
-                        canvas_draw_line(canvas, x_position, start_y + 2 * line_spacing - 4, x_position - 2, start_y + 2 * line_spacing - 8);
-                        break;
-                    default:
-                        break;
-                }
-            }
-        }
+// Funktion zum Wechseln des Akkords der aktuellen Note, Pausen haben keinen Akkord
+void change_note_chord(NoteSheet* sheet, int direction) {
+    Note* current_note = note_store_get(&sheet->notes, sheet->current_note_index);
+    if(current_note->value >= RestWhole) {
+        return;
+    }
+    Note before = *current_note;
+    current_note->chord = (current_note->chord + direction + 4) % 4;
+    journal_record(&sheet->journal, EditSet, 0, sheet->current_note_index, before, *current_note);
+    play_short_sound(sheet, current_note);
+}
 
-        int current_x_position = sheet->notes[sheet->current_note_index].x_position - sheet->scroll_offset;
-        if(current_x_position >= 0 && current_x_position < 128) {
-            canvas_draw_circle(canvas, current_x_position, 58, 2);
+// Funktion zum Springen an den Anfang des vorigen bzw. nächsten nicht leeren Musters
+void select_pattern(NoteSheet* sheet, int direction) {
+    Song* song = &sheet->song;
+    int pattern = song_pattern_at(song, sheet->current_note_index) + direction;
+    while(pattern >= 0 && pattern < song->pattern_count && song->pattern_lengths[pattern] == 0) {
+        pattern += direction;
+    }
+    if(pattern >= 0 && pattern < song->pattern_count) {
+        sheet->current_note_index = song_pattern_start(song, pattern);
+        scroll_to_note(sheet, sheet->current_note_index);
+    }
+}
+
+// Funktion zum Anlegen eines neuen Musters als Kopie des Musters unter dem Cursor. Es kommt ans
+// Ende des Notenspeichers und der Reihenfolge, so dass alle Indizes im Journal gültig bleiben.
+void clone_pattern(NoteSheet* sheet) {
+    Song* song = &sheet->song;
+    if(song->pattern_count >= SONG_PATTERNS_MAX) {
+        snprintf(sheet->status, sizeof(sheet->status), "No free pattern");
+        return;
+    }
+    uint8_t source = song_pattern_at(song, sheet->current_note_index);
+    uint32_t start = song_pattern_start(song, source);
+    uint32_t end = note_store_count(&sheet->notes);
+    uint8_t pattern = song->pattern_count++;
+    song->pattern_lengths[pattern] = 0;
+    for(uint32_t i = 0; i < song->pattern_lengths[source]; i++) {
+        Note note = *note_store_get(&sheet->notes, start + i);
+        if(!sheet_insert_note(sheet, pattern, end + i, note)) {
+            break;
         }
+    }
+    if(song->pattern_lengths[pattern] == 0) {
+        song->pattern_count--;
+        snprintf(sheet->status, sizeof(sheet->status), "Out of memory");
+        return;
+    }
+    if(song->entry_count < SONG_ENTRIES_MAX) {
+        song->entries[song->entry_count].pattern = pattern;
+        song->entries[song->entry_count].repeat = 1;
+        song->entry_count++;
+    }
+    sheet->current_note_index = end;
+    scroll_to_note(sheet, sheet->current_note_index);
+    snprintf(sheet->status, sizeof(sheet->status), "Pattern %c", 'A' + pattern);
+}
 
-        char note_number[20];
-        snprintf(note_number, sizeof(note_number), "Note: %d", sheet->current_note_index + 1);
-        canvas_draw_str(canvas, 0, 64, note_number);
+// Funktion zum Einfügen einer Kopie des gewählten Eintrags der Reihenfolge dahinter
+void song_duplicate_entry(NoteSheet* sheet) {
+    Song* song = &sheet->song;
+    if(song->entry_count >= SONG_ENTRIES_MAX) {
+        return;
     }
+    int index = sheet->song_index;
+    memmove(&song->entries[index + 1], &song->entries[index], (song->entry_count - index) * sizeof(SongEntry));
+    song->entry_count++;
+    sheet->song_index++;
+}
 
-    canvas_commit(canvas);
+// Funktion zum Entfernen des gewählten Eintrags, ein Eintrag bleibt immer erhalten
+void song_delete_entry(NoteSheet* sheet) {
+    Song* song = &sheet->song;
+    if(song->entry_count <= 1) {
+        return;
+    }
+    int index = sheet->song_index;
+    memmove(&song->entries[index], &song->entries[index + 1], (song->entry_count - index - 1) * sizeof(SongEntry));
+    song->entry_count--;
+    sheet->song_index = MIN(index, song->entry_count - 1);
 }
 
-// Funktion zum Abspielen der Noten
-void play_notes(NoteSheet* sheet) {
-    for(int i = 0; i < sheet->total_notes; i++) {
-        Note* note = &sheet->notes[i];
-        int duration = note_durations[note->value % 5];
+// Eingabeverarbeitung für die Pfeiltasten und die OK-Taste
+void process_input(NoteSheet* sheet, InputEvent* input_event) {
+    // Kurze und lange Tastendrücke zählen nur in dem Modus, in dem die Taste gedrückt wurde
+    if(input_event->type == InputTypePress) {
+        sheet->press_mode = sheet->mode;
+    } else if(sheet->mode != sheet->press_mode) {
+        return;
+    }
 
-        if(note->value < RestWhole) {
-            int frequency_index = (43 - note->y_position) / 3;
-            if(frequency_index >= 0 && frequency_index < 12) {
-                play_sound(note_frequencies[frequency_index], duration);
-            }
+    // Bei der Aufnahme kommen die Spieltasten über den Ringpuffer, Zurück beendet die Aufnahme
+    if(sheet->mode == ModeRecord) {
+        if(input_event->key == InputKeyBack && input_event->type == InputTypeShort) {
+            record_stop(sheet);
+        }
+        return;
+    }
+
+    if(sheet->mode == ModeNotes && (input_event->key == InputKeyUp || input_event->key == InputKeyDown)) {
+        if(input_event->type == InputTypeShort || input_event->type == InputTypeLong) {
+            process_notes_input(sheet, input_event);
         }
+        return;
+    }
 
-        furi_delay_ms(duration);
+    // Zurück kurz öffnet das Menü, gehalten wird eine Änderung nach der anderen rückgängig gemacht
+    if(sheet->mode == ModeNotes && input_event->key == InputKeyBack) {
+        if(input_event->type == InputTypeShort) {
+            sheet->mode = ModeMenu;
+            sheet->menu_index = 0;
+        } else if(input_event->type == InputTypeLong || input_event->type == InputTypeRepeat) {
+            journal_step(sheet, true);
+        }
+        return;
     }
-}
 
-// Funktion zum Speichern der Noten in eine Datei
-void save_notes(NoteSheet* sheet) {
-    const char* dir = "/ext/apps_assets/musicmaker";
-    Storage* storage = furi_record_open(RECORD_STORAGE);
-    if(storage) {
-        char path[128];
-        snprintf(path, sizeof(path), "%s/%s.txt", dir, sheet->save_name);
+    // Im Speichermodus sichert OK das Notenblatt im gewählten Format
+    if(sheet->mode == ModeSave && input_event->key == InputKeyOk) {
+        if(input_event->type == InputTypeShort) {
+            save_notes(sheet, sheet->save_format);
+            sheet->mode = ModeNotes;
+        }
+        return;
+    }
 
-        File* file = storage_file_alloc(storage);
-        if(storage_file_open(file, path, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
-            for(int i = 0; i < sheet->total_notes; i++) {
-                Note* note = &sheet->notes[i];
-                char buffer[32];
-                snprintf(buffer, sizeof(buffer), "%ld,%ld,%d;", note->x_position, note->y_position, note->value);
-                storage_file_write(file, buffer, strlen(buffer));
-            }
-            storage_file_close(file);
+    // In der Reihenfolge zählt OK kurz die Durchläufe hoch, OK lang verdoppelt den Eintrag,
+    // Zurück kurz führt ins Menü und Zurück lang entfernt den Eintrag
+    if(sheet->mode == ModeSong && (input_event->key == InputKeyOk || input_event->key == InputKeyBack)) {
+        SongEntry* entry = &sheet->song.entries[sheet->song_index];
+        if(input_event->type == InputTypeShort && input_event->key == InputKeyOk) {
+            entry->repeat = entry->repeat % SONG_REPEAT_MAX + 1;
+        } else if(input_event->type == InputTypeLong && input_event->key == InputKeyOk) {
+            song_duplicate_entry(sheet);
+        } else if(input_event->type == InputTypeShort) {
+            sheet->mode = ModeMenu;
+        } else if(input_event->type == InputTypeLong) {
+            song_delete_entry(sheet);
         }
-        storage_file_free(file);
-        furi_record_close(RECORD_STORAGE);
+        return;
     }
-}
 
-// Eingabeverarbeitung für die Pfeiltasten und die OK-Taste
-void input_callback(InputEvent* input_event, void* ctx) {
-    NoteSheet* sheet = (NoteSheet*)ctx;
+    // OK kurz ändert den Notenwert, OK lang fügt hinter dem Cursor eine Kopie der Note ein
+    if(sheet->mode == ModeNotes && input_event->key == InputKeyOk) {
+        Note* current_note = note_store_get(&sheet->notes, sheet->current_note_index);
+        if(input_event->type == InputTypeShort) {
+            Note before = *current_note;
+            sheet->status[0] = '\0';
+            change_note_value(sheet, current_note, (current_note->value + 1) % 5);
+            journal_record(&sheet->journal, EditSet, 0, sheet->current_note_index, before, *current_note);
+        } else if(input_event->type == InputTypeLong) {
+            Note copy = *current_note;
+            uint8_t pattern = song_pattern_at(&sheet->song, sheet->current_note_index);
+            sheet->status[0] = '\0';
+            if(sheet_insert_note(sheet, pattern, sheet->current_note_index + 1, copy)) {
+                journal_record(&sheet->journal, EditInsert, pattern, sheet->current_note_index + 1, copy, copy);
+                sheet->current_note_index++;
+                scroll_to_note(sheet, sheet->current_note_index);
+            }
+        }
+        return;
+    }
 
     if(input_event->type == InputTypePress || input_event->type == InputTypeRepeat) {
-        int line_spacing = 3;
-        Note* current_note = &sheet->notes[sheet->current_note_index];
+        Note* current_note = note_store_get(&sheet->notes, sheet->current_note_index);
+        int total_notes = note_store_count(&sheet->notes);
 
         if(sheet->mode == ModeMenu) {
             switch(input_event->key) {
@@ -342,8 +2437,7 @@ void input_callback(InputEvent* input_event, void* ctx) {
                     switch(sheet->menu_index) {
                         case 0:
                             sheet->mode = ModePlay;
-                            play_notes(sheet);
-                            sheet->mode = ModeNotes;
+                            player_send(sheet, PlayerCommandPlay, 0);
                             break;
                         case 1:
                             sheet->mode = ModeSave;
@@ -354,18 +2448,59 @@ void input_callback(InputEvent* input_event, void* ctx) {
                             break;
                         case 2:
                             sheet->mode = ModeLoad;
-                            sheet->menu_index = 0;
-                            list_files(sheet);
+                            browser_open(&sheet->browser);
                             break;
                         case 3:
                             new_note_sheet(sheet);
                             sheet->mode = ModeNotes;
                             break;
-                        case 4:
+                        case 5:
+                        case 6:
+                            sheet->mode = ModeNotes;
+                            break;
+                        case 7:
+                            clone_pattern(sheet);
+                            sheet->mode = ModeNotes;
+                            break;
+                        case 8:
+                            sheet->mode = ModeSong;
+                            sheet->song_index = 0;
+                            break;
+                        case 9:
+                            record_start(sheet);
+                            break;
+                        case 10:
+                        case 11:
+                            journal_step(sheet, sheet->menu_index == 10);
+                            sheet->mode = ModeNotes;
+                            break;
+                        case 12:
                             sheet->mode = ModeExit;
                             break;
                     }
                     break;
+                case InputKeyLeft:
+                    if(sheet->menu_index == MENU_TEMPO && sheet->tempo_bpm > TEMPO_MIN_BPM) {
+                        sheet->tempo_bpm -= TEMPO_STEP_BPM;
+                    } else if(sheet->menu_index == MENU_CHORD) {
+                        change_note_chord(sheet, -1);
+                    } else if(sheet->menu_index == MENU_SOUND) {
+                        sheet->voice_preset = (sheet->voice_preset + VOICE_PRESET_COUNT - 1) % VOICE_PRESET_COUNT;
+                    } else if(sheet->menu_index == MENU_PATTERN) {
+                        select_pattern(sheet, -1);
+                    }
+                    break;
+                case InputKeyRight:
+                    if(sheet->menu_index == MENU_TEMPO && sheet->tempo_bpm < TEMPO_MAX_BPM) {
+                        sheet->tempo_bpm += TEMPO_STEP_BPM;
+                    } else if(sheet->menu_index == MENU_CHORD) {
+                        change_note_chord(sheet, 1);
+                    } else if(sheet->menu_index == MENU_SOUND) {
+                        sheet->voice_preset = (sheet->voice_preset + 1) % VOICE_PRESET_COUNT;
+                    } else if(sheet->menu_index == MENU_PATTERN) {
+                        select_pattern(sheet, 1);
+                    }
+                    break;
                 case InputKeyBack:
                     sheet->mode = ModeNotes;
                     break;
@@ -388,10 +2523,6 @@ void input_callback(InputEvent* input_event, void* ctx) {
                         sheet->save_name[sheet->save_name_index]++;
                     }
                     break;
-                case InputKeyOk:
-                    save_notes(sheet);
-                    sheet->mode = ModeNotes;
-                    break;
                 case InputKeyRight:
                     if(sheet->save_name_length < MAX_FILENAME_LENGTH - 1) {
                         sheet->save_name_index++;
@@ -400,6 +2531,9 @@ void input_callback(InputEvent* input_event, void* ctx) {
                         sheet->save_name[sheet->save_name_length] = '\0';
                     }
                     break;
+                case InputKeyLeft:
+                    sheet->save_format = (sheet->save_format + 1) % SaveFormatCount;
+                    break;
                 case InputKeyBack:
                     sheet->mode = ModeMenu;
                     break;
@@ -409,79 +2543,94 @@ void input_callback(InputEvent* input_event, void* ctx) {
         } else if(sheet->mode == ModeLoad) {
             switch(input_event->key) {
                 case InputKeyUp:
-                    sheet->menu_index = (sheet->menu_index - 1 + sheet->total_files) % sheet->total_files;
+                    browser_select(&sheet->browser, sheet->browser.selected - 1);
                     break;
                 case InputKeyDown:
-                    sheet->menu_index = (sheet->menu_index + 1) % sheet->total_files;
+                    browser_select(&sheet->browser, sheet->browser.selected + 1);
                     break;
-                case InputKeyOk:
-                    load_notes(sheet);
-                    sheet->mode = ModeNotes;
+                case InputKeyLeft:
+                    browser_sort(&sheet->browser, (sheet->browser.sort + BrowserSortCount - 1) % BrowserSortCount);
+                    break;
+                case InputKeyRight:
+                    browser_sort(&sheet->browser, (sheet->browser.sort + 1) % BrowserSortCount);
+                    break;
+                case InputKeyOk: {
+                    const SheetIndexRecord* entry = browser_row(&sheet->browser, sheet->browser.selected);
+                    if(entry) {
+                        char file_name[BROWSER_NAME_LENGTH];
+                        snprintf(file_name, sizeof(file_name), "%s", entry->name);
+                        browser_close(&sheet->browser);
+                        load_notes(sheet, file_name);
+                        sheet->mode = ModeNotes;
+                    }
                     break;
+                }
                 case InputKeyBack:
+                    browser_close(&sheet->browser);
                     sheet->mode = ModeMenu;
                     break;
                 default:
                     break;
             }
-        } else if(sheet->mode == ModeNotes) {
+        } else if(sheet->mode == ModeSong) {
+            Song* song = &sheet->song;
+            SongEntry* entry = &song->entries[sheet->song_index];
             switch(input_event->key) {
                 case InputKeyUp:
-                    if(current_note->y_position > 10) {
-                        current_note->y_position -= line_spacing;
-                        play_short_sound(current_note);
-                    }
+                    sheet->song_index = MAX(sheet->song_index - 1, 0);
                     break;
                 case InputKeyDown:
-                    if(current_note->y_position < 43) {
-                        current_note->y_position += line_spacing;
-                        play_short_sound(current_note);
-                    } else {
-                        current_note->value = (NoteValue)((int)current_note->value + RestWhole);
-                        if(current_note->value > RestSixteenth) {
-                            if(sheet->total_notes > 1) {
-                                for(int i = sheet->current_note_index; i < sheet->total_notes - 1; i++) {
-                                    sheet->notes[i] = sheet->notes[i + 1];
-                                }
-                                sheet->total_notes--;
-                                if(sheet->current_note_index >= sheet->total_notes) {
-                                    sheet->current_note_index = sheet->total_notes - 1;
-                                }
-                            } else {
-                                current_note->y_position = 43;
-                                current_note->value = NoteWhole;
-                            }
-                        }
-                    }
+                    sheet->song_index = MIN(sheet->song_index + 1, song->entry_count - 1);
+                    break;
+                case InputKeyLeft:
+                    entry->pattern = (entry->pattern + song->pattern_count - 1) % song->pattern_count;
                     break;
+                case InputKeyRight:
+                    entry->pattern = (entry->pattern + 1) % song->pattern_count;
+                    break;
+                default:
+                    break;
+            }
+        } else if(sheet->mode == ModePlay) {
+            switch(input_event->key) {
                 case InputKeyOk:
-                    change_note_value(current_note, (current_note->value + 1) % 5);
+                    player_send(sheet, sheet->player_state == PlayerPlaying ? PlayerCommandPause : PlayerCommandPlay, 0);
+                    break;
+                case InputKeyLeft:
+                    player_send(sheet, PlayerCommandSeek, -1);
                     break;
                 case InputKeyRight:
-                    if(sheet->current_note_index < sheet->total_notes - 1) {
-                        sheet->current_note_index++;
-                    } else if(sheet->total_notes < MAX_NOTES) {
+                    player_send(sheet, PlayerCommandSeek, 1);
+                    break;
+                case InputKeyBack:
+                    player_send(sheet, PlayerCommandStop, 0);
+                    sheet->mode = ModeNotes;
+                    break;
+                default:
+                    break;
+            }
+        } else if(sheet->mode == ModeNotes) {
+            sheet->status[0] = '\0';
+            switch(input_event->key) {
+                case InputKeyRight:
+                    if(sheet->current_note_index < total_notes - 1) {
                         sheet->current_note_index++;
-                        sheet->total_notes++;
-                        sheet->notes[sheet->current_note_index] = sheet->notes[sheet->current_note_index - 1];
-                        sheet->notes[sheet->current_note_index].x_position = sheet->current_note_index * 15 + 10;
-                    }
-                    if(sheet->notes[sheet->current_note_index].x_position - sheet->scroll_offset > 128) {
-                        sheet->scroll_offset = sheet->notes[sheet->current_note_index].x_position - 128 + 10;
+                    } else {
+                        Note copy = *current_note;
+                        uint8_t pattern = song_pattern_at(&sheet->song, sheet->current_note_index);
+                        if(sheet_insert_note(sheet, pattern, total_notes, copy)) {
+                            journal_record(&sheet->journal, EditInsert, pattern, total_notes, copy, copy);
+                            sheet->current_note_index++;
+                        }
                     }
+                    scroll_to_note(sheet, sheet->current_note_index);
                     break;
                 case InputKeyLeft:
                     if(sheet->current_note_index > 0) {
                         sheet->current_note_index--;
-                        if(sheet->notes[sheet->current_note_index].x_position - sheet->scroll_offset < 0) {
-                            sheet->scroll_offset = sheet->notes[sheet->current_note_index].x_position - 10;
-                        }
+                        scroll_to_note(sheet, sheet->current_note_index);
                     }
                     break;
-                case InputKeyBack:
-                    sheet->mode = ModeMenu;
-                    sheet->menu_index = 0;
-                    break;
                 default:
                     break;
             }
@@ -489,30 +2638,75 @@ void input_callback(InputEvent* input_event, void* ctx) {
     }
 }
 
+// Eingabe-Callback: reicht die Ereignisse an die Hauptschleife weiter
+void input_callback(InputEvent* input_event, void* ctx) {
+    NoteSheet* sheet = (NoteSheet*)ctx;
+    if(sheet->mode == ModeRecord && record_key_index(input_event->key) >= 0 &&
+       (input_event->type == InputTypePress || input_event->type == InputTypeRelease)) {
+        record_capture(&sheet->recorder.ring, input_event);
+    }
+    furi_message_queue_put(sheet->input_queue, input_event, 0);
+}
+
+// Zeichen-Callback: sperrt das Notenblatt während des Zeichnens
+void draw_callback(Canvas* canvas, void* ctx) {
+    NoteSheet* sheet = (NoteSheet*)ctx;
+    furi_mutex_acquire(sheet->mutex, FuriWaitForever);
+    draw_music_lines(canvas, sheet);
+    furi_mutex_release(sheet->mutex);
+}
+
 int32_t musicmaker_app(void) {
-    ViewPort* view_port = view_port_alloc();
-    NoteSheet sheet = { .current_note_index = 0, .total_notes = 1, .scroll_offset = 0, .mode = ModeNotes, .menu_index = 0, .total_files = 0 };
+    NoteSheet* sheet = malloc(sizeof(NoteSheet));
+    memset(sheet, 0, sizeof(NoteSheet));
+    sheet->mode = ModeNotes;
+    sheet->tempo_bpm = TEMPO_DEFAULT_BPM;
+    new_note_sheet(sheet);
 
-    sheet.notes[0].x_position = 10;
-    sheet.notes[0].y_position = 40;
-    sheet.notes[0].value = NoteWhole;
+    sheet->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    sheet->input_queue = furi_message_queue_alloc(8, sizeof(InputEvent));
+    sheet->player_queue = furi_message_queue_alloc(PLAYER_QUEUE_SIZE, sizeof(PlayerCommand));
+    sheet->view_port = view_port_alloc();
 
-    view_port_draw_callback_set(view_port, draw_music_lines, &sheet);
-    view_port_input_callback_set(view_port, input_callback, &sheet);
+    view_port_draw_callback_set(sheet->view_port, draw_callback, sheet);
+    view_port_input_callback_set(sheet->view_port, input_callback, sheet);
 
     Gui* gui = furi_record_open("gui");
-    gui_add_view_port(gui, view_port, GuiLayerFullscreen);
+    gui_add_view_port(gui, sheet->view_port, GuiLayerFullscreen);
 
-    while(sheet.mode != ModeExit) {
-        view_port_update(view_port);
-        furi_delay_ms(100);
+    sheet->player_thread = furi_thread_alloc_ex("MusicMakerPlayer", PLAYER_STACK_SIZE, player_worker, sheet);
+    furi_thread_start(sheet->player_thread);
+
+    while(sheet->mode != ModeExit) {
+        InputEvent input_event;
+        bool received = furi_message_queue_get(sheet->input_queue, &input_event, 100) == FuriStatusOk;
+        if(received || sheet->mode == ModeRecord) {
+            furi_mutex_acquire(sheet->mutex, FuriWaitForever);
+            if(sheet->mode == ModeRecord) {
+                record_drain(sheet);
+            }
+            if(received) {
+                process_input(sheet, &input_event);
+            }
+            furi_mutex_release(sheet->mutex);
+        }
+        view_port_update(sheet->view_port);
     }
 
-    gui_remove_view_port(gui, view_port);
-    view_port_free(view_port);
+    player_send(sheet, PlayerCommandExit, 0);
+    furi_thread_join(sheet->player_thread);
+    furi_thread_free(sheet->player_thread);
+
+    gui_remove_view_port(gui, sheet->view_port);
+    view_port_free(sheet->view_port);
     furi_record_close("gui");
 
-    free_memory(&sheet);
+    browser_close(&sheet->browser);
+    note_store_free(&sheet->notes);
+    furi_message_queue_free(sheet->player_queue);
+    furi_message_queue_free(sheet->input_queue);
+    furi_mutex_free(sheet->mutex);
+    free(sheet);
 
     return 0;
-}
\ No newline at end of file
+}
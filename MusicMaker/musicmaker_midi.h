@@ -0,0 +1,446 @@
+#pragma once
+
+// Lesen und Schreiben von Standard-MIDI-Dateien (Typ 0 und 1) ohne Abhängigkeit von der Firmware.
+// Der Parser bekommt die Datei Byte für Byte und hält nur einen festen, kleinen Zustand, so dass
+// beliebig große Dateien mit einem kleinen Lesepuffer importiert werden können.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "musicmaker_sheet.h"
+
+#define MIDI_EXTENSION ".mid"
+#define MIDI_MAGIC "MThd"
+#define MIDI_HEADER_ID 0x4D546864UL
+#define MIDI_TRACK_ID 0x4D54726BUL
+#define MIDI_EXPORT_DIVISION 96
+#define MIDI_EXPORT_VELOCITY 100
+#define MIDI_DRUM_CHANNEL 9
+#define MIDI_SIXTEENTHS_PER_WHOLE 16U
+#define MIDI_NOTE_EVENTS_MAX 36
+
+// Zustände des Parsers
+typedef enum {
+    MidiStateHeaderId,
+    MidiStateHeaderLength,
+    MidiStateHeaderData,
+    MidiStateChunkId,
+    MidiStateChunkLength,
+    MidiStateSkip,
+    MidiStateDelta,
+    MidiStateEvent,
+    MidiStateData,
+    MidiStateMetaType,
+    MidiStateMetaLength,
+    MidiStateMetaData,
+    MidiStateSysexLength,
+    MidiStateSysexData,
+    MidiStateDone,
+} MidiState;
+
+// Rückruf für jede quantisierte Note bzw. Pause
+typedef void (*MidiNoteCallback)(void* context, Note note);
+
+// Zustand des Parsers. Übernommen wird die erste Spur mit Noten und darin der erste Kanal
+// außer dem Schlagzeug; überlappende Noten werden einstimmig gemacht, die neue Note gewinnt.
+// Gleichzeitig angeschlagene Töne werden als Akkord übernommen, wenn sie einem bekannten
+// Akkord entsprechen, sonst klingt der höchste Ton.
+typedef struct {
+    MidiState state;
+    uint32_t value;
+    uint8_t count;
+    uint32_t length;
+    uint32_t remaining;
+    bool in_track;
+    uint16_t format;
+    uint16_t division;
+    bool smpte;
+    uint8_t status;
+    uint8_t data[2];
+    uint8_t data_length;
+    uint8_t meta_type;
+    uint16_t track;
+    int8_t channel;
+    int16_t sounding;
+    uint8_t highest;
+    uint16_t chord_mask;
+    uint32_t tick;
+    uint32_t sounding_start;
+    uint32_t grid;
+    uint32_t notes;
+    uint32_t tempo_us;
+    bool tempo_set;
+    MidiNoteCallback emit;
+    void* context;
+} MidiReader;
+
+// Funktion zum Vorbereiten des Parsers
+static inline void midi_reader_init(MidiReader* reader, MidiNoteCallback emit, void* context) {
+    *reader = (MidiReader){
+        .state = MidiStateHeaderId,
+        .channel = -1,
+        .sounding = -1,
+        .tempo_us = 60000000UL / TEMPO_DEFAULT_BPM,
+        .emit = emit,
+        .context = context,
+    };
+}
+
+// Funktion zum Umrechnen von Ticks in Sechzehntel, gerundet auf das nächste Raster
+static inline uint32_t midi_sixteenths(const MidiReader* reader, uint32_t tick) {
+    return (uint32_t)(((uint64_t)tick * 4 + reader->division / 2) / reader->division);
+}
+
+// Funktion zum Ausgeben einer Dauer in Sechzehnteln als Note mit anschließenden Pausen
+static inline void midi_emit_span(MidiReader* reader, Note note, bool rest, uint32_t units) {
+    while(units > 0) {
+        uint8_t value = NoteWhole;
+        while((MIDI_SIXTEENTHS_PER_WHOLE >> value) > units) {
+            value++;
+        }
+        note.value = rest ? value + RestWhole : value;
+        reader->emit(reader->context, note);
+        units -= MIDI_SIXTEENTHS_PER_WHOLE >> value;
+        rest = true;
+    }
+}
+
+// Funktion zum Erkennen eines Akkords aus den Intervallen über dem tiefsten Ton (Bit 0 = Grundton)
+static inline uint8_t midi_chord(uint16_t mask) {
+    for(uint8_t chord = ChordMajor; chord <= ChordSeventh; chord++) {
+        uint16_t pattern = 0;
+        for(uint8_t member = 0; member < chord_sizes[chord]; member++) {
+            pattern |= 1 << chord_intervals[chord][member];
+        }
+        if(pattern == mask) {
+            return chord;
+        }
+    }
+    return ChordNone;
+}
+
+// Funktion zum Beenden der klingenden Note, Lücken davor werden zu Pausen
+static inline void midi_close_note(MidiReader* reader) {
+    if(reader->sounding < 0) {
+        return;
+    }
+    uint32_t start = midi_sixteenths(reader, reader->sounding_start);
+    uint32_t end = midi_sixteenths(reader, reader->tick);
+    start = start < reader->grid ? reader->grid : start;
+    end = end <= start ? start + 1 : end;
+
+    uint8_t chord = midi_chord(reader->chord_mask);
+    Note note = note_from_midi(chord != ChordNone ? reader->sounding : reader->highest, NoteWhole);
+    note.chord = chord;
+    Note rest = {.step = 0};
+    midi_emit_span(reader, rest, true, start - reader->grid);
+    midi_emit_span(reader, note, false, end - start);
+    reader->grid = end;
+    reader->sounding = -1;
+    reader->notes++;
+}
+
+// Funktion zum Auswerten eines vollständigen Kanalereignisses
+static inline void midi_channel_event(MidiReader* reader) {
+    uint8_t type = reader->status & 0xF0;
+    int8_t channel = reader->status & 0x0F;
+    bool note_on = type == 0x90 && reader->data[1] > 0;
+    bool note_off = type == 0x80 || (type == 0x90 && reader->data[1] == 0);
+
+    if(channel == MIDI_DRUM_CHANNEL || (reader->channel >= 0 && channel != reader->channel)) {
+        return;
+    }
+    uint8_t pitch = reader->data[0];
+    if(note_on && reader->sounding >= 0 && reader->tick == reader->sounding_start) {
+        // Weiterer Ton desselben Anschlags, der tiefste Ton bleibt Grundton. Intervalle ab
+        // einer Oktave passen zu keinem Akkord und setzen die oberen Bits.
+        if(pitch < reader->sounding) {
+            uint8_t shift = reader->sounding - pitch;
+            reader->chord_mask = shift < 12 ? (uint16_t)(reader->chord_mask << shift) | 1 : 0xF001;
+            reader->sounding = pitch;
+        } else {
+            reader->chord_mask |= pitch - reader->sounding < 12 ? 1 << (pitch - reader->sounding) : 0xF000;
+        }
+        reader->highest = pitch > reader->highest ? pitch : reader->highest;
+    } else if(note_on) {
+        reader->channel = channel;
+        midi_close_note(reader);
+        reader->sounding = pitch;
+        reader->highest = pitch;
+        reader->chord_mask = 1;
+        reader->sounding_start = reader->tick;
+    } else if(note_off && (pitch == reader->sounding || pitch == reader->highest)) {
+        midi_close_note(reader);
+    }
+}
+
+// Funktion zum Auswerten eines Meta-Ereignisses, benötigt wird nur das erste Tempo
+static inline void midi_meta_event(MidiReader* reader) {
+    if(reader->meta_type == 0x51 && reader->length == 3 && !reader->tempo_set && !reader->smpte) {
+        reader->tempo_us = reader->value;
+        reader->tempo_set = true;
+    }
+}
+
+// Funktion zum Abschließen einer Spur, Pausen bis zum Spurende bleiben erhalten. Nach der
+// ersten Spur mit Noten ist der Import fertig.
+static inline void midi_end_track(MidiReader* reader) {
+    midi_close_note(reader);
+    uint32_t end = midi_sixteenths(reader, reader->tick);
+    if(reader->notes > 0 && end > reader->grid) {
+        Note rest = {.step = 0};
+        midi_emit_span(reader, rest, true, end - reader->grid);
+    }
+    reader->in_track = false;
+    reader->track++;
+    reader->state = reader->notes > 0 ? MidiStateDone : MidiStateChunkId;
+    reader->channel = -1;
+    reader->grid = 0;
+    reader->count = 0;
+    reader->value = 0;
+}
+
+// Funktion zum Ermitteln der Anzahl Datenbytes eines Kanalereignisses
+static inline uint8_t midi_data_length(uint8_t status) {
+    uint8_t type = status & 0xF0;
+    return type == 0xC0 || type == 0xD0 ? 1 : 2;
+}
+
+// Funktion zum Lesen einer Zahl variabler Länge, gibt true zurück sobald sie vollständig ist
+static inline bool midi_read_vlq(MidiReader* reader, uint8_t byte) {
+    reader->value = (reader->value << 7) | (byte & 0x7F);
+    reader->count++;
+    return !(byte & 0x80);
+}
+
+// Funktion zum Verarbeiten des nächsten Bytes, gibt false bei ungültigen Dateien zurück
+static inline bool midi_reader_feed(MidiReader* reader, uint8_t byte) {
+    if(reader->in_track) {
+        reader->remaining--;
+    }
+
+    switch(reader->state) {
+        case MidiStateHeaderId:
+        case MidiStateChunkId:
+        case MidiStateHeaderLength:
+        case MidiStateChunkLength:
+            reader->value = (reader->value << 8) | byte;
+            if(++reader->count < 4) {
+                return true;
+            }
+            reader->count = 0;
+            if(reader->state == MidiStateHeaderId) {
+                if(reader->value != MIDI_HEADER_ID) {
+                    return false;
+                }
+                reader->state = MidiStateHeaderLength;
+            } else if(reader->state == MidiStateHeaderLength) {
+                if(reader->value < 6) {
+                    return false;
+                }
+                reader->length = reader->value;
+                reader->state = MidiStateHeaderData;
+            } else if(reader->state == MidiStateChunkId) {
+                reader->length = reader->value;
+                reader->state = MidiStateChunkLength;
+            } else if(reader->value == 0) {
+                // Leere Chunks haben keinen Inhalt, auch keine leere Spur
+                reader->state = MidiStateChunkId;
+            } else {
+                reader->in_track = reader->length == MIDI_TRACK_ID;
+                reader->remaining = reader->value;
+                reader->state = reader->in_track ? MidiStateDelta : MidiStateSkip;
+                reader->tick = 0;
+                reader->status = 0;
+            }
+            reader->value = 0;
+            return true;
+
+        case MidiStateHeaderData:
+            reader->count++;
+            if(reader->count <= 6) {
+                reader->value = (reader->value << 8) | byte;
+            }
+            if(reader->count == 2) {
+                reader->format = reader->value;
+                reader->value = 0;
+            } else if(reader->count == 4) {
+                reader->value = 0;
+            } else if(reader->count == 6) {
+                reader->division = reader->value;
+                reader->value = 0;
+            }
+            if(reader->count < reader->length) {
+                return true;
+            }
+            if(reader->format > 1 || reader->division == 0) {
+                return false;
+            }
+            if(reader->division & 0x8000) {
+                // SMPTE-Zeitbasis: Ticks pro Sekunde auf Viertel bei Standardtempo umrechnen
+                uint32_t ticks_per_second = (uint32_t)(-(int8_t)(reader->division >> 8)) * (reader->division & 0xFF);
+                reader->division = ticks_per_second * 60 / TEMPO_DEFAULT_BPM;
+                reader->smpte = true;
+                if(reader->division == 0) {
+                    return false;
+                }
+            }
+            reader->count = 0;
+            reader->state = MidiStateChunkId;
+            return true;
+
+        case MidiStateSkip:
+            if(--reader->remaining == 0) {
+                reader->state = MidiStateChunkId;
+            }
+            return true;
+
+        case MidiStateDelta:
+            if(midi_read_vlq(reader, byte)) {
+                reader->tick += reader->value;
+                reader->value = 0;
+                reader->count = 0;
+                reader->state = MidiStateEvent;
+            } else if(reader->count >= 4) {
+                return false;
+            }
+            break;
+
+        case MidiStateEvent:
+            if(byte == 0xFF) {
+                reader->state = MidiStateMetaType;
+            } else if(byte == 0xF0 || byte == 0xF7) {
+                reader->status = 0;
+                reader->state = MidiStateSysexLength;
+            } else if(byte >= 0xF0) {
+                return false;
+            } else {
+                if(byte & 0x80) {
+                    reader->status = byte;
+                    reader->data_length = 0;
+                } else if(reader->status == 0) {
+                    return false;
+                } else {
+                    reader->data[0] = byte;
+                    reader->data_length = 1;
+                }
+                reader->state = MidiStateData;
+                if(reader->data_length == midi_data_length(reader->status)) {
+                    reader->state = MidiStateDelta;
+                    midi_channel_event(reader);
+                }
+            }
+            break;
+
+        case MidiStateData:
+            if(byte & 0x80) {
+                return false;
+            }
+            reader->data[reader->data_length++] = byte;
+            if(reader->data_length == midi_data_length(reader->status)) {
+                reader->state = MidiStateDelta;
+                midi_channel_event(reader);
+            }
+            break;
+
+        case MidiStateMetaType:
+            reader->meta_type = byte;
+            reader->state = MidiStateMetaLength;
+            break;
+
+        case MidiStateMetaLength:
+        case MidiStateSysexLength:
+            if(midi_read_vlq(reader, byte)) {
+                reader->length = reader->value;
+                reader->value = 0;
+                reader->count = 0;
+                if(reader->state == MidiStateSysexLength) {
+                    reader->state = reader->length > 0 ? MidiStateSysexData : MidiStateDelta;
+                } else if(reader->length > 0) {
+                    reader->state = MidiStateMetaData;
+                } else {
+                    midi_meta_event(reader);
+                    reader->state = MidiStateDelta;
+                }
+            } else if(reader->count >= 4) {
+                return false;
+            }
+            break;
+
+        case MidiStateMetaData:
+        case MidiStateSysexData:
+            if(reader->count < 4) {
+                reader->value = (reader->value << 8) | byte;
+            }
+            if(++reader->count == reader->length) {
+                if(reader->state == MidiStateMetaData) {
+                    midi_meta_event(reader);
+                }
+                reader->value = 0;
+                reader->count = 0;
+                reader->state = MidiStateDelta;
+            }
+            break;
+
+        case MidiStateDone:
+            return true;
+    }
+
+    if(reader->in_track && reader->remaining == 0) {
+        midi_end_track(reader);
+    }
+    return true;
+}
+
+// Funktion zum Abschließen des Imports am Dateiende, gibt true zurück wenn Noten übernommen wurden
+static inline bool midi_reader_finish(MidiReader* reader) {
+    if(reader->in_track) {
+        midi_end_track(reader);
+    }
+    return reader->notes > 0;
+}
+
+// Funktion zum Ermitteln des Tempos der Datei, begrenzt auf den Bereich der App
+static inline int midi_reader_tempo_bpm(const MidiReader* reader) {
+    uint32_t bpm = (60000000UL + reader->tempo_us / 2) / (reader->tempo_us ? reader->tempo_us : 1);
+    return bpm < TEMPO_MIN_BPM ? TEMPO_MIN_BPM : (bpm > TEMPO_MAX_BPM ? TEMPO_MAX_BPM : (int)bpm);
+}
+
+// Funktion zum Schreiben einer Zahl variabler Länge, gibt die Anzahl der Bytes zurück
+static inline uint8_t midi_vlq(uint32_t value, uint8_t* bytes) {
+    uint8_t length = 1;
+    for(uint32_t rest = value >> 7; rest > 0; rest >>= 7) {
+        length++;
+    }
+    for(uint8_t i = 0; i < length; i++) {
+        bytes[i] = ((value >> (7 * (length - 1 - i))) & 0x7F) | (i + 1 < length ? 0x80 : 0);
+    }
+    return length;
+}
+
+// Funktion zum Erzeugen der Ereignisse einer Note für den Export (Typ 0, ein Kanal), Akkorde
+// werden als gleichzeitige Noten geschrieben. delta enthält die Ticks der vorangehenden Pausen
+// und wird zurückgesetzt, sobald eine Note geschrieben wurde. Gibt die Anzahl der Bytes in
+// events zurück (höchstens MIDI_NOTE_EVENTS_MAX).
+static inline uint8_t midi_note_events(const Note* note, uint32_t* delta, uint8_t* events) {
+    uint32_t ticks = (MIDI_EXPORT_DIVISION * 4) >> (note->value % 5);
+    if(note->value >= RestWhole || note_midi(note) < 0) {
+        *delta += ticks;
+        return 0;
+    }
+    uint8_t length = 0;
+    for(uint8_t member = 0; member < chord_sizes[note->chord]; member++) {
+        length += midi_vlq(member == 0 ? *delta : 0, events + length);
+        events[length++] = 0x90;
+        events[length++] = note_chord_midi(note, member);
+        events[length++] = MIDI_EXPORT_VELOCITY;
+    }
+    for(uint8_t member = 0; member < chord_sizes[note->chord]; member++) {
+        length += midi_vlq(member == 0 ? ticks : 0, events + length);
+        events[length++] = 0x80;
+        events[length++] = note_chord_midi(note, member);
+        events[length++] = 0;
+    }
+    *delta = 0;
+    return length;
+}
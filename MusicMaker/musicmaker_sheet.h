@@ -0,0 +1,199 @@
+#pragma once
+
+// Notenmodell, Dateiformat und Tonhöhen der MusicMaker-App. Die Datei hängt nicht von der
+// Firmware ab und wird auch von den Werkzeugen unter tools/ auf dem Rechner verwendet.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Enumeration für die Notenwerte und Pausen
+typedef enum {
+    NoteWhole, NoteHalf, NoteQuarter, NoteEighth, NoteSixteenth,
+    RestWhole, RestHalf, RestQuarter, RestEighth, RestSixteenth
+} NoteValue;
+
+// Vorzeichen einer Note
+typedef enum {
+    AccidentalNone, AccidentalSharp, AccidentalFlat
+} NoteAccidental;
+
+// Akkord über dem Grundton, gespielt als schnelles Arpeggio
+typedef enum {
+    ChordNone, ChordMajor, ChordMinor, ChordSeventh
+} NoteChord;
+
+// Struktur einer Note: Schritt auf den Notenlinien (0 = unterste Position, B3), Oktavverschiebung,
+// Notenwert, Vorzeichen und Akkord. Die Bildschirmkoordinaten ergeben sich aus Index und Schritt.
+typedef struct {
+    uint8_t step : 4;
+    int8_t octave : 4;
+    uint8_t value : 4;
+    uint8_t accidental : 2;
+    uint8_t chord : 2;
+} Note;
+
+#define NOTE_STEP_MAX 11
+#define MIDI_NOTE_MAX 127
+
+#define TEMPO_DEFAULT_BPM 120
+#define TEMPO_MIN_BPM 40
+#define TEMPO_MAX_BPM 300
+
+// Binäres Notenblatt: Kopf mit Version, Anzahl und CRC32, danach ein Datensatz je Note. Ab Version 2
+// steht zwischen Kopf und Datensätzen der Song-Abschnitt (musicmaker_song.h), die Prüfsumme deckt
+// ihn mit ab. Blätter aus einem einzigen Muster werden weiter als Version 1 geschrieben.
+#define SHEET_EXTENSION ".mms"
+#define SHEET_MAGIC "MMSH"
+#define SHEET_VERSION 2
+#define SHEET_VERSION_FLAT 1
+
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint8_t version;
+    uint8_t record_size;
+    uint16_t tempo_bpm;
+    uint32_t note_count;
+    uint32_t checksum;
+} SheetHeader;
+
+// Datensatz einer Note, neuere Versionen dürfen weitere Bytes anhängen. Ältere Dateien ohne das
+// Byte für Vorzeichen, Oktave und Akkord (Bits 0-1, 2-5 und 6-7) bleiben lesbar.
+typedef struct __attribute__((packed)) {
+    uint8_t step;
+    uint8_t value;
+    uint8_t modifiers;
+} SheetRecord;
+
+#define SHEET_RECORD_MIN_SIZE 2
+
+// MIDI-Nummern der natürlichen Töne auf den Notenlinien (B3 bis F5)
+static const uint8_t staff_pitches[NOTE_STEP_MAX + 1] = {
+    59, 60, 62, 64, 65, 67, 69, 71, 72, 74, 76, 77
+};
+
+// Frequenzen der Oktave MIDI 120-131 in Hz * 65536 (Festkomma 16.16), jede tiefere Oktave
+// entsteht beim Übersetzen durch gerundetes Halbieren
+#define PITCH_ROUND_SHIFT(hz, shift) (((hz) + ((1UL << (shift)) >> 1)) >> (shift))
+#define PITCH_OCTAVE(shift)                                                                        \
+    PITCH_ROUND_SHIFT(548668578UL, shift), PITCH_ROUND_SHIFT(581294109UL, shift),                  \
+        PITCH_ROUND_SHIFT(615859655UL, shift), PITCH_ROUND_SHIFT(652480576UL, shift),              \
+        PITCH_ROUND_SHIFT(691279090UL, shift), PITCH_ROUND_SHIFT(732384684UL, shift),              \
+        PITCH_ROUND_SHIFT(775934544UL, shift), PITCH_ROUND_SHIFT(822074013UL, shift),              \
+        PITCH_ROUND_SHIFT(870957077UL, shift), PITCH_ROUND_SHIFT(922746880UL, shift),              \
+        PITCH_ROUND_SHIFT(977616265UL, shift), PITCH_ROUND_SHIFT(1035748353UL, shift)
+
+// Frequenzen aller MIDI-Noten (0-127, aufgefüllt auf ganze Oktaven) in Hz * 65536
+static const uint32_t midi_frequencies[12 * 11] = {
+    PITCH_OCTAVE(10), PITCH_OCTAVE(9), PITCH_OCTAVE(8), PITCH_OCTAVE(7), PITCH_OCTAVE(6), PITCH_OCTAVE(5),
+    PITCH_OCTAVE(4),  PITCH_OCTAVE(3), PITCH_OCTAVE(2), PITCH_OCTAVE(1), PITCH_OCTAVE(0)
+};
+
+// Intervalle der Akkordtöne über dem Grundton, Anzahl der Töne und Namen für die Anzeige
+static const uint8_t chord_intervals[4][4] = {{0}, {0, 4, 7}, {0, 3, 7}, {0, 4, 7, 10}};
+static const uint8_t chord_sizes[4] = {1, 3, 3, 4};
+static const char* const chord_names[4] = {"", "maj", "min", "7"};
+
+// Dauer eines Arpeggio-Schritts, kurz genug dass die Töne als Akkord wahrgenommen werden
+#define ARPEGGIO_STEP_US 16000UL
+
+// Namen der Tonstufen für die Anzeige
+static const char* const pitch_names[12] = {
+    "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"
+};
+
+// Funktion zum Ermitteln der MIDI-Nummer einer Note (-1 außerhalb des Bereichs)
+static inline int note_midi(const Note* note) {
+    static const int8_t accidental_offsets[] = {0, 1, -1, 0};
+    if(note->step > NOTE_STEP_MAX) {
+        return -1;
+    }
+    int midi = staff_pitches[note->step] + accidental_offsets[note->accidental] + 12 * note->octave;
+    return midi >= 0 && midi <= MIDI_NOTE_MAX ? midi : -1;
+}
+
+// Dauer eines Notenwerts in Mikrosekunden, eine ganze Note entspricht vier Schlägen
+static inline uint32_t note_duration_us(NoteValue value, int tempo_bpm) {
+    return (240000000UL / tempo_bpm) >> (value % 5);
+}
+
+// Klingende Dauer einer Note, 1/8 bleibt als Pause für eine hörbare Artikulation
+static inline uint32_t note_gate_us(uint32_t duration_us) {
+    return duration_us - duration_us / 8;
+}
+
+// Funktion zum Fortschreiben einer CRC32 (Halbbyte-Tabelle statt 1 KB Tabelle)
+static inline uint32_t sheet_crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    static const uint32_t crc_table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    for(size_t i = 0; i < length; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = crc_table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+// Funktion zum Umrechnen einer y-Position aus dem alten Textformat in einen Notenlinienschritt
+static inline uint8_t y_position_step(int32_t y_position) {
+    int step = (43 - y_position) / 3;
+    return step < 0 ? 0 : (step > NOTE_STEP_MAX ? NOTE_STEP_MAX : step);
+}
+
+// Funktion zum Ermitteln eines Akkordtons, Töne über dem MIDI-Bereich fallen auf den Grundton zurück
+static inline int note_chord_midi(const Note* note, uint8_t member) {
+    int root = note_midi(note);
+    if(root < 0) {
+        return -1;
+    }
+    int midi = root + chord_intervals[note->chord][member % chord_sizes[note->chord]];
+    return midi <= MIDI_NOTE_MAX ? midi : root;
+}
+
+// Funktion zum Ermitteln des Akkordtons, der eine bestimmte Zeit nach dem Einschalten klingt
+static inline uint8_t arpeggio_member(const Note* note, uint64_t since_on_us) {
+    return (since_on_us / ARPEGGIO_STEP_US) % chord_sizes[note->chord];
+}
+
+// Funktion zum Abbilden einer MIDI-Nummer auf die Notenlinien, Töne außerhalb von B3 bis F#5
+// werden um ganze Oktaven verschoben und als Kreuz notiert
+static inline Note note_from_midi(int midi, uint8_t value) {
+    int octave = 0;
+    if(midi < staff_pitches[0] || midi > staff_pitches[NOTE_STEP_MAX] + 1) {
+        octave = (midi - staff_pitches[0] + 120) / 12 - 10;
+    }
+    int pitch = midi - 12 * octave;
+    Note note = {.octave = octave, .value = value};
+    for(uint8_t step = NOTE_STEP_MAX + 1; step-- > 0;) {
+        if(staff_pitches[step] <= pitch) {
+            note.step = step;
+            note.accidental = staff_pitches[step] == pitch ? AccidentalNone : AccidentalSharp;
+            break;
+        }
+    }
+    return note;
+}
+
+// Funktion zum Packen einer Note in einen Datensatz
+static inline SheetRecord sheet_record(const Note* note) {
+    SheetRecord record = {
+        .step = note->step,
+        .value = note->value,
+        .modifiers = note->accidental | ((note->octave & 0x0F) << 2) | (note->chord << 6),
+    };
+    return record;
+}
+
+// Funktion zum Entpacken eines Datensatzes, fehlende Bytes älterer Dateien zählen als 0
+static inline Note sheet_record_note(const uint8_t* record, size_t record_size) {
+    uint8_t modifiers = record_size > 2 ? record[2] : 0;
+    Note note = {
+        .step = record[0] > NOTE_STEP_MAX ? NOTE_STEP_MAX : record[0],
+        .value = record[1] <= RestSixteenth ? record[1] : NoteWhole,
+        .accidental = (modifiers & 0x03) <= AccidentalFlat ? (modifiers & 0x03) : AccidentalNone,
+        .octave = (int8_t)((modifiers >> 2) << 4) >> 4,
+        .chord = modifiers >> 6,
+    };
+    return note;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+// Songaufbau aus wiederverwendbaren Mustern und einer Reihenfolge mit Wiederholungen. Die Noten
+// aller Muster liegen hintereinander in einem Speicher, ein Muster ist nur ein Abschnitt davon.
+// Abgespielt wird über einen Cursor, der die Reihenfolge beim Weiterschalten auflöst, der Song
+// wird dabei nie ausgerollt. Wie musicmaker_sheet.h auch von den Werkzeugen verwendet.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Muster werden mit Buchstaben bezeichnet
+#define SONG_PATTERNS_MAX 26
+#define SONG_ENTRIES_MAX 64
+#define SONG_REPEAT_MAX 16
+
+// Eintrag der Reihenfolge: Muster und Anzahl der Durchläufe
+typedef struct __attribute__((packed)) {
+    uint8_t pattern;
+    uint8_t repeat;
+} SongEntry;
+
+// Länge jedes Musters in Noten und die Reihenfolge, zusammen wenige hundert Byte
+typedef struct {
+    uint32_t pattern_lengths[SONG_PATTERNS_MAX];
+    SongEntry entries[SONG_ENTRIES_MAX];
+    uint8_t pattern_count;
+    uint8_t entry_count;
+} Song;
+
+// Abspielposition: Eintrag, Durchlauf und Note im Muster, start ist der Index der ersten Note
+// des Musters im Notenspeicher. Hinter dem letzten Eintrag steht der Cursor auf entry_count.
+typedef struct {
+    uint8_t entry;
+    uint8_t repeat;
+    uint32_t offset;
+    uint32_t start;
+} SongCursor;
+
+// Song-Abschnitt im Notenblatt ab Version 2, es folgen die Musterlängen (je 4 Byte) und die Einträge
+typedef struct __attribute__((packed)) {
+    uint8_t pattern_count;
+    uint8_t entry_count;
+} SongChunk;
+
+// Funktion zum Anlegen eines Songs aus einem leeren Muster, das einmal gespielt wird
+static inline void song_init(Song* song) {
+    song->pattern_count = 1;
+    song->pattern_lengths[0] = 0;
+    song->entry_count = 1;
+    song->entries[0].pattern = 0;
+    song->entries[0].repeat = 1;
+}
+
+// Funktion zum Prüfen, ob der Song nur aus einem einmal gespielten Muster besteht
+static inline bool song_is_flat(const Song* song) {
+    return song->pattern_count == 1 && song->entry_count == 1 && song->entries[0].repeat == 1;
+}
+
+// Funktion zum Ermitteln des Index der ersten Note eines Musters
+static inline uint32_t song_pattern_start(const Song* song, uint8_t pattern) {
+    uint32_t start = 0;
+    for(uint8_t i = 0; i < pattern; i++) {
+        start += song->pattern_lengths[i];
+    }
+    return start;
+}
+
+// Funktion zum Finden des Musters, zu dem ein Notenindex gehört, leere Muster werden übersprungen
+static inline uint8_t song_pattern_at(const Song* song, uint32_t index) {
+    uint32_t end = 0;
+    for(uint8_t i = 0; i < song->pattern_count; i++) {
+        end += song->pattern_lengths[i];
+        if(index < end) {
+            return i;
+        }
+    }
+    return song->pattern_count - 1;
+}
+
+// Funktion zum Berechnen der ausgerollten Länge in Noten, ohne den Song auszurollen
+static inline uint32_t song_length(const Song* song) {
+    uint32_t length = 0;
+    for(uint8_t i = 0; i < song->entry_count; i++) {
+        length += song->pattern_lengths[song->entries[i].pattern] * song->entries[i].repeat;
+    }
+    return length;
+}
+
+// Funktion zum Zählen der Durchläufe eines Musters über die ganze Reihenfolge
+static inline uint32_t song_pattern_repeats(const Song* song, uint8_t pattern) {
+    uint32_t repeats = 0;
+    for(uint8_t i = 0; i < song->entry_count; i++) {
+        if(song->entries[i].pattern == pattern) {
+            repeats += song->entries[i].repeat;
+        }
+    }
+    return repeats;
+}
+
+// Funktion zum Prüfen eines geladenen Songs gegen die Anzahl der gespeicherten Noten
+static inline bool song_valid(const Song* song, uint32_t note_count) {
+    if(song->pattern_count == 0 || song->pattern_count > SONG_PATTERNS_MAX || song->entry_count == 0 ||
+       song->entry_count > SONG_ENTRIES_MAX) {
+        return false;
+    }
+    for(uint8_t i = 0; i < song->entry_count; i++) {
+        if(song->entries[i].pattern >= song->pattern_count || song->entries[i].repeat == 0 ||
+           song->entries[i].repeat > SONG_REPEAT_MAX) {
+            return false;
+        }
+    }
+    return song_pattern_start(song, song->pattern_count) == note_count;
+}
+
+// Funktion zum Prüfen, ob der Cursor hinter dem letzten Eintrag steht
+static inline bool song_cursor_done(const Song* song, const SongCursor* cursor) {
+    return cursor->entry >= song->entry_count;
+}
+
+// Funktion zum Ermitteln des Notenindex an der Cursorposition
+static inline uint32_t song_cursor_index(const SongCursor* cursor) {
+    return cursor->start + cursor->offset;
+}
+
+// Funktion zum Weiterschalten über das Ende eines Musters hinaus, leere Muster werden übersprungen
+static inline void song_cursor_settle(const Song* song, SongCursor* cursor) {
+    while(!song_cursor_done(song, cursor) &&
+          cursor->offset >= song->pattern_lengths[song->entries[cursor->entry].pattern]) {
+        cursor->offset = 0;
+        if(++cursor->repeat >= song->entries[cursor->entry].repeat) {
+            cursor->repeat = 0;
+            if(++cursor->entry < song->entry_count) {
+                cursor->start = song_pattern_start(song, song->entries[cursor->entry].pattern);
+            }
+        }
+    }
+}
+
+// Funktion zum Setzen des Cursors auf die erste Note des Songs
+static inline void song_cursor_start(const Song* song, SongCursor* cursor) {
+    cursor->entry = 0;
+    cursor->repeat = 0;
+    cursor->offset = 0;
+    cursor->start = song_pattern_start(song, song->entries[0].pattern);
+    song_cursor_settle(song, cursor);
+}
+
+// Funktion zum Weiterschalten auf die nächste Note, gibt false zurück wenn der Song zu Ende ist
+static inline bool song_cursor_next(const Song* song, SongCursor* cursor) {
+    if(song_cursor_done(song, cursor)) {
+        return false;
+    }
+    cursor->offset++;
+    song_cursor_settle(song, cursor);
+    return !song_cursor_done(song, cursor);
+}
+
+// Funktion zum Zurückschalten auf die vorige Note, am Anfang des Songs bleibt der Cursor stehen
+static inline bool song_cursor_prev(const Song* song, SongCursor* cursor) {
+    SongCursor previous = *cursor;
+    while(previous.offset == 0) {
+        if(previous.repeat > 0) {
+            previous.repeat--;
+        } else if(previous.entry > 0) {
+            previous.entry--;
+            previous.repeat = song->entries[previous.entry].repeat - 1;
+            previous.start = song_pattern_start(song, song->entries[previous.entry].pattern);
+        } else {
+            return false;
+        }
+        previous.offset = song->pattern_lengths[song->entries[previous.entry].pattern];
+    }
+    previous.offset--;
+    *cursor = previous;
+    return true;
+}
@@ -0,0 +1,396 @@
+#pragma once
+
+// Lesen und Schreiben von Klingeltönen im RTTTL-Format ("name:d=4,o=5,b=120:8c6,p,...") und im
+// Flipper Music Format (FMF) des Musikplayers der Firmware, beide schreiben Noten gleich. Der
+// Tokenizer bekommt die Datei Byte für Byte und sammelt höchstens ein Token in einem kleinen
+// festen Puffer, so dass auch Sammlungen mit tausenden Einträgen in einem Durchgang gelesen werden.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "musicmaker_sheet.h"
+
+#define RTTTL_EXTENSION ".rtttl"
+#define FMF_EXTENSION ".fmf"
+#define FMF_FILETYPE "Filetype: Flipper Music Format"
+#define TONE_TOKEN_SIZE 16
+#define TONE_NOTE_TOKEN_SIZE 8
+#define TONE_HEADER_SIZE 112
+// Anzahl Bytes am Dateianfang, an denen ein Klingelton erkannt wird
+#define TONE_DETECT_SIZE 64
+
+// Vorgaben der RTTTL-Spezifikation für Einträge, die sie nicht setzen
+#define RTTTL_DEFAULT_DURATION 4
+#define RTTTL_DEFAULT_OCTAVE 6
+#define RTTTL_DEFAULT_BPM 63
+
+// Vorgaben beim Export, Noten mit diesen Werten werden ohne Dauer bzw. Oktave geschrieben
+#define TONE_EXPORT_DURATION 4
+#define TONE_EXPORT_OCTAVE 5
+
+typedef enum {
+    ToneFormatRtttl, ToneFormatFmf
+} ToneFormat;
+
+// Funktion zum Erkennen des alten Textformats, es besteht nur aus Ziffern, Trennzeichen und Leerraum
+static inline bool tone_is_text_sheet(const uint8_t* data, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        if(data[i] == '\0' || strchr("0123456789,;- \r\n", data[i]) == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Funktion zum Erkennen eines Klingeltons an den ersten Bytes einer Datei, die weder Binärblatt
+// noch MIDI ist: FMF am Dateikopf, RTTTL an Zeichen, die im alten Textformat nicht vorkommen.
+// Auch Dateien, die kürzer als TONE_DETECT_SIZE sind, werden an ihrem echten Inhalt erkannt.
+static inline bool tone_detect(const uint8_t* data, size_t length, ToneFormat* format) {
+    size_t head = length < TONE_DETECT_SIZE ? length : TONE_DETECT_SIZE;
+    size_t filetype = strlen(FMF_FILETYPE);
+    if(head > 0 && strncmp((const char*)data, FMF_FILETYPE, head < filetype ? head : filetype) == 0) {
+        *format = ToneFormatFmf;
+        return true;
+    }
+    *format = ToneFormatRtttl;
+    return head > 0 && !tone_is_text_sheet(data, head);
+}
+
+// Zustände des Tokenizers. RTTTL: Name, Einstellungen und Noten je Zeile, FMF: "Schlüssel: Wert" je Zeile.
+typedef enum {
+    ToneStateName,
+    ToneStateSettings,
+    ToneStateNotes,
+    ToneStateFmfKey,
+    ToneStateFmfValue,
+    ToneStateFmfSkip,
+    ToneStateDone,
+} ToneState;
+
+// Rückruf für jede Note bzw. Pause, entry zählt die Einträge mit Noten ab 0
+typedef void (*ToneNoteCallback)(void* context, uint32_t entry, Note note);
+
+// Zustand des Tokenizers. Ungültige Tokens werden übersprungen und gezählt, ab entry_limit
+// Einträgen (0 = alle) ist der Import fertig.
+typedef struct {
+    ToneFormat format;
+    ToneState state;
+    char token[TONE_TOKEN_SIZE];
+    uint8_t token_length;
+    bool token_overflow;
+    char key;
+    uint8_t duration;
+    uint8_t octave;
+    uint16_t bpm;
+    uint16_t tempo_bpm;
+    bool entry_open;
+    uint32_t entries;
+    uint32_t entry_limit;
+    uint32_t notes;
+    uint32_t skipped;
+    ToneNoteCallback emit;
+    void* context;
+} ToneReader;
+
+// Funktion zum Setzen der Vorgaben zu Beginn eines Eintrags
+static inline void tone_reader_defaults(ToneReader* reader) {
+    reader->duration = RTTTL_DEFAULT_DURATION;
+    reader->octave = RTTTL_DEFAULT_OCTAVE;
+    reader->bpm = RTTTL_DEFAULT_BPM;
+    reader->entry_open = false;
+}
+
+// Funktion zum Vorbereiten des Tokenizers
+static inline void
+    tone_reader_init(ToneReader* reader, ToneFormat format, uint32_t entry_limit, ToneNoteCallback emit, void* context) {
+    *reader = (ToneReader){
+        .format = format,
+        .state = format == ToneFormatFmf ? ToneStateFmfKey : ToneStateName,
+        .entry_limit = entry_limit,
+        .emit = emit,
+        .context = context,
+    };
+    tone_reader_defaults(reader);
+}
+
+// Funktion zum Abschließen des gesammelten Tokens, gibt NULL für leere oder zu lange Tokens zurück
+static inline const char* tone_token_take(ToneReader* reader) {
+    bool valid = reader->token_length > 0 && !reader->token_overflow;
+    reader->token[reader->token_length] = '\0';
+    reader->token_length = 0;
+    reader->token_overflow = false;
+    return valid ? reader->token : NULL;
+}
+
+// Funktion zum Lesen einer Dezimalzahl, gibt das Zeichen dahinter zurück (Werte über 9999 werden begrenzt)
+static inline const char* tone_number(const char* text, uint32_t* value) {
+    *value = 0;
+    for(; *text >= '0' && *text <= '9'; text++) {
+        *value = *value < 10000 ? *value * 10 + (*text - '0') : *value;
+    }
+    return text;
+}
+
+// Funktion zum Prüfen einer Notendauer (1, 2, 4, 8, 16 oder 32)
+static inline bool tone_valid_duration(uint32_t duration) {
+    return duration >= 1 && duration <= 32 && (duration & (duration - 1)) == 0;
+}
+
+// Funktion zum Übernehmen einer Einstellung (d, o oder b), gibt false bei ungültigen Werten zurück
+static inline bool tone_setting(ToneReader* reader, char key, const char* text) {
+    uint32_t value;
+    if(*tone_number(text, &value) != '\0' || text[0] == '\0') {
+        return false;
+    }
+    switch(key | 0x20) {
+        case 'd':
+            if(!tone_valid_duration(value)) {
+                return false;
+            }
+            reader->duration = value;
+            return true;
+        case 'o':
+            if(value > 9) {
+                return false;
+            }
+            reader->octave = value;
+            return true;
+        case 'b':
+            if(value == 0) {
+                return false;
+            }
+            reader->bpm = value;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Funktion zum Ausgeben einer Dauer in Sechzehnteln als Note mit anschließenden Pausen
+static inline void tone_emit_span(ToneReader* reader, Note note, bool rest, uint32_t units) {
+    while(units > 0) {
+        uint8_t value = NoteWhole;
+        while((16U >> value) > units) {
+            value++;
+        }
+        note.value = rest ? value + RestWhole : value;
+        reader->emit(reader->context, reader->entries - 1, note);
+        units -= 16U >> value;
+        if(!rest) {
+            note = (Note){.step = 0};
+            rest = true;
+        }
+    }
+}
+
+// Funktion zum Auswerten eines Notentokens "[Dauer]Ton[#][Oktave][.]", Punkte dürfen auch vor der
+// Oktave stehen. Punktierte Noten werden zur Note mit anschließender Pause, Zweiunddreißigstel zu
+// Sechzehnteln. Gibt false bei ungültigen Tokens zurück.
+static inline bool tone_note(ToneReader* reader, const char* token) {
+    static const uint8_t semitones[] = {9, 11, 0, 2, 4, 5, 7, 11};
+    uint32_t duration;
+    const char* cursor = tone_number(token, &duration);
+    if(cursor == token) {
+        duration = reader->duration;
+    }
+    char letter = *cursor++ | 0x20;
+    bool rest = letter == 'p';
+    if(!tone_valid_duration(duration) || (!rest && (letter < 'a' || letter > 'h'))) {
+        return false;
+    }
+    int semitone = rest ? 0 : semitones[letter - 'a'];
+    if(*cursor == '#') {
+        semitone++;
+        cursor++;
+    }
+    uint32_t octave = reader->octave;
+    bool has_octave = false;
+    uint8_t dots = 0;
+    while(*cursor != '\0') {
+        if(*cursor == '.') {
+            dots++;
+            cursor++;
+        } else if(*cursor >= '0' && *cursor <= '9' && !has_octave) {
+            cursor = tone_number(cursor, &octave);
+            has_octave = true;
+        } else {
+            return false;
+        }
+    }
+    int midi = (octave + 1) * 12 + semitone;
+    if(!rest && midi > MIDI_NOTE_MAX) {
+        return false;
+    }
+
+    // Der erste gültige Ton öffnet den Eintrag, nach entry_limit Einträgen ist der Import fertig
+    if(!reader->entry_open) {
+        if(reader->entry_limit > 0 && reader->entries == reader->entry_limit) {
+            reader->state = ToneStateDone;
+            return true;
+        }
+        if(reader->entries == 0) {
+            reader->tempo_bpm = reader->bpm;
+        }
+        reader->entries++;
+        reader->entry_open = true;
+    }
+    uint32_t units = duration < 16 ? 16 / duration : 1;
+    uint32_t span = units + (dots > 0 ? units / 2 : 0) + (dots > 1 ? units / 4 : 0);
+    Note note = rest ? (Note){.step = 0} : note_from_midi(midi, NoteWhole);
+    tone_emit_span(reader, note, rest, span);
+    reader->notes++;
+    return true;
+}
+
+// Funktion zum Auswerten des gesammelten Tokens im aktuellen Zustand
+static inline void tone_token_end(ToneReader* reader) {
+    bool overflow = reader->token_overflow;
+    const char* token = tone_token_take(reader);
+    bool valid = true;
+    if(token == NULL) {
+        valid = !overflow;
+    } else if(reader->state == ToneStateSettings) {
+        valid = token[0] != '\0' && token[1] == '=' && tone_setting(reader, token[0], token + 2);
+    } else if(reader->state == ToneStateNotes) {
+        valid = tone_note(reader, token);
+    } else if(reader->state == ToneStateFmfValue) {
+        valid = tone_setting(reader, reader->key, token);
+    }
+    if(!valid) {
+        reader->skipped++;
+    }
+}
+
+// Funktion zum Verarbeiten des nächsten Bytes
+static inline void tone_reader_feed(ToneReader* reader, uint8_t byte) {
+    if(byte == ' ' || byte == '\t' || byte == '\r') {
+        return;
+    }
+    bool separator = byte == ',' || byte == '\n' || (byte == ':' && reader->state == ToneStateSettings);
+
+    switch(reader->state) {
+        case ToneStateName:
+            // Der Name wird nicht gebraucht, der Doppelpunkt beginnt einen neuen Eintrag
+            if(byte == ':') {
+                tone_reader_defaults(reader);
+                reader->state = ToneStateSettings;
+            }
+            return;
+
+        case ToneStateSettings:
+        case ToneStateNotes:
+        case ToneStateFmfValue:
+            if(!separator) {
+                break;
+            }
+            tone_token_end(reader);
+            if(reader->state == ToneStateDone) {
+                return;
+            }
+            if(byte == ':') {
+                reader->state = ToneStateNotes;
+            } else if(byte == '\n') {
+                reader->state = reader->format == ToneFormatFmf ? ToneStateFmfKey : ToneStateName;
+            }
+            return;
+
+        case ToneStateFmfKey:
+            if(byte == '\n') {
+                tone_token_take(reader);
+                return;
+            }
+            if(byte != ':') {
+                break;
+            }
+            {
+                const char* key = tone_token_take(reader);
+                reader->state = ToneStateFmfSkip;
+                if(key && strcmp(key, "Notes") == 0) {
+                    reader->state = ToneStateNotes;
+                } else if(key && (strcmp(key, "BPM") == 0 || strcmp(key, "Duration") == 0 || strcmp(key, "Octave") == 0)) {
+                    reader->key = key[0];
+                    reader->state = ToneStateFmfValue;
+                }
+            }
+            return;
+
+        case ToneStateFmfSkip:
+            if(byte == '\n') {
+                reader->state = ToneStateFmfKey;
+            }
+            return;
+
+        case ToneStateDone:
+            return;
+    }
+
+    if(reader->token_length < TONE_TOKEN_SIZE - 1) {
+        reader->token[reader->token_length++] = byte;
+    } else {
+        reader->token_overflow = true;
+    }
+}
+
+// Funktion zum Abschließen des Imports am Dateiende, gibt true zurück wenn Noten übernommen wurden
+static inline bool tone_reader_finish(ToneReader* reader) {
+    tone_reader_feed(reader, '\n');
+    return reader->notes > 0;
+}
+
+// Funktion zum Ermitteln des Tempos des ersten Eintrags, begrenzt auf den Bereich der App
+static inline int tone_reader_tempo_bpm(const ToneReader* reader) {
+    uint32_t bpm = reader->entries > 0 ? reader->tempo_bpm : TEMPO_DEFAULT_BPM;
+    return bpm < TEMPO_MIN_BPM ? TEMPO_MIN_BPM : (bpm > TEMPO_MAX_BPM ? TEMPO_MAX_BPM : (int)bpm);
+}
+
+// Funktion zum Schreiben des Dateianfangs bis zur ersten Note, gibt die Länge zurück
+static inline size_t tone_header(ToneFormat format, const char* name, int tempo_bpm, char* text, size_t size) {
+    int length = format == ToneFormatFmf ?
+                     snprintf(
+                         text,
+                         size,
+                         FMF_FILETYPE "\nVersion: 0\nBPM: %d\nDuration: %d\nOctave: %d\nNotes: ",
+                         tempo_bpm,
+                         TONE_EXPORT_DURATION,
+                         TONE_EXPORT_OCTAVE) :
+                     snprintf(text, size, "%s:d=%d,o=%d,b=%d:", name, TONE_EXPORT_DURATION, TONE_EXPORT_OCTAVE, tempo_bpm);
+    return length < 0 ? 0 : ((size_t)length < size ? (size_t)length : size - 1);
+}
+
+// Funktion zum Ermitteln des Trennzeichens zwischen zwei Noten
+static inline const char* tone_separator(ToneFormat format) {
+    return format == ToneFormatFmf ? ", " : ",";
+}
+
+// Funktion zum Schreiben einer Note als Token, Akkorde werden auf den Grundton reduziert und Töne
+// unter C0 eine Oktave höher geschrieben. Gibt die Länge zurück (kleiner als TONE_NOTE_TOKEN_SIZE).
+static inline uint8_t tone_note_token(const Note* note, ToneFormat format, char* token) {
+    static const uint8_t durations[5] = {1, 2, 4, 8, 16};
+    uint8_t duration = durations[note->value % 5];
+    int midi = note_midi(note);
+    char lower = format == ToneFormatFmf ? 0 : 0x20;
+    uint8_t length = 0;
+    if(duration != TONE_EXPORT_DURATION) {
+        if(duration >= 10) {
+            token[length++] = '0' + duration / 10;
+        }
+        token[length++] = '0' + duration % 10;
+    }
+    if(note->value >= RestWhole || midi < 0) {
+        token[length++] = 'P' | lower;
+    } else {
+        const char* name = pitch_names[midi % 12];
+        int octave = midi < 12 ? 0 : midi / 12 - 1;
+        token[length++] = name[0] | lower;
+        if(name[1] == '#') {
+            token[length++] = '#';
+        }
+        if(octave != TONE_EXPORT_OCTAVE) {
+            token[length++] = '0' + octave;
+        }
+    }
+    token[length] = '\0';
+    return length;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+// Hüllkurve (ADSR) und Vibrato für die Wiedergabe ohne Abhängigkeit von der Firmware. Alle Werte
+// sind Festkommazahlen aus vorberechneten Tabellen, die Modulation braucht weder float noch libm.
+
+#include <stdint.h>
+
+#include "musicmaker_sheet.h"
+
+// Abstand der Modulationsschritte, ein Vielfaches davon ist ARPEGGIO_STEP_US
+#define VOICE_TICK_US 4000UL
+#define VOICE_LEVEL_MAX 32767
+#define VOICE_SINE_SIZE 64
+#define VOICE_CURVE_STEPS 32
+#define VIBRATO_PERIOD_US 180000UL
+
+// Eine Periode Sinus in Q15
+static const int16_t voice_sine[VOICE_SINE_SIZE] = {
+    0,      3212,   6393,   9512,   12539,  15446,  18204,  20787,  23170,  25329,  27245,
+    28898,  30273,  31356,  32137,  32609,  32767,  32609,  32137,  31356,  30273,  28898,
+    27245,  25329,  23170,  20787,  18204,  15446,  12539,  9512,   6393,   3212,   0,
+    -3212,  -6393,  -9512,  -12539, -15446, -18204, -20787, -23170, -25329, -27245, -28898,
+    -30273, -31356, -32137, -32609, -32767, -32609, -32137, -31356, -30273, -28898, -27245,
+    -25329, -23170, -20787, -18204, -15446, -12539, -9512,  -6393,  -3212
+};
+
+// Exponentiell fallende Kurve von 1 auf 0 in Q15 für Abklingen und Ausklingen
+static const uint16_t voice_curve[VOICE_CURVE_STEPS + 1] = {
+    32767, 27995, 23913, 20422, 17436, 14881, 12697, 10828, 9229, 7862, 6693,
+    5692,  4837,  4105,  3479,  2944,  2486,  2094,  1759,  1472, 1227, 1017,
+    838,   685,   554,   441,   345,   263,   193,   133,   82,   38,   0
+};
+
+// Klangeinstellung: Anschlag, Abklingen, Haltepegel (Q15), Ausklingen nach dem Loslassen und
+// Vibratotiefe als Frequenzanteil in Q16, das Vibrato setzt erst nach der Verzögerung ein
+typedef struct {
+    const char* name;
+    uint32_t attack_us;
+    uint32_t decay_us;
+    uint16_t sustain;
+    uint32_t release_us;
+    uint16_t vibrato_depth;
+    uint32_t vibrato_delay_us;
+} VoicePreset;
+
+// "Flat" entspricht dem unveränderten Ton ohne Modulation
+static const VoicePreset voice_presets[] = {
+    {"Flat", 0, 0, VOICE_LEVEL_MAX, 0, 0, 0},
+    {"Organ", 8000, 0, VOICE_LEVEL_MAX, 24000, 600, 200000},
+    {"Pluck", 0, 240000, 4000, 48000, 0, 0},
+    {"Soft", 60000, 120000, 20000, 60000, 400, 120000},
+};
+#define VOICE_PRESET_COUNT (sizeof(voice_presets) / sizeof(voice_presets[0]))
+
+// Funktion zum Prüfen, ob eine Einstellung Modulationsschritte braucht
+static inline int voice_modulates(const VoicePreset* preset) {
+    return preset->attack_us || preset->decay_us || preset->sustain != VOICE_LEVEL_MAX || preset->release_us ||
+           preset->vibrato_depth;
+}
+
+// Funktion zum Ablesen der fallenden Kurve an einer Stelle innerhalb einer Dauer
+static inline uint16_t voice_curve_at(uint32_t time_us, uint32_t duration_us) {
+    return voice_curve[(uint64_t)time_us * VOICE_CURVE_STEPS / duration_us];
+}
+
+// Funktion zum Berechnen des Pegels (Q15) seit dem Einschalten, nach dem Ende der klingenden
+// Dauer klingt der erreichte Pegel aus
+static inline uint16_t voice_level(const VoicePreset* preset, uint32_t since_on_us, uint32_t gate_us) {
+    uint32_t time_us = since_on_us < gate_us ? since_on_us : gate_us;
+    uint32_t level = preset->sustain;
+    if(time_us < preset->attack_us) {
+        level = (uint64_t)VOICE_LEVEL_MAX * time_us / preset->attack_us;
+    } else if(time_us - preset->attack_us < preset->decay_us) {
+        uint32_t curve = voice_curve_at(time_us - preset->attack_us, preset->decay_us);
+        level = preset->sustain + (((VOICE_LEVEL_MAX - preset->sustain) * curve) >> 15);
+    }
+    if(since_on_us >= gate_us) {
+        uint32_t release_us = since_on_us - gate_us;
+        if(release_us >= preset->release_us) {
+            return 0;
+        }
+        level = (level * voice_curve_at(release_us, preset->release_us)) >> 15;
+    }
+    return level;
+}
+
+// Funktion zum Anwenden des Vibratos auf eine Frequenz in Hz * 65536
+static inline uint32_t voice_frequency(const VoicePreset* preset, uint32_t frequency_q16, uint32_t since_on_us) {
+    if(preset->vibrato_depth == 0 || since_on_us < preset->vibrato_delay_us) {
+        return frequency_q16;
+    }
+    uint32_t phase = (since_on_us - preset->vibrato_delay_us) % VIBRATO_PERIOD_US * VOICE_SINE_SIZE / VIBRATO_PERIOD_US;
+    int32_t offset = ((int32_t)voice_sine[phase] * preset->vibrato_depth) >> 15;
+    return ((uint64_t)frequency_q16 * (uint32_t)(65536 + offset)) >> 16;
+}
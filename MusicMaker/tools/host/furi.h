@@ -0,0 +1,162 @@
+#pragma once
+
+// Nachbildung der Firmware-Schnittstellen für die Messprogramme unter tools/, damit musicmaker.c
+// unverändert auf dem Rechner übersetzt werden kann. Threads, Sperren und Warteschlangen werden
+// nicht gebraucht und sind leer, die Zeit kommt von der monotonen Uhr des Rechners.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#define UNUSED(x) (void)(x)
+
+// Meldungen der App erscheinen nur mit -DHOST_LOG, damit sie die Messung nicht verfälschen
+#ifdef HOST_LOG
+#define FURI_LOG_E(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define FURI_LOG_W(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define FURI_LOG_I(tag, fmt, ...) fprintf(stderr, "I %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define FURI_LOG_D(tag, fmt, ...) fprintf(stderr, "D %s: " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define FURI_LOG_E(tag, fmt, ...) ((void)(tag))
+#define FURI_LOG_W(tag, fmt, ...) ((void)(tag))
+#define FURI_LOG_I(tag, fmt, ...) ((void)(tag))
+#define FURI_LOG_D(tag, fmt, ...) ((void)(tag))
+#endif
+
+#define FuriWaitForever 0xFFFFFFFFU
+
+typedef enum {
+    FuriStatusOk = 0,
+    FuriStatusError = -1,
+    FuriStatusErrorTimeout = -2,
+} FuriStatus;
+
+typedef enum {
+    FuriMutexTypeNormal,
+    FuriMutexTypeRecursive,
+} FuriMutexType;
+
+typedef struct FuriMessageQueue FuriMessageQueue;
+typedef struct FuriMutex FuriMutex;
+typedef struct FuriThread FuriThread;
+typedef int32_t (*FuriThreadCallback)(void* context);
+
+static inline uint64_t host_time_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static inline uint32_t furi_get_tick(void) {
+    return host_time_ns() / 1000000;
+}
+
+static inline uint32_t furi_kernel_get_tick_frequency(void) {
+    return 1000;
+}
+
+static inline void furi_delay_ms(uint32_t ms) {
+    UNUSED(ms);
+}
+
+static inline FuriMessageQueue* furi_message_queue_alloc(uint32_t count, uint32_t size) {
+    UNUSED(count);
+    UNUSED(size);
+    return NULL;
+}
+
+static inline void furi_message_queue_free(FuriMessageQueue* queue) {
+    UNUSED(queue);
+}
+
+static inline FuriStatus furi_message_queue_put(FuriMessageQueue* queue, const void* message, uint32_t timeout) {
+    UNUSED(queue);
+    UNUSED(message);
+    UNUSED(timeout);
+    return FuriStatusOk;
+}
+
+static inline FuriStatus furi_message_queue_get(FuriMessageQueue* queue, void* message, uint32_t timeout) {
+    UNUSED(queue);
+    UNUSED(message);
+    UNUSED(timeout);
+    return FuriStatusErrorTimeout;
+}
+
+static inline FuriMutex* furi_mutex_alloc(FuriMutexType type) {
+    UNUSED(type);
+    return NULL;
+}
+
+static inline void furi_mutex_free(FuriMutex* mutex) {
+    UNUSED(mutex);
+}
+
+static inline FuriStatus furi_mutex_acquire(FuriMutex* mutex, uint32_t timeout) {
+    UNUSED(mutex);
+    UNUSED(timeout);
+    return FuriStatusOk;
+}
+
+static inline FuriStatus furi_mutex_release(FuriMutex* mutex) {
+    UNUSED(mutex);
+    return FuriStatusOk;
+}
+
+static inline FuriThread* furi_thread_alloc_ex(const char* name, uint32_t stack_size, FuriThreadCallback callback, void* context) {
+    UNUSED(name);
+    UNUSED(stack_size);
+    UNUSED(callback);
+    UNUSED(context);
+    return NULL;
+}
+
+static inline void furi_thread_start(FuriThread* thread) {
+    UNUSED(thread);
+}
+
+static inline bool furi_thread_join(FuriThread* thread) {
+    UNUSED(thread);
+    return true;
+}
+
+static inline void furi_thread_free(FuriThread* thread) {
+    UNUSED(thread);
+}
+
+static inline size_t furi_thread_get_stack_space(void* thread) {
+    UNUSED(thread);
+    return 0;
+}
+
+static inline void* furi_thread_get_current_id(void) {
+    return NULL;
+}
+
+// Der Rechner hat keinen knappen Heap, die Prüfungen der App greifen daher nie
+static inline size_t memmgr_get_free_heap(void) {
+    return SIZE_MAX / 4;
+}
+
+static inline size_t memmgr_heap_get_max_free_block(void) {
+    return SIZE_MAX / 4;
+}
+
+// Records: nur die Speicherkarte wird verwendet, ein beliebiger Zeiger ungleich NULL genügt
+static inline void* furi_record_open(const char* name) {
+    return (void*)name;
+}
+
+static inline void furi_record_close(const char* name) {
+    UNUSED(name);
+}
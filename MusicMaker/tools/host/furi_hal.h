@@ -0,0 +1,43 @@
+#pragma once
+
+// Lautsprecher ohne Ausgabe und ein Zyklenzähler aus der Uhr des Rechners mit 64 Zyklen je µs
+#include <furi.h>
+
+#define HOST_CYCLES_PER_US 64
+
+typedef struct {
+    uint32_t CYCCNT;
+} HostDwt;
+
+static HostDwt host_dwt;
+
+static inline HostDwt* host_dwt_now(void) {
+    host_dwt.CYCCNT = host_time_ns() * HOST_CYCLES_PER_US / 1000;
+    return &host_dwt;
+}
+
+#define DWT (host_dwt_now())
+
+static inline uint32_t furi_hal_cortex_instructions_per_microsecond(void) {
+    return HOST_CYCLES_PER_US;
+}
+
+static inline bool furi_hal_speaker_acquire(uint32_t timeout) {
+    UNUSED(timeout);
+    return false;
+}
+
+static inline void furi_hal_speaker_release(void) {
+}
+
+static inline bool furi_hal_speaker_is_mine(void) {
+    return false;
+}
+
+static inline void furi_hal_speaker_start(float frequency, float volume) {
+    UNUSED(frequency);
+    UNUSED(volume);
+}
+
+static inline void furi_hal_speaker_stop(void) {
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+// Zeichenfläche mit 128x64 Pixeln im Speicher. Linien, Flächen, Kreise und XBM-Bilder werden
+// Pixel für Pixel gesetzt; Schrift zeichnet jedes Zeichen als 5x7-Block, was dem Aufwand eines
+// Glyphen der Firmware nahekommt. Gezählt werden die Zeichenaufrufe.
+#include <furi.h>
+#include <input/input.h>
+
+#define HOST_CANVAS_WIDTH 128
+#define HOST_CANVAS_HEIGHT 64
+#define HOST_CHAR_WIDTH 6
+
+typedef enum {
+    AlignLeft,
+    AlignRight,
+    AlignTop,
+    AlignBottom,
+    AlignCenter,
+} Align;
+
+typedef enum {
+    ColorWhite,
+    ColorBlack,
+    ColorXOR,
+} Color;
+
+typedef enum {
+    FontPrimary,
+    FontSecondary,
+} Font;
+
+typedef enum {
+    GuiLayerFullscreen,
+} GuiLayer;
+
+typedef struct {
+    uint8_t pixels[HOST_CANVAS_HEIGHT][HOST_CANVAS_WIDTH / 8];
+    uint32_t calls;
+} Canvas;
+
+typedef struct ViewPort ViewPort;
+typedef struct Gui Gui;
+typedef void (*ViewPortDrawCallback)(Canvas* canvas, void* context);
+typedef void (*ViewPortInputCallback)(InputEvent* event, void* context);
+
+#define RECORD_GUI "gui"
+
+static inline void host_canvas_dot(Canvas* canvas, int32_t x, int32_t y) {
+    if(x >= 0 && x < HOST_CANVAS_WIDTH && y >= 0 && y < HOST_CANVAS_HEIGHT) {
+        canvas->pixels[y][x / 8] |= 1 << (x % 8);
+    }
+}
+
+static inline void canvas_clear(Canvas* canvas) {
+    memset(canvas->pixels, 0, sizeof(canvas->pixels));
+    canvas->calls++;
+}
+
+static inline void canvas_commit(Canvas* canvas) {
+    canvas->calls++;
+}
+
+static inline void canvas_set_font(Canvas* canvas, Font font) {
+    UNUSED(font);
+    canvas->calls++;
+}
+
+static inline void canvas_set_color(Canvas* canvas, Color color) {
+    UNUSED(color);
+    canvas->calls++;
+}
+
+static inline void canvas_draw_dot(Canvas* canvas, int32_t x, int32_t y) {
+    host_canvas_dot(canvas, x, y);
+    canvas->calls++;
+}
+
+static inline void canvas_draw_box(Canvas* canvas, int32_t x, int32_t y, size_t width, size_t height) {
+    for(size_t row = 0; row < height; row++) {
+        for(size_t column = 0; column < width; column++) {
+            host_canvas_dot(canvas, x + column, y + row);
+        }
+    }
+    canvas->calls++;
+}
+
+static inline void canvas_draw_frame(Canvas* canvas, int32_t x, int32_t y, size_t width, size_t height) {
+    for(size_t column = 0; column < width; column++) {
+        host_canvas_dot(canvas, x + column, y);
+        host_canvas_dot(canvas, x + column, y + height - 1);
+    }
+    for(size_t row = 0; row < height; row++) {
+        host_canvas_dot(canvas, x, y + row);
+        host_canvas_dot(canvas, x + width - 1, y + row);
+    }
+    canvas->calls++;
+}
+
+static inline void canvas_draw_line(Canvas* canvas, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    int32_t dx = abs(x2 - x1);
+    int32_t dy = -abs(y2 - y1);
+    int32_t step_x = x1 < x2 ? 1 : -1;
+    int32_t step_y = y1 < y2 ? 1 : -1;
+    int32_t error = dx + dy;
+    while(true) {
+        host_canvas_dot(canvas, x1, y1);
+        if(x1 == x2 && y1 == y2) {
+            break;
+        }
+        int32_t twice = 2 * error;
+        if(twice >= dy) {
+            error += dy;
+            x1 += step_x;
+        }
+        if(twice <= dx) {
+            error += dx;
+            y1 += step_y;
+        }
+    }
+    canvas->calls++;
+}
+
+static inline void host_canvas_round(Canvas* canvas, int32_t x, int32_t y, size_t radius, bool filled) {
+    int32_t r = radius;
+    for(int32_t row = -r; row <= r; row++) {
+        for(int32_t column = -r; column <= r; column++) {
+            int32_t distance = column * column + row * row;
+            if(distance <= r * r && (filled || distance > (r - 1) * (r - 1))) {
+                host_canvas_dot(canvas, x + column, y + row);
+            }
+        }
+    }
+    canvas->calls++;
+}
+
+static inline void canvas_draw_circle(Canvas* canvas, int32_t x, int32_t y, size_t radius) {
+    host_canvas_round(canvas, x, y, radius, false);
+}
+
+static inline void canvas_draw_disc(Canvas* canvas, int32_t x, int32_t y, size_t radius) {
+    host_canvas_round(canvas, x, y, radius, true);
+}
+
+static inline void canvas_draw_xbm(Canvas* canvas, int32_t x, int32_t y, size_t width, size_t height, const uint8_t* bitmap) {
+    size_t stride = (width + 7) / 8;
+    for(size_t row = 0; row < height; row++) {
+        for(size_t column = 0; column < width; column++) {
+            if(bitmap[row * stride + column / 8] & (1 << (column % 8))) {
+                host_canvas_dot(canvas, x + column, y + row);
+            }
+        }
+    }
+    canvas->calls++;
+}
+
+static inline void canvas_draw_str(Canvas* canvas, int32_t x, int32_t y, const char* text) {
+    for(; *text; text++, x += HOST_CHAR_WIDTH) {
+        for(int32_t row = 0; row < 7; row++) {
+            for(int32_t column = 0; column < 5; column++) {
+                host_canvas_dot(canvas, x + column, y - 7 + row);
+            }
+        }
+    }
+    canvas->calls++;
+}
+
+static inline void canvas_draw_str_aligned(Canvas* canvas, int32_t x, int32_t y, Align horizontal, Align vertical, const char* text) {
+    int32_t width = strlen(text) * HOST_CHAR_WIDTH;
+    x -= horizontal == AlignRight ? width : horizontal == AlignCenter ? width / 2 : 0;
+    y += vertical == AlignTop ? 7 : vertical == AlignCenter ? 3 : 0;
+    canvas_draw_str(canvas, x, y, text);
+}
+
+static inline ViewPort* view_port_alloc(void) {
+    return NULL;
+}
+
+static inline void view_port_free(ViewPort* view_port) {
+    UNUSED(view_port);
+}
+
+static inline void view_port_update(ViewPort* view_port) {
+    UNUSED(view_port);
+}
+
+static inline void view_port_draw_callback_set(ViewPort* view_port, ViewPortDrawCallback callback, void* context) {
+    UNUSED(view_port);
+    UNUSED(callback);
+    UNUSED(context);
+}
+
+static inline void view_port_input_callback_set(ViewPort* view_port, ViewPortInputCallback callback, void* context) {
+    UNUSED(view_port);
+    UNUSED(callback);
+    UNUSED(context);
+}
+
+static inline void gui_add_view_port(Gui* gui, ViewPort* view_port, GuiLayer layer) {
+    UNUSED(gui);
+    UNUSED(view_port);
+    UNUSED(layer);
+}
+
+static inline void gui_remove_view_port(Gui* gui, ViewPort* view_port) {
+    UNUSED(gui);
+    UNUSED(view_port);
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+// Speicherkarte im Dateisystem des Rechners: Pfade unter /ext/ liegen im Ordner "ext" des
+// aktuellen Verzeichnisses.
+#include <furi.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RECORD_STORAGE "storage"
+#define HOST_PATH_SIZE 512
+
+typedef struct Storage Storage;
+
+typedef struct {
+    FILE* stream;
+    DIR* dir;
+    char dir_path[HOST_PATH_SIZE];
+} File;
+
+typedef struct {
+    uint8_t flags;
+    uint64_t size;
+} FileInfo;
+
+#define FSF_DIRECTORY (1 << 0)
+
+typedef enum {
+    FSAM_READ = (1 << 0),
+    FSAM_WRITE = (1 << 1),
+    FSAM_READ_WRITE = FSAM_READ | FSAM_WRITE,
+} FS_AccessMode;
+
+typedef enum {
+    FSOM_OPEN_EXISTING = 1,
+    FSOM_OPEN_ALWAYS = 2,
+    FSOM_OPEN_APPEND = 4,
+    FSOM_CREATE_NEW = 8,
+    FSOM_CREATE_ALWAYS = 16,
+} FS_OpenMode;
+
+typedef enum {
+    FSE_OK,
+    FSE_NOT_EXIST,
+    FSE_INTERNAL,
+} FS_Error;
+
+static inline const char* host_path(const char* path, char* buffer) {
+    snprintf(buffer, HOST_PATH_SIZE, "%s%s", strncmp(path, "/ext/", 5) == 0 ? "ext/" : "", path + (strncmp(path, "/ext/", 5) == 0 ? 5 : 0));
+    return buffer;
+}
+
+static inline File* storage_file_alloc(Storage* storage) {
+    UNUSED(storage);
+    return calloc(1, sizeof(File));
+}
+
+static inline void storage_file_free(File* file) {
+    free(file);
+}
+
+static inline bool storage_file_open(File* file, const char* path, FS_AccessMode access, FS_OpenMode mode) {
+    char buffer[HOST_PATH_SIZE];
+    host_path(path, buffer);
+    if(mode == FSOM_CREATE_ALWAYS) {
+        file->stream = fopen(buffer, access & FSAM_READ ? "w+b" : "wb");
+    } else if(access & FSAM_WRITE) {
+        file->stream = fopen(buffer, "r+b");
+        if(!file->stream && mode == FSOM_OPEN_ALWAYS) {
+            file->stream = fopen(buffer, "w+b");
+        }
+    } else {
+        file->stream = fopen(buffer, "rb");
+    }
+    return file->stream != NULL;
+}
+
+static inline bool storage_file_close(File* file) {
+    if(file->stream) {
+        fclose(file->stream);
+        file->stream = NULL;
+    }
+    return true;
+}
+
+static inline size_t storage_file_read(File* file, void* buffer, size_t size) {
+    return fread(buffer, 1, size, file->stream);
+}
+
+static inline size_t storage_file_write(File* file, const void* buffer, size_t size) {
+    return fwrite(buffer, 1, size, file->stream);
+}
+
+static inline bool storage_file_seek(File* file, uint32_t offset, bool from_start) {
+    return fseek(file->stream, offset, from_start ? SEEK_SET : SEEK_CUR) == 0;
+}
+
+static inline uint64_t storage_file_size(File* file) {
+    struct stat info;
+    fflush(file->stream);
+    return fstat(fileno(file->stream), &info) == 0 ? (uint64_t)info.st_size : 0;
+}
+
+static inline bool storage_file_truncate(File* file) {
+    fflush(file->stream);
+    return ftruncate(fileno(file->stream), ftell(file->stream)) == 0;
+}
+
+static inline bool storage_file_sync(File* file) {
+    return fflush(file->stream) == 0;
+}
+
+static inline bool storage_dir_open(File* file, const char* path) {
+    host_path(path, file->dir_path);
+    file->dir = opendir(file->dir_path);
+    return file->dir != NULL;
+}
+
+static inline bool storage_dir_close(File* file) {
+    if(file->dir) {
+        closedir(file->dir);
+        file->dir = NULL;
+    }
+    return true;
+}
+
+static inline bool storage_dir_rewind(File* file) {
+    rewinddir(file->dir);
+    return true;
+}
+
+static inline bool storage_dir_read(File* file, FileInfo* file_info, char* name, uint16_t name_size) {
+    struct dirent* entry;
+    while((entry = readdir(file->dir))) {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        char path[HOST_PATH_SIZE * 2];
+        struct stat info;
+        snprintf(path, sizeof(path), "%s/%s", file->dir_path, entry->d_name);
+        if(stat(path, &info) != 0) {
+            continue;
+        }
+        file_info->flags = S_ISDIR(info.st_mode) ? FSF_DIRECTORY : 0;
+        file_info->size = info.st_size;
+        snprintf(name, name_size, "%s", entry->d_name);
+        return true;
+    }
+    return false;
+}
+
+static inline bool file_info_is_dir(const FileInfo* file_info) {
+    return file_info->flags & FSF_DIRECTORY;
+}
+
+static inline FS_Error storage_common_stat(Storage* storage, const char* path, FileInfo* file_info) {
+    char buffer[HOST_PATH_SIZE];
+    struct stat info;
+    UNUSED(storage);
+    if(stat(host_path(path, buffer), &info) != 0) {
+        return FSE_NOT_EXIST;
+    }
+    file_info->flags = S_ISDIR(info.st_mode) ? FSF_DIRECTORY : 0;
+    file_info->size = info.st_size;
+    return FSE_OK;
+}
+
+static inline FS_Error storage_common_timestamp(Storage* storage, const char* path, uint32_t* timestamp) {
+    char buffer[HOST_PATH_SIZE];
+    struct stat info;
+    UNUSED(storage);
+    if(stat(host_path(path, buffer), &info) != 0) {
+        return FSE_NOT_EXIST;
+    }
+    *timestamp = info.st_mtime;
+    return FSE_OK;
+}
+
+static inline FS_Error storage_common_remove(Storage* storage, const char* path) {
+    char buffer[HOST_PATH_SIZE];
+    UNUSED(storage);
+    return remove(host_path(path, buffer)) == 0 ? FSE_OK : FSE_NOT_EXIST;
+}
+
+static inline FS_Error storage_common_rename(Storage* storage, const char* old_path, const char* new_path) {
+    char old_buffer[HOST_PATH_SIZE];
+    char new_buffer[HOST_PATH_SIZE];
+    UNUSED(storage);
+    return rename(host_path(old_path, old_buffer), host_path(new_path, new_buffer)) == 0 ? FSE_OK : FSE_INTERNAL;
+}
+
+// Legt wie die Firmware auch fehlende übergeordnete Ordner an
+static inline bool storage_simply_mkdir(Storage* storage, const char* path) {
+    char buffer[HOST_PATH_SIZE];
+    UNUSED(storage);
+    host_path(path, buffer);
+    for(char* slash = strchr(buffer, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        mkdir(buffer, 0755);
+        *slash = '/';
+    }
+    return mkdir(buffer, 0755) == 0 || errno == EEXIST;
+}
@@ -0,0 +1,568 @@
+// Rendert MusicMaker-Notenblätter auf dem Rechner als Rechteckwellen in WAV-Dateien und
+// gibt für jede Note die Schaltzeitpunkte aus, wie sie der Sequenzer der App verwendet.
+//
+// Bauen:   cc -O2 -o sheet2wav tools/sheet2wav.c
+// Aufruf:  sheet2wav [-r samplerate] [-t bpm] [-n] [-q] [-e] [-s klang] [-b] [-c] blatt.mms [blatt2.txt lied.mid ...]
+//   -r  Abtastrate der WAV-Datei (Standard 44100)
+//   -t  Tempo überschreiben (Standard: Tempo aus dem Dateikopf bzw. TEMPO_DEFAULT_BPM)
+//   -n  keine WAV-Datei schreiben, nur den Zeitbericht ausgeben
+//   -q  nur die Zusammenfassung je Datei ausgeben
+//   -e  jede Frequenzänderung des Lautsprechers mit Zeitstempel und Pegel ausgeben (inkl. Arpeggio)
+//   -b  RTTTL-/FMF-Dateien nur einlesen und den Durchsatz des Tokenizers messen
+//   -s  Klangeinstellung mit Hüllkurve und Vibrato (Flat, Organ, Pluck, Soft; Standard Flat)
+//   -c  Formaterkennung an kurzen Dateien prüfen (altes Textformat, RTTTL) und beenden
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "../musicmaker_sheet.h"
+#include "../musicmaker_midi.h"
+#include "../musicmaker_voice.h"
+#include "../musicmaker_song.h"
+#include "../musicmaker_tone.h"
+
+#define DEFAULT_SAMPLE_RATE 44100
+#define AMPLITUDE 8000
+#define RENDER_CHUNK 4096
+#define BENCHMARK_MIN_SECONDS 0.2
+
+typedef struct {
+    Note* notes;
+    uint32_t count;
+    Song song;
+    int tempo_bpm;
+} Sheet;
+
+typedef struct {
+    uint32_t sample_rate;
+    int tempo_bpm;
+    bool write_wav;
+    bool quiet;
+    bool edges;
+    uint32_t preset;
+    bool benchmark;
+} Options;
+
+// Funktion zum Anhängen einer Note an das letzte Muster
+static void sheet_append(Sheet* sheet, Note note) {
+    sheet->notes = realloc(sheet->notes, (sheet->count + 1) * sizeof(Note));
+    sheet->notes[sheet->count++] = note;
+    sheet->song.pattern_lengths[sheet->song.pattern_count - 1]++;
+}
+
+// Funktion zum Lesen des Song-Abschnitts ab Version 2, gibt die Anzahl der gelesenen Bytes zurück
+static size_t load_song(Song* song, const SheetHeader* header, const uint8_t* data, size_t size) {
+    SongChunk chunk;
+    if(size < sizeof(chunk)) {
+        return 0;
+    }
+    memcpy(&chunk, data, sizeof(chunk));
+    size_t length = sizeof(chunk) + chunk.pattern_count * sizeof(uint32_t) + chunk.entry_count * sizeof(SongEntry);
+    if(chunk.pattern_count > SONG_PATTERNS_MAX || chunk.entry_count > SONG_ENTRIES_MAX || size < length) {
+        return 0;
+    }
+    song->pattern_count = chunk.pattern_count;
+    song->entry_count = chunk.entry_count;
+    memcpy(song->pattern_lengths, data + sizeof(chunk), chunk.pattern_count * sizeof(uint32_t));
+    memcpy(song->entries, data + sizeof(chunk) + chunk.pattern_count * sizeof(uint32_t), chunk.entry_count * sizeof(SongEntry));
+    return song_valid(song, header->note_count) ? length : 0;
+}
+
+// Funktion zum Laden des Binärformats inklusive Prüfsumme
+static bool load_binary(Sheet* sheet, const uint8_t* data, size_t size) {
+    SheetHeader header;
+    memcpy(&header, data, sizeof(header));
+    if(header.version < SHEET_VERSION_FLAT || header.version > SHEET_VERSION ||
+       header.record_size < SHEET_RECORD_MIN_SIZE) {
+        fprintf(stderr, "unsupported version %u / record size %u\n", header.version, header.record_size);
+        return false;
+    }
+    Song song;
+    song_init(&song);
+    song.pattern_lengths[0] = header.note_count;
+    size_t song_size = 0;
+    if(header.version > SHEET_VERSION_FLAT) {
+        song_size = load_song(&song, &header, data + sizeof(header), size - sizeof(header));
+        if(song_size == 0) {
+            fprintf(stderr, "invalid song section\n");
+            return false;
+        }
+    }
+    if(size < sizeof(header) + song_size + (size_t)header.note_count * header.record_size) {
+        fprintf(stderr, "file truncated\n");
+        return false;
+    }
+    const uint8_t* record = data + sizeof(header) + song_size;
+    uint32_t checksum = sheet_crc32(0, data + sizeof(header), song_size + (size_t)header.note_count * header.record_size);
+    if(checksum != header.checksum) {
+        fprintf(stderr, "checksum mismatch\n");
+        return false;
+    }
+    for(uint32_t i = 0; i < header.note_count; i++, record += header.record_size) {
+        sheet_append(sheet, sheet_record_note(record, header.record_size));
+    }
+    sheet->song = song;
+    if(header.tempo_bpm >= TEMPO_MIN_BPM && header.tempo_bpm <= TEMPO_MAX_BPM) {
+        sheet->tempo_bpm = header.tempo_bpm;
+    }
+    return true;
+}
+
+static void midi_append(void* context, Note note) {
+    sheet_append(context, note);
+}
+
+// Funktion zum Importieren einer MIDI-Datei mit demselben Parser wie die App, Byte für Byte
+static bool load_midi(Sheet* sheet, const uint8_t* data, size_t size, const char* path) {
+    MidiReader midi;
+    midi_reader_init(&midi, midi_append, sheet);
+    clock_t start = clock();
+    size_t parsed = 0;
+    for(; parsed < size && midi.state != MidiStateDone; parsed++) {
+        if(!midi_reader_feed(&midi, data[parsed])) {
+            fprintf(stderr, "invalid MIDI data at offset %zu\n", parsed);
+            return false;
+        }
+    }
+    if(!midi_reader_finish(&midi)) {
+        fprintf(stderr, "no notes found\n");
+        return false;
+    }
+    sheet->tempo_bpm = midi_reader_tempo_bpm(&midi);
+    fprintf(
+        stderr,
+        "%s: MIDI format %u, track %u, %zu of %zu bytes parsed in %.3f ms, %u notes, parser state %zu bytes\n",
+        path,
+        midi.format,
+        midi.track - 1,
+        parsed,
+        size,
+        (double)(clock() - start) * 1000 / CLOCKS_PER_SEC,
+        sheet->count,
+        sizeof(midi));
+    return true;
+}
+
+// Funktion zum Übernehmen einer Note aus dem Tokenizer, jeder Eintrag wird wie in der App ein Muster
+static void tone_append(void* context, uint32_t entry, Note note) {
+    Sheet* sheet = context;
+    Song* song = &sheet->song;
+    if(entry >= song->pattern_count) {
+        song->pattern_lengths[song->pattern_count] = 0;
+        song->entries[song->entry_count].pattern = song->pattern_count;
+        song->entries[song->entry_count].repeat = 1;
+        song->pattern_count++;
+        song->entry_count++;
+    }
+    sheet_append(sheet, note);
+}
+
+// Funktion zum Importieren von RTTTL oder FMF mit demselben Tokenizer wie die App
+static bool load_tone(Sheet* sheet, const uint8_t* data, size_t size, ToneFormat format, const char* path) {
+    ToneReader tone;
+    tone_reader_init(&tone, format, SONG_PATTERNS_MAX, tone_append, sheet);
+    size_t parsed = 0;
+    for(; parsed < size && tone.state != ToneStateDone; parsed++) {
+        tone_reader_feed(&tone, data[parsed]);
+    }
+    if(!tone_reader_finish(&tone)) {
+        fprintf(stderr, "no notes found\n");
+        return false;
+    }
+    sheet->tempo_bpm = tone_reader_tempo_bpm(&tone);
+    fprintf(
+        stderr,
+        "%s: %s, %zu of %zu bytes parsed, %u entries, %u notes, %u invalid tokens\n",
+        path,
+        format == ToneFormatFmf ? "FMF" : "RTTTL",
+        parsed,
+        size,
+        tone.entries,
+        tone.notes,
+        tone.skipped);
+    return true;
+}
+
+// Funktion zum Laden des alten Textformats "x,y,wert;"
+static bool load_text(Sheet* sheet, char* text) {
+    for(char* token = strtok(text, ";"); token; token = strtok(NULL, ";")) {
+        int x_position, y_position, value;
+        if(sscanf(token, " %d,%d,%d", &x_position, &y_position, &value) == 3) {
+            uint8_t record[] = {y_position_step(y_position), value >= 0 ? value : NoteWhole};
+            sheet_append(sheet, sheet_record_note(record, sizeof(record)));
+        }
+    }
+    return true;
+}
+
+// Funktion zum Einlesen einer ganzen Datei, mit abschließender Null für das Textformat
+static uint8_t* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if(!file) {
+        perror(path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = malloc(length + 1);
+    if(fread(data, 1, length, file) != (size_t)length) {
+        perror(path);
+        free(data);
+        data = NULL;
+    } else {
+        data[length] = '\0';
+        *size = length;
+    }
+    fclose(file);
+    return data;
+}
+
+// Funktion zum Laden von Dateiinhalt mit abschließender Null, das Format wird wie in der App erkannt
+static bool load_sheet_data(Sheet* sheet, uint8_t* data, size_t size, const char* path) {
+    ToneFormat format;
+    if(size >= sizeof(SheetHeader) && memcmp(data, SHEET_MAGIC, 4) == 0) {
+        return load_binary(sheet, data, size);
+    } else if(size >= 4 && memcmp(data, MIDI_MAGIC, 4) == 0) {
+        return load_midi(sheet, data, size, path);
+    } else if(tone_detect(data, size, &format)) {
+        return load_tone(sheet, data, size, format, path);
+    }
+    return load_text(sheet, (char*)data);
+}
+
+static bool load_sheet(Sheet* sheet, const char* path) {
+    size_t size;
+    uint8_t* data = read_file(path, &size);
+    bool ok = data != NULL && load_sheet_data(sheet, data, size, path);
+    free(data);
+    return ok;
+}
+
+// Funktion zum Prüfen der Formaterkennung an Dateien, die kürzer als der Kopf eines Binärblatts
+// (16 Byte) oder als der Erkennungsbereich sind
+static bool check_short_files(void) {
+    static const struct {
+        const char* content;
+        uint32_t notes;
+    } cases[] = {
+        {"10,40,0;", 1},
+        {"10,40,0;20,50,2;", 2},
+        {"x:d=4:c", 1},
+        {"x:d=8,o=5,b=120:c,p,e", 3},
+    };
+    bool ok = true;
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        size_t size = strlen(cases[i].content);
+        uint8_t* data = malloc(size + 1);
+        memcpy(data, cases[i].content, size + 1);
+        ToneFormat format;
+        bool tone = tone_detect(data, size, &format);
+        Sheet sheet = {.tempo_bpm = TEMPO_DEFAULT_BPM};
+        song_init(&sheet.song);
+        bool loaded = load_sheet_data(&sheet, data, size, "short");
+        bool passed = loaded && sheet.count == cases[i].notes;
+        printf(
+            "%-24s %2zu bytes  %-5s %u notes  %s\n",
+            cases[i].content,
+            size,
+            tone ? (format == ToneFormatFmf ? "fmf" : "rtttl") : "text",
+            sheet.count,
+            passed ? "ok" : "FEHLER");
+        ok = ok && passed;
+        free(sheet.notes);
+        free(data);
+    }
+    return ok;
+}
+
+static void write_u16(FILE* file, uint16_t value) {
+    uint8_t bytes[2] = {value & 0xFF, value >> 8};
+    fwrite(bytes, 1, 2, file);
+}
+
+static void write_u32(FILE* file, uint32_t value) {
+    uint8_t bytes[4] = {value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24};
+    fwrite(bytes, 1, 4, file);
+}
+
+static void write_wav_header(FILE* file, uint32_t sample_rate, uint32_t samples) {
+    fwrite("RIFF", 1, 4, file);
+    write_u32(file, 36 + samples * 2);
+    fwrite("WAVEfmt ", 1, 8, file);
+    write_u32(file, 16);
+    write_u16(file, 1);
+    write_u16(file, 1);
+    write_u32(file, sample_rate);
+    write_u32(file, sample_rate * 2);
+    write_u16(file, 2);
+    write_u16(file, 16);
+    fwrite("data", 1, 4, file);
+    write_u32(file, samples * 2);
+}
+
+// Funktion zum Umrechnen einer Songposition in eine Samplenummer
+static uint32_t sample_at(uint64_t position_us, uint32_t sample_rate) {
+    return (uint32_t)((position_us * sample_rate + 500000) / 1000000);
+}
+
+// Funktion zum Rendern eines Blattes, die Flanken entsprechen denen von player_worker. Muster und
+// Reihenfolge werden wie in der App über den Cursor aufgelöst.
+static void render_sheet(const Sheet* sheet, const Options* options, const char* path) {
+    int tempo_bpm = options->tempo_bpm ? options->tempo_bpm : sheet->tempo_bpm;
+    const Song* song = &sheet->song;
+    SongCursor cursor;
+    uint64_t position_us = 0;
+    uint32_t sounding_notes = 0;
+    uint32_t played_notes = 0;
+    for(song_cursor_start(song, &cursor); !song_cursor_done(song, &cursor); song_cursor_next(song, &cursor)) {
+        position_us += note_duration_us(sheet->notes[song_cursor_index(&cursor)].value, tempo_bpm);
+    }
+    uint32_t total_samples = sample_at(position_us, options->sample_rate);
+
+    FILE* wav = NULL;
+    char wav_path[1024];
+    if(options->write_wav) {
+        snprintf(wav_path, sizeof(wav_path), "%s.wav", path);
+        wav = fopen(wav_path, "wb");
+        if(!wav) {
+            perror(wav_path);
+            return;
+        }
+        write_wav_header(wav, options->sample_rate, total_samples);
+    }
+
+    if(!options->quiet) {
+        printf("# %s @ %d BPM\n# index,pattern,value,midi,chord,frequency_hz,on_ms,off_ms,end_ms\n", path, tempo_bpm);
+    }
+
+    int16_t chunk[RENDER_CHUNK];
+    uint32_t chunk_length = 0;
+    uint32_t sample = 0;
+    position_us = 0;
+    for(song_cursor_start(song, &cursor); !song_cursor_done(song, &cursor); song_cursor_next(song, &cursor)) {
+        const Note* note = &sheet->notes[song_cursor_index(&cursor)];
+        uint32_t duration_us = note_duration_us(note->value, tempo_bpm);
+        uint32_t gate_us = note_gate_us(duration_us);
+        int midi = note_midi(note);
+        bool sounding = note->value < RestWhole && midi >= 0;
+        double frequency = sounding ? midi_frequencies[midi] / 65536.0 : 0.0;
+        uint32_t off_sample = sample_at(position_us + gate_us, options->sample_rate);
+        uint32_t end_sample = sample_at(position_us + duration_us, options->sample_rate);
+
+        if(!options->quiet) {
+            printf(
+                "%u,%c,%d,%d,%s,%.2f,%.3f,%.3f,%.3f\n",
+                played_notes,
+                'A' + song->entries[cursor.entry].pattern,
+                note->value,
+                midi,
+                chord_names[note->chord],
+                frequency,
+                position_us / 1000.0,
+                (position_us + gate_us) / 1000.0,
+                (position_us + duration_us) / 1000.0);
+        }
+        sounding_notes += sounding;
+        played_notes++;
+
+        // Die Phase beginnt mit jeder Frequenz neu, wie beim Neustart des Lautsprechers.
+        // Akkorde und Klangeinstellung wechseln im Raster voice_period_us ab dem Einschalten
+        // Ton und Pegel, genau wie sequencer_voice_tick in der App.
+        const VoicePreset* preset = &voice_presets[options->preset];
+        uint32_t voice_period_us = voice_modulates(preset) ? VOICE_TICK_US :
+                                                             (note->chord != ChordNone ? ARPEGGIO_STEP_US : 0);
+        bool voice_active = sounding && voice_period_us > 0;
+        uint32_t voice_steps = 0;
+        uint32_t frequency_q16 = sounding ? voice_frequency(preset, midi_frequencies[midi], 0) : 0;
+        uint16_t level = sounding ? voice_level(preset, 0, gate_us) : 0;
+        double phase = 0.0;
+        double phase_step = frequency_q16 / 65536.0 / options->sample_rate;
+        uint32_t on_sample = sample;
+        if(options->edges && sounding) {
+            printf("edge,%.3f,%.2f,%u\n", position_us / 1000.0, frequency_q16 / 65536.0, level);
+        }
+        for(; sample < end_sample; sample++) {
+            int16_t value = 0;
+            uint64_t since_on_us = (uint64_t)(sample - on_sample) * 1000000 / options->sample_rate;
+            if(voice_active && since_on_us >= (uint64_t)(voice_steps + 1) * voice_period_us) {
+                voice_steps++;
+                uint32_t step_us = voice_steps * voice_period_us;
+                uint8_t member = arpeggio_member(note, step_us);
+                uint32_t next_q16 = voice_frequency(preset, midi_frequencies[note_chord_midi(note, member)], step_us);
+                uint16_t next_level = voice_level(preset, step_us, gate_us);
+                if(step_us >= gate_us && next_level == 0) {
+                    voice_active = false;
+                    sounding = false;
+                    if(options->edges) {
+                        printf("edge,%.3f,0,0\n", (position_us + step_us) / 1000.0);
+                    }
+                } else if(next_q16 != frequency_q16 || next_level != level) {
+                    if(next_q16 != frequency_q16) {
+                        phase = 0.0;
+                        phase_step = next_q16 / 65536.0 / options->sample_rate;
+                    }
+                    frequency_q16 = next_q16;
+                    level = next_level;
+                    if(options->edges) {
+                        printf("edge,%.3f,%.2f,%u\n", (position_us + step_us) / 1000.0, frequency_q16 / 65536.0, level);
+                    }
+                }
+            }
+            // Ohne Ausklingen endet der Ton mit der klingenden Dauer
+            if(sounding && sample == off_sample && (!voice_active || preset->release_us == 0)) {
+                sounding = false;
+                voice_active = false;
+                if(options->edges) {
+                    printf("edge,%.3f,0,0\n", (position_us + gate_us) / 1000.0);
+                }
+            }
+            if(sounding) {
+                int32_t amplitude = (int32_t)AMPLITUDE * level / VOICE_LEVEL_MAX;
+                value = phase < 0.5 ? amplitude : -amplitude;
+                phase += phase_step;
+                if(phase >= 1.0) {
+                    phase -= 1.0;
+                }
+            }
+            if(wav) {
+                chunk[chunk_length++] = value;
+                if(chunk_length == RENDER_CHUNK) {
+                    fwrite(chunk, sizeof(int16_t), chunk_length, wav);
+                    chunk_length = 0;
+                }
+            }
+        }
+        position_us += duration_us;
+    }
+
+    if(wav) {
+        fwrite(chunk, sizeof(int16_t), chunk_length, wav);
+        fclose(wav);
+    }
+    printf(
+        "%s: %u notes (%u sounding) from %u stored in %u patterns, %.3f s, %u samples%s%s\n",
+        path,
+        played_notes,
+        sounding_notes,
+        sheet->count,
+        song->pattern_count,
+        position_us / 1000000.0,
+        total_samples,
+        wav ? " -> " : "",
+        wav ? wav_path : "");
+}
+
+// Funktion zum Suchen einer Klangeinstellung über ihren Namen, unbekannte Namen ergeben VOICE_PRESET_COUNT
+static uint32_t preset_index(const char* name) {
+    uint32_t index = 0;
+    while(index < VOICE_PRESET_COUNT && strcasecmp(voice_presets[index].name, name) != 0) {
+        index++;
+    }
+    return index;
+}
+
+static void tone_count(void* context, uint32_t entry, Note note) {
+    (void)entry;
+    (void)note;
+    (*(uint32_t*)context)++;
+}
+
+// Funktion zum Messen des Durchsatzes des Tokenizers über alle Einträge einer Sammlung, ohne
+// Mustergrenze. Die Datei wird so oft gelesen, bis mindestens BENCHMARK_MIN_SECONDS vergangen sind.
+static bool benchmark_tone(const char* path) {
+    size_t size;
+    uint8_t* data = read_file(path, &size);
+    ToneFormat format;
+    if(!data || !tone_detect(data, size, &format)) {
+        fprintf(stderr, "%s: not an RTTTL or FMF file\n", path);
+        free(data);
+        return false;
+    }
+
+    ToneReader tone;
+    uint32_t emitted = 0;
+    uint32_t passes = 0;
+    double seconds;
+    clock_t start = clock();
+    do {
+        tone_reader_init(&tone, format, 0, tone_count, &emitted);
+        for(size_t i = 0; i < size; i++) {
+            tone_reader_feed(&tone, data[i]);
+        }
+        tone_reader_finish(&tone);
+        passes++;
+        seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    } while(seconds < BENCHMARK_MIN_SECONDS);
+
+    printf(
+        "%s: %s, %zu bytes, %u entries, %u notes (%u sheet notes), %u invalid tokens, %.3f ms/pass, %.1f MB/s, %zu bytes state\n",
+        path,
+        format == ToneFormatFmf ? "FMF" : "RTTTL",
+        size,
+        tone.entries,
+        tone.notes,
+        emitted / passes,
+        tone.skipped,
+        seconds * 1000 / passes,
+        (double)size * passes / seconds / 1e6,
+        sizeof(tone));
+    free(data);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options = {.sample_rate = DEFAULT_SAMPLE_RATE, .write_wav = true};
+    int first_file = 1;
+    for(; first_file < argc && argv[first_file][0] == '-'; first_file++) {
+        const char* option = argv[first_file];
+        if(strcmp(option, "-r") == 0 && first_file + 1 < argc) {
+            options.sample_rate = strtoul(argv[++first_file], NULL, 10);
+        } else if(strcmp(option, "-t") == 0 && first_file + 1 < argc) {
+            options.tempo_bpm = atoi(argv[++first_file]);
+        } else if(strcmp(option, "-n") == 0) {
+            options.write_wav = false;
+        } else if(strcmp(option, "-q") == 0) {
+            options.quiet = true;
+        } else if(strcmp(option, "-e") == 0) {
+            options.edges = true;
+        } else if(strcmp(option, "-b") == 0) {
+            options.benchmark = true;
+        } else if(strcmp(option, "-c") == 0) {
+            return check_short_files() ? 0 : 1;
+        } else if(strcmp(option, "-s") == 0 && first_file + 1 < argc) {
+            options.preset = preset_index(argv[++first_file]);
+        } else {
+            first_file = argc;
+        }
+    }
+    if(first_file >= argc || options.sample_rate == 0 || options.preset >= VOICE_PRESET_COUNT ||
+       (options.tempo_bpm && (options.tempo_bpm < TEMPO_MIN_BPM || options.tempo_bpm > TEMPO_MAX_BPM))) {
+        fprintf(stderr, "usage: %s [-r samplerate] [-t bpm] [-n] [-q] [-e] [-s sound] [-b] [-c] sheet...\n", argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    clock_t start = clock();
+    for(int i = first_file; i < argc; i++) {
+        if(options.benchmark) {
+            failures += !benchmark_tone(argv[i]);
+            continue;
+        }
+        Sheet sheet = {.tempo_bpm = TEMPO_DEFAULT_BPM};
+        song_init(&sheet.song);
+        if(load_sheet(&sheet, argv[i])) {
+            render_sheet(&sheet, &options, argv[i]);
+        } else {
+            fprintf(stderr, "%s: invalid sheet\n", argv[i]);
+            failures++;
+        }
+        free(sheet.notes);
+    }
+    fprintf(stderr, "%d sheets in %.3f s\n", argc - first_file, (double)(clock() - start) / CLOCKS_PER_SEC);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+// Misst auf dem Rechner Speichern, Laden und Zeichnen von Notenblättern mit dem Code der App selbst:
+// musicmaker.c wird gegen die nachgebildeten Firmware-Header unter tools/host übersetzt. Die Dateien
+// landen wie auf der SD-Karte unter ext/apps_assets/musicmaker, hier im aktuellen Verzeichnis.
+//
+// Bauen:   cc -O2 -Itools/host -o sheet_bench tools/sheet_bench.c
+// Aufruf:  sheet_bench [noten ...]   (Standard 100 1000 10000)
+//
+// Je Notenzahl wird ein zufälliges Blatt aus vier Mustern in jedem Format gespeichert (save_notes,
+// samt Eintrag im Index) und wieder eingelesen (load_sheet_file). Danach wird die Notenansicht am
+// Anfang, in der Mitte und am Ende des Blatts gezeichnet (draw_music_lines); die Zeit je Bild soll
+// nicht von der Länge des Blatts abhängen. Die Zeichenfläche setzt jedes Pixel einzeln, die Zeiten
+// sind daher nur untereinander vergleichbar, die Zahl der Zeichenaufrufe gilt auch für das Gerät.
+
+#include "../musicmaker.c"
+
+#define BENCHMARK_MIN_SECONDS 0.2
+#define BENCH_PATTERNS 4
+
+// Funktion zum Füllen des Blatts mit zufälligen Noten, die Muster werden gleich lang und laufen
+// abwechselnd ein- und zweimal
+static void bench_fill(NoteSheet* sheet, int count) {
+    note_store_clear(&sheet->notes);
+    song_init(&sheet->song);
+    int patterns = MIN(BENCH_PATTERNS, count);
+    for(int i = 0; i < count; i++) {
+        Note note = {
+            .step = rand() % (NOTE_STEP_MAX + 1),
+            .octave = rand() % 3 - 1,
+            .value = rand() % (RestSixteenth + 1),
+            .accidental = rand() % 3,
+            .chord = rand() % 4};
+        uint8_t pattern = (uint64_t)i * patterns / count;
+        if(pattern == sheet->song.pattern_count) {
+            sheet->song.pattern_lengths[sheet->song.pattern_count++] = 0;
+        }
+        sheet_insert_note(sheet, pattern, i, note);
+    }
+    sheet->song.entry_count = patterns;
+    for(int i = 0; i < patterns; i++) {
+        sheet->song.entries[i].pattern = i;
+        sheet->song.entries[i].repeat = 1 + i % 2;
+    }
+}
+
+// Funktion zum Laden einer gespeicherten Datei, gibt die Zahl der geladenen Noten zurück. Ein
+// Export nur aus Pausen ergibt eine leere Datei und damit 0.
+static uint32_t bench_load(Storage* storage, NoteSheet* sheet, const char* path) {
+    uint32_t skipped = 0;
+    File* file = storage_file_alloc(storage);
+    bool success = storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING) && load_sheet_file(sheet, file, &skipped);
+    storage_file_close(file);
+    storage_file_free(file);
+    return success ? note_store_count(&sheet->notes) : 0;
+}
+
+static void bench_save_load(Storage* storage, NoteSheet* sheet, NoteSheet* loaded, int count) {
+    for(SaveFormat format = 0; format < SaveFormatCount; format++) {
+        char path[128];
+        FileInfo info = {0};
+        snprintf(path, sizeof(path), "%s/%s%s", SHEET_DIRECTORY, sheet->save_name, save_extensions[format]);
+
+        int runs = 0;
+        uint64_t start = host_time_ns();
+        double seconds;
+        do {
+            save_notes(sheet, format);
+            runs++;
+            seconds = (host_time_ns() - start) / 1e9;
+        } while(seconds < BENCHMARK_MIN_SECONDS);
+        double save_ms = seconds * 1000 / runs;
+        storage_common_stat(storage, path, &info);
+
+        uint32_t notes;
+        runs = 0;
+        start = host_time_ns();
+        do {
+            notes = bench_load(storage, loaded, path);
+            runs++;
+            seconds = (host_time_ns() - start) / 1e9;
+        } while(seconds < BENCHMARK_MIN_SECONDS);
+        printf(
+            "%6d %-6s %9.3f ms save %9.3f ms load %8llu bytes %6lu notes loaded\n",
+            count,
+            save_extensions[format] + 1,
+            save_ms,
+            seconds * 1000 / runs,
+            (unsigned long long)info.size,
+            (unsigned long)notes);
+    }
+}
+
+static void bench_draw(NoteSheet* sheet, int count) {
+    static Canvas canvas;
+    static const char* const positions[] = {"start", "middle", "end"};
+    int indices[] = {0, count / 2, count - 1};
+    sheet->mode = ModeNotes;
+    sheet->status[0] = '\0';
+    for(int i = 0; i < 3; i++) {
+        sheet->current_note_index = indices[i];
+        sheet->scroll_offset = 0;
+        scroll_to_note(sheet, indices[i]);
+
+        int runs = 0;
+        canvas.calls = 0;
+        uint64_t start = host_time_ns();
+        double seconds;
+        do {
+            draw_music_lines(&canvas, sheet);
+            runs++;
+            seconds = (host_time_ns() - start) / 1e9;
+        } while(seconds < BENCHMARK_MIN_SECONDS);
+        printf(
+            "%6d draw   %9.3f us/frame at %-6s %5lu calls/frame\n",
+            count,
+            seconds * 1e6 / runs,
+            positions[i],
+            (unsigned long)(canvas.calls / runs));
+    }
+}
+
+static void benchmark(Storage* storage, int count) {
+    NoteSheet* sheet = calloc(1, sizeof(NoteSheet));
+    NoteSheet* loaded = calloc(1, sizeof(NoteSheet));
+    sheet->tempo_bpm = TEMPO_DEFAULT_BPM;
+    loaded->tempo_bpm = TEMPO_DEFAULT_BPM;
+    snprintf(sheet->save_name, sizeof(sheet->save_name), "bench");
+    bench_fill(sheet, count);
+
+    bench_save_load(storage, sheet, loaded, count);
+    bench_draw(sheet, count);
+
+    note_store_free(&sheet->notes);
+    note_store_free(&loaded->notes);
+    free(sheet);
+    free(loaded);
+}
+
+int main(int argc, char** argv) {
+    static const int defaults[] = {100, 1000, 10000};
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    srand(1);
+    if(argc < 2) {
+        for(size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++) {
+            benchmark(storage, defaults[i]);
+        }
+    }
+    for(int i = 1; i < argc; i++) {
+        int count = atoi(argv[i]);
+        if(count <= 0) {
+            fprintf(stderr, "usage: %s [notes ...]\n", argv[0]);
+            return 1;
+        }
+        benchmark(storage, count);
+    }
+    return 0;
+}
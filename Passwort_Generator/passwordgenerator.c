@@ -9,17 +9,175 @@
 #include <storage/storage.h>
 #include <stdbool.h>
 
-#define PASSGEN_MAX_LENGTH 17
-#define MENU_OPTION_COUNT 3
+#include "passwordgenerator_index.h"
+#include "passwordgenerator_random.h"
+#include "passwordgenerator_policy.h"
+#include "passwordgenerator_wordlist.h"
+#include "passwordgenerator_crypto.h"
+
+// Room for the longest passphrase including separators and terminator; policies stay below
+#define PASSGEN_MAX_LENGTH (PASSPHRASE_WORDS * WORDLIST_RECORD_SIZE)
+#define MENU_OPTION_COUNT 5
 #define MAX_FILENAME_LENGTH 64
 #define AES_KEY_SIZE 16
 
+// All entries live in one append-only vault file. Every save appends an entry record (the
+// journal); every VAULT_CHECKPOINT_ENTRIES saves a sorted index record is appended and the
+// header is pointed at it, so opening reads one index plus the short journal behind it.
+#define VAULT_DIRECTORY "/ext/apps_assets/pwgen"
+#define VAULT_FILENAME "vault.pwv"
+#define VAULT_PATH VAULT_DIRECTORY "/" VAULT_FILENAME
+#define VAULT_MAGIC "PWV1"
+#define VAULT_RECORD_SYNC 0xA5
+#define VAULT_CHECKPOINT_ENTRIES 32
+#define VAULT_BUFFER_SIZE 256
+#define VAULT_COMPACT_PATH VAULT_DIRECTORY "/vault.tmp"
+#define VAULT_ENTRY_MAX (1 + MAX_FILENAME_LENGTH + SEAL_NONCE_SIZE + SEAL_TAG_SIZE + PASSGEN_MAX_LENGTH)
+#define LEGACY_PASSWORD_SIZE 17
+#define LEGACY_ENTRY_SIZE (AES_KEY_SIZE + LEGACY_PASSWORD_SIZE)
+
+// Entries are sealed with keys derived from a master PIN of d-pad presses. The scrypt memory
+// and passes are chosen on the device when the PIN is set and kept with the salt in a key file.
+// The key file lets anyone with a copy of the SD card test PINs offline at PC speed, so the KDF
+// only slows that down: a PIN of short and long arrow presses has 3 bits per press, and the
+// minimum length gives 2^30 PINs.
+#define VAULT_KEY_PATH VAULT_DIRECTORY "/vault.key"
+#define VAULT_KEY_MAGIC "PWK1"
+#define PIN_LENGTH_MIN 10
+#define PIN_LENGTH_MAX 16
+#define PIN_TEXT(value) #value
+#define PIN_NUMBER_TEXT(value) PIN_TEXT(value)
+#define KDF_TARGET_MS 500
+#define KDF_LOG2_N_MAX 8
+#define KDF_LOG2_N_MIN 5
+#define KDF_R 1
+#define KDF_SALT_SIZE 16
+
+// Policies are a text file next to the vault so they can also be edited on a PC
+#define POLICY_PATH VAULT_DIRECTORY "/policies.txt"
+#define POLICY_MAX 8
+#define POLICY_FILE_MAX 1024
+#define POLICY_VISIBLE_ROWS 4
+
+// Decrypted entries kept while browsing: the shown one, its neighbours and one spare
+#define ENTRY_CACHE_SIZE 4
+#define ENTRY_PREFETCH_MAX 2
+#define ENTRY_PREFETCH_IDLE_MS 10
+
+// Diceware wordlist supplied by the user and the word index built from it
+#define WORDLIST_PATH VAULT_DIRECTORY "/wordlist.txt"
+#define WORDLIST_INDEX_PATH VAULT_DIRECTORY "/wordlist.idx"
+#define WORDLIST_CHUNK_SIZE 256
+
+// Characters per line when a password is wrapped on screen
+#define PASSWORD_LINE_CHARS 21
+
 typedef enum {
+    VaultRecordEntry = 1,
+    VaultRecordIndex = 2,
+    VaultRecordSealed = 3,
+} VaultRecordType;
+
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint32_t index_offset;
+} VaultHeader;
+
+// Entry payload (old XOR format): name length, name, key, encrypted password including its
+// terminator. Sealed payload: name length, name, nonce, tag, password and terminator encrypted
+// with the session key. Index payload: entry count, per entry the record offset, name length and
+// name sorted by name, then the number of entries possibly still in the old format. Indexes
+// written before sealing end after the entries.
+typedef struct __attribute__((packed)) {
+    uint8_t sync;
+    uint8_t type;
+    uint32_t length;
+    uint32_t checksum;
+} VaultRecordHeader;
+
+// Contents of VAULT_KEY_PATH: scrypt parameters, salt and a value to recognise the right PIN
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint8_t log2_n;
+    uint8_t r;
+    uint16_t passes;
+    uint8_t salt[KDF_SALT_SIZE];
+    uint8_t verifier[SESSION_VERIFIER_SIZE];
+} VaultKeyFile;
+
+typedef struct {
+    Storage* storage;
+    File* file;
+    VaultIndex index;
+    uint32_t end;
+    int journal_count;
+    // Upper bound on entries in the old format, so unlocking only searches for them when needed
+    uint32_t legacy_count;
+    bool open;
+    VaultKeyFile key;
+    bool has_key;
+    SessionKeys keys;
+    bool unlocked;
+} Vault;
+
+// Buffered sequential reader over one record payload
+typedef struct {
+    File* file;
+    uint8_t buffer[VAULT_BUFFER_SIZE];
+    size_t length;
+    size_t position;
+    uint32_t remaining;
+    uint32_t checksum;
+} VaultReader;
+
+typedef struct {
+    uint32_t offset;
+    uint32_t last_used;
+    bool valid;
+    char password[PASSGEN_MAX_LENGTH];
+} CachedEntry;
+
+// Small LRU of decrypted entries keyed by record offset, plus the entries to read ahead when idle
+typedef struct {
+    CachedEntry entries[ENTRY_CACHE_SIZE];
+    uint32_t clock;
+    int prefetch[ENTRY_PREFETCH_MAX];
+    int prefetch_count;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t prefetched;
+} EntryCache;
+
+typedef struct {
+    Storage* storage;
+    File* index;
+    uint32_t count;
+    bool open;
+} Wordlist;
+
+// Buffered output of index records while building
+typedef struct {
+    File* file;
+    uint8_t buffer[WORDLIST_CHUNK_SIZE];
+    size_t used;
+    bool ok;
+} WordlistWriter;
+
+typedef enum {
+    UnlockEnter,
+    UnlockChoose,
+    UnlockConfirm,
+    UnlockBlocked,
+} UnlockStage;
+
+typedef enum {
+    StateUnlock,
     StateMenu,
     StateEnterFilename,
     StateGeneratePassword,
     StateSelectFile,
     StateDisplayPassword,
+    StateSelectPolicy,
     StateExit,
 } AppState;
 
@@ -32,165 +190,1025 @@ typedef struct {
     char filename[MAX_FILENAME_LENGTH];
     char password[PASSGEN_MAX_LENGTH + 1];
     int menu_option;
-    char** file_list;
-    int file_count;
+    char pin[PIN_LENGTH_MAX + 1];
+    char pin_first[PIN_LENGTH_MAX + 1];
+    UnlockStage unlock_stage;
+    bool unlock_pending;
+    Vault vault;
+    EntryCache cache;
+    EntropyPool entropy;
+    PasswordPolicy policies[POLICY_MAX];
+    int policy_count;
+    int policy_selected;
+    int policy_cursor;
+    PolicyTable policy_table;
+    Wordlist wordlist;
+    bool passphrase;
+    const char* message;
     int selected_file;
     int char_set_index[MAX_FILENAME_LENGTH];
 } App;
 
-static const char charsets[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789!$%&-";
+
+// Written to POLICY_PATH when it does not exist; the first one matches the original generator
+static const PasswordPolicy default_policies[] = {
+    {"Default", 16, POLICY_CLASSES_ALL, {0, 0, 1, 1}, false},
+    {"Strong", 24, POLICY_CLASSES_ALL, {2, 2, 2, 2}, true},
+    {"Readable", 12, POLICY_CLASSES_ALL & ~(1 << PolicyClassSpecial), {1, 1, 1, 0}, true},
+    {"PIN", 6, 1 << PolicyClassDigit, {0, 0, 0, 0}, false},
+};
 static const char charset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
 
-// XOR encryption/decryption
+// XOR decryption of entries in the old format
 void xor_encrypt_decrypt(const unsigned char* input, unsigned char* output, const unsigned char* key, size_t length) {
     for (size_t i = 0; i < length; i++) {
         output[i] = input[i] ^ key[i % AES_KEY_SIZE];
     }
 }
 
-// Generate a random encryption key
-void generate_random_key(unsigned char* key, size_t key_size) {
-    for (size_t i = 0; i < key_size; i++) {
-        key[i] = rand() % 256;
+// Clear memory holding secrets in a way the compiler cannot drop as a dead store
+void secure_zero(void* data, size_t length) {
+    volatile uint8_t* bytes = data;
+    while (length--) {
+        *bytes++ = 0;
     }
 }
 
-// Save encrypted password to file
-void save_password_to_file(const char* filename, const char* password) {
-    Storage* storage = furi_record_open(RECORD_STORAGE);
-    File* file = storage_file_alloc(storage);
+// CRC32 over record payloads, using a 16-entry table to keep flash usage small
+uint32_t vault_crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+// Read a record header, false at the end of the file or on a damaged record
+bool vault_read_header(Vault* vault, uint32_t offset, VaultRecordHeader* header) {
+    return storage_file_seek(vault->file, offset, true) &&
+           storage_file_read(vault->file, header, sizeof(*header)) == sizeof(*header) &&
+           header->sync == VAULT_RECORD_SYNC && offset + sizeof(*header) + header->length <= vault->end;
+}
+
+// Copy bytes out of a record payload, refilling the buffer as needed
+bool vault_reader_take(VaultReader* reader, void* data, size_t length) {
+    uint8_t* bytes = data;
+    while (length > 0) {
+        if (reader->position == reader->length) {
+            size_t chunk = reader->remaining < VAULT_BUFFER_SIZE ? reader->remaining : VAULT_BUFFER_SIZE;
+            if (chunk == 0 || storage_file_read(reader->file, reader->buffer, chunk) != chunk) {
+                return false;
+            }
+            reader->checksum = vault_crc32(reader->checksum, reader->buffer, chunk);
+            reader->remaining -= chunk;
+            reader->length = chunk;
+            reader->position = 0;
+        }
+        size_t count = reader->length - reader->position;
+        if (count > length) {
+            count = length;
+        }
+        memcpy(bytes, &reader->buffer[reader->position], count);
+        reader->position += count;
+        bytes += count;
+        length -= count;
+    }
+    return true;
+}
+
+// Load a checkpointed index record, which is already sorted. Slots and names are
+// reserved up front from the record length, so the load is two allocations at most.
+bool vault_load_index(Vault* vault, uint32_t offset) {
+    VaultRecordHeader header;
+    if (!vault_read_header(vault, offset, &header) || header.type != VaultRecordIndex) {
+        return false;
+    }
+    VaultReader reader = {.file = vault->file, .remaining = header.length};
+    uint32_t count;
+    if (!vault_reader_take(&reader, &count, sizeof(count)) || count > header.length / (sizeof(uint32_t) + 1)) {
+        return false;
+    }
+    if (!vault_index_reserve(&vault->index, count, header.length)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        VaultIndex* index = &vault->index;
+        VaultSlot* slot = &index->slots[index->count];
+        uint8_t name_length;
+        if (!vault_reader_take(&reader, &slot->offset, sizeof(slot->offset)) ||
+            !vault_reader_take(&reader, &name_length, 1) || name_length > MAX_FILENAME_LENGTH ||
+            !vault_reader_take(&reader, &index->names[index->names_used], name_length)) {
+            return false;
+        }
+        index->names[index->names_used + name_length] = '\0';
+        slot->name = index->names_used;
+        index->names_used += name_length + 1;
+        index->count++;
+    }
+    // Any entry of an index without the count may be in the old format
+    vault->legacy_count = count;
+    if (reader.remaining + reader.length - reader.position == sizeof(vault->legacy_count) &&
+        !vault_reader_take(&reader, &vault->legacy_count, sizeof(vault->legacy_count))) {
+        return false;
+    }
+    return reader.remaining == 0 && reader.position == reader.length && reader.checksum == header.checksum;
+}
 
-    const char* dir = "/ext/apps_assets/pwgen";
-    char full_path[MAX_FILENAME_LENGTH + strlen(dir) + 2];
-    snprintf(full_path, sizeof(full_path), "%s/%s", dir, filename);
+// Bytes between the name and the password of an entry record
+uint32_t vault_entry_overhead(uint8_t type) {
+    return type == VaultRecordSealed ? SEAL_NONCE_SIZE + SEAL_TAG_SIZE : AES_KEY_SIZE;
+}
 
-    unsigned char key[AES_KEY_SIZE];
-    generate_random_key(key, AES_KEY_SIZE);
+// Read and verify an entry record of either format into a buffer of VAULT_ENTRY_MAX bytes
+bool vault_read_entry(Vault* vault, uint32_t offset, uint8_t* payload, uint32_t* length, uint8_t* type) {
+    VaultRecordHeader header;
+    if (!vault_read_header(vault, offset, &header) ||
+        (header.type != VaultRecordEntry && header.type != VaultRecordSealed) || header.length > VAULT_ENTRY_MAX ||
+        header.length < 1 + vault_entry_overhead(header.type) + 1) {
+        return false;
+    }
+    *length = header.length;
+    *type = header.type;
+    // VAULT_ENTRY_MAX allows for the longest name, so the password length is checked on its own
+    return storage_file_read(vault->file, payload, header.length) == header.length &&
+           payload[0] + 1 + vault_entry_overhead(header.type) < header.length && payload[0] <= MAX_FILENAME_LENGTH &&
+           header.length - 1 - payload[0] - vault_entry_overhead(header.type) <= PASSGEN_MAX_LENGTH &&
+           vault_crc32(0, payload, header.length) == header.checksum;
+}
+
+// Replay the journal from an offset. A bulk replay (no usable index) appends every entry
+// and sorts once at the end instead of inserting each in order. A damaged record can only
+// be a torn append at the end of the file, so the file is cut there.
+void vault_replay(Vault* vault, uint32_t offset, bool bulk) {
+    VaultRecordHeader header;
+    while (offset < vault->end) {
+        uint8_t payload[VAULT_ENTRY_MAX];
+        uint32_t length;
+        uint8_t type;
+        if (!vault_read_header(vault, offset, &header)) {
+            break;
+        }
+        if (header.type == VaultRecordEntry || header.type == VaultRecordSealed) {
+            if (!vault_read_entry(vault, offset, payload, &length, &type)) {
+                break;
+            }
+            if (bulk) {
+                vault_index_append(&vault->index, (const char*)&payload[1], payload[0], offset);
+            } else {
+                char name[MAX_FILENAME_LENGTH + 1];
+                memcpy(name, &payload[1], payload[0]);
+                name[payload[0]] = '\0';
+                vault_index_set(&vault->index, name, offset);
+            }
+            vault->legacy_count += header.type == VaultRecordEntry;
+            vault->journal_count++;
+        }
+        offset += sizeof(header) + header.length;
+    }
+    if (bulk) {
+        vault_index_sort(&vault->index);
+    }
+    if (offset < vault->end) {
+        FURI_LOG_W("PassGen", "Vault cut at damaged record %lu of %lu bytes", offset, vault->end);
+        if (storage_file_seek(vault->file, offset, true)) {
+            storage_file_truncate(vault->file);
+        }
+        vault->end = offset;
+    }
+}
 
-    unsigned char encrypted_password[PASSGEN_MAX_LENGTH];
-    xor_encrypt_decrypt((unsigned char*)password, encrypted_password, key, PASSGEN_MAX_LENGTH);
+// Append a record at the end of the vault and make it durable
+bool vault_append(Vault* vault, uint8_t type, const uint8_t* payload, uint32_t length, uint32_t* offset) {
+    VaultRecordHeader header = {
+        .sync = VAULT_RECORD_SYNC,
+        .type = type,
+        .length = length,
+        .checksum = vault_crc32(0, payload, length),
+    };
+    bool ok = storage_file_seek(vault->file, vault->end, true) &&
+              storage_file_write(vault->file, &header, sizeof(header)) == sizeof(header) &&
+              storage_file_write(vault->file, payload, length) == length && storage_file_sync(vault->file);
+    if (ok) {
+        *offset = vault->end;
+        vault->end += sizeof(header) + length;
+    }
+    return ok;
+}
 
-    if (storage_file_open(file, full_path, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
-        storage_file_write(file, key, AES_KEY_SIZE);
-        storage_file_write(file, encrypted_password, sizeof(encrypted_password));
-        storage_file_close(file);
+// Append an entry record of the given type, body is everything after the name. In bulk
+// mode the index is only appended to and the caller sorts it afterwards.
+bool vault_put_record(Vault* vault, uint8_t type, const char* name, const uint8_t* body, size_t body_length, bool bulk) {
+    uint8_t payload[VAULT_ENTRY_MAX];
+    size_t name_length = strlen(name);
+    uint32_t offset;
+    payload[0] = name_length;
+    memcpy(&payload[1], name, name_length);
+    memcpy(&payload[1 + name_length], body, body_length);
+    bool ok = vault_append(vault, type, payload, 1 + name_length + body_length, &offset);
+    secure_zero(payload, sizeof(payload));
+    if (!ok) {
+        return false;
     }
+    vault->journal_count++;
+    vault->legacy_count += type == VaultRecordEntry;
+    if (bulk) {
+        return vault_index_append(&vault->index, name, name_length, offset);
+    }
+    return vault_index_set(&vault->index, name, offset);
+}
 
-    storage_file_free(file);
-    furi_record_close(RECORD_STORAGE);
+// Write the sorted index as one record and point the header at it. The header is only
+// updated after the index is on the card, so an interrupted checkpoint loses nothing.
+bool vault_checkpoint(Vault* vault) {
+    uint32_t start = furi_get_tick();
+    const VaultIndex* index = &vault->index;
+    uint32_t count = index->count;
+    uint32_t length = sizeof(count);
+    uint32_t checksum = vault_crc32(0, (const uint8_t*)&count, sizeof(count));
+    for (uint32_t i = 0; i < count; i++) {
+        const char* name = vault_index_name(index, i);
+        uint8_t name_length = strlen(name);
+        checksum = vault_crc32(checksum, (const uint8_t*)&index->slots[i].offset, sizeof(uint32_t));
+        checksum = vault_crc32(checksum, &name_length, 1);
+        checksum = vault_crc32(checksum, (const uint8_t*)name, name_length);
+        length += sizeof(uint32_t) + 1 + name_length;
+    }
+    checksum = vault_crc32(checksum, (const uint8_t*)&vault->legacy_count, sizeof(vault->legacy_count));
+    length += sizeof(vault->legacy_count);
+
+    VaultRecordHeader header = {
+        .sync = VAULT_RECORD_SYNC,
+        .type = VaultRecordIndex,
+        .length = length,
+        .checksum = checksum,
+    };
+    uint8_t* buffer = malloc(VAULT_BUFFER_SIZE);
+    size_t used = 0;
+    bool ok = storage_file_seek(vault->file, vault->end, true) &&
+              storage_file_write(vault->file, &header, sizeof(header)) == sizeof(header);
+    memcpy(buffer, &count, sizeof(count));
+    used = sizeof(count);
+    for (uint32_t i = 0; i < count && ok; i++) {
+        const char* name = vault_index_name(index, i);
+        uint8_t name_length = strlen(name);
+        if (used + sizeof(uint32_t) + 1 + name_length > VAULT_BUFFER_SIZE) {
+            ok = storage_file_write(vault->file, buffer, used) == used;
+            used = 0;
+        }
+        memcpy(&buffer[used], &index->slots[i].offset, sizeof(uint32_t));
+        buffer[used + sizeof(uint32_t)] = name_length;
+        memcpy(&buffer[used + sizeof(uint32_t) + 1], name, name_length);
+        used += sizeof(uint32_t) + 1 + name_length;
+    }
+    if (ok && used + sizeof(vault->legacy_count) > VAULT_BUFFER_SIZE) {
+        ok = storage_file_write(vault->file, buffer, used) == used;
+        used = 0;
+    }
+    memcpy(&buffer[used], &vault->legacy_count, sizeof(vault->legacy_count));
+    used += sizeof(vault->legacy_count);
+    ok = ok && storage_file_write(vault->file, buffer, used) == used && storage_file_sync(vault->file);
+    free(buffer);
+
+    VaultHeader vault_header = {.magic = VAULT_MAGIC, .index_offset = vault->end};
+    ok = ok && storage_file_seek(vault->file, 0, true) &&
+         storage_file_write(vault->file, &vault_header, sizeof(vault_header)) == sizeof(vault_header) &&
+         storage_file_sync(vault->file);
+    if (ok) {
+        vault->end += sizeof(header) + length;
+        vault->journal_count = 0;
+    }
+    FURI_LOG_I("PassGen", "Vault index of %lu entries (%lu bytes) written in %lu ms", count, length, furi_get_tick() - start);
+    return ok;
 }
 
-// Load decrypted password from file
-bool load_password_from_file(const char* filename, char* password, size_t max_length) {
-    Storage* storage = furi_record_open(RECORD_STORAGE);
-    File* file = storage_file_alloc(storage);
-    bool success = false;
-
-    const char* dir = "/ext/apps_assets/pwgen";
-    char full_path[MAX_FILENAME_LENGTH + strlen(dir) + 2];
-    snprintf(full_path, sizeof(full_path), "%s/%s", dir, filename);
-
-    if (storage_file_open(file, full_path, FSAM_READ, FSOM_OPEN_EXISTING)) {
-        unsigned char key[AES_KEY_SIZE];
-        ssize_t read_bytes = storage_file_read(file, key, AES_KEY_SIZE);
-        if (read_bytes == AES_KEY_SIZE) {
-            unsigned char encrypted_password[PASSGEN_MAX_LENGTH];
-            read_bytes = storage_file_read(file, encrypted_password, sizeof(encrypted_password));
-            if (read_bytes > 0) {
-                unsigned char decrypted_password[PASSGEN_MAX_LENGTH];
-                xor_encrypt_decrypt(encrypted_password, decrypted_password, key, PASSGEN_MAX_LENGTH);
-                decrypted_password[PASSGEN_MAX_LENGTH - 1] = '\0';
-                strncpy(password, (char*)decrypted_password, max_length - 1);
-                password[max_length - 1] = '\0';
-                success = true;
+// Names the old app gave password files: only characters of the filename charset and no
+// extension, so the vault, its key, the policies and the wordlist never match
+bool legacy_entry_name(const char* name) {
+    return name[0] != '\0' && name[strspn(name, charset)] == '\0';
+}
+
+// Move passwords saved as one file each into the vault. The old files are removed by
+// vault_migrate() once the entries are sealed under the PIN.
+void vault_import_legacy(Vault* vault) {
+    File* dir = storage_file_alloc(vault->storage);
+    File* file = storage_file_alloc(vault->storage);
+    int imported = 0;
+    if (storage_dir_open(dir, VAULT_DIRECTORY)) {
+        FileInfo file_info;
+        char file_name[MAX_FILENAME_LENGTH];
+        char full_path[MAX_FILENAME_LENGTH + sizeof(VAULT_DIRECTORY) + 1];
+        while (storage_dir_read(dir, &file_info, file_name, sizeof(file_name))) {
+            if (file_info.size != LEGACY_ENTRY_SIZE || !legacy_entry_name(file_name)) {
+                continue;
+            }
+            snprintf(full_path, sizeof(full_path), "%s/%s", VAULT_DIRECTORY, file_name);
+            unsigned char entry[LEGACY_ENTRY_SIZE];
+            if (storage_file_open(file, full_path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+                if (storage_file_read(file, entry, sizeof(entry)) == sizeof(entry) &&
+                    vault_put_record(vault, VaultRecordEntry, file_name, entry, sizeof(entry), true)) {
+                    imported++;
+                }
+                storage_file_close(file);
             }
         }
-        storage_file_close(file);
+        storage_dir_close(dir);
+    }
+    storage_file_free(file);
+    storage_file_free(dir);
+    if (imported > 0) {
+        vault_index_sort(&vault->index);
+        FURI_LOG_I("PassGen", "Imported %d password files into the vault", imported);
+        vault_checkpoint(vault);
     }
+}
 
+// Load the KDF parameters, false when no PIN has been set yet
+bool vault_key_load(Vault* vault) {
+    File* file = storage_file_alloc(vault->storage);
+    VaultKeyFile* key = &vault->key;
+    bool ok = storage_file_open(file, VAULT_KEY_PATH, FSAM_READ, FSOM_OPEN_EXISTING) &&
+              storage_file_read(file, key, sizeof(*key)) == sizeof(*key) &&
+              memcmp(key->magic, VAULT_KEY_MAGIC, sizeof(key->magic)) == 0 && key->r > 0 &&
+              key->log2_n >= KDF_LOG2_N_MIN && key->log2_n <= KDF_LOG2_N_MAX && key->passes > 0;
+    storage_file_close(file);
     storage_file_free(file);
-    furi_record_close(RECORD_STORAGE);
-    return success;
+    return ok;
+}
+
+// Open the vault and build the in-memory index: the last checkpointed index plus the
+// journal written after it, or the whole journal if the index is unusable
+bool vault_open(Vault* vault) {
+    uint32_t start = furi_get_tick();
+    memset(vault, 0, sizeof(Vault));
+    vault->storage = furi_record_open(RECORD_STORAGE);
+    vault->file = storage_file_alloc(vault->storage);
+    storage_simply_mkdir(vault->storage, VAULT_DIRECTORY);
+    vault->has_key = vault_key_load(vault);
+    // A compacted copy without the vault means the rename was interrupted, with it the copy
+    // was not finished
+    if (storage_common_exists(vault->storage, VAULT_COMPACT_PATH)) {
+        if (storage_common_exists(vault->storage, VAULT_PATH)) {
+            storage_common_remove(vault->storage, VAULT_COMPACT_PATH);
+        } else {
+            storage_common_rename(vault->storage, VAULT_COMPACT_PATH, VAULT_PATH);
+        }
+    }
+    if (!storage_file_open(vault->file, VAULT_PATH, FSAM_READ_WRITE, FSOM_OPEN_ALWAYS)) {
+        return false;
+    }
+    vault->end = storage_file_size(vault->file);
+
+    VaultHeader header;
+    if (vault->end == 0) {
+        memcpy(header.magic, VAULT_MAGIC, sizeof(header.magic));
+        header.index_offset = 0;
+        if (storage_file_write(vault->file, &header, sizeof(header)) != sizeof(header)) {
+            return false;
+        }
+        vault->end = sizeof(header);
+        vault->open = true;
+        vault_import_legacy(vault);
+        return true;
+    }
+    if (storage_file_read(vault->file, &header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, VAULT_MAGIC, sizeof(header.magic)) != 0) {
+        FURI_LOG_E("PassGen", "Not a vault file: %s", VAULT_PATH);
+        return false;
+    }
+    vault->open = true;
+
+    uint32_t replay_from = sizeof(header);
+    bool bulk = true;
+    if (header.index_offset != 0) {
+        VaultRecordHeader index_header;
+        if (vault_load_index(vault, header.index_offset) &&
+            vault_read_header(vault, header.index_offset, &index_header)) {
+            replay_from = header.index_offset + sizeof(index_header) + index_header.length;
+            bulk = false;
+        } else {
+            FURI_LOG_W("PassGen", "Vault index unusable, replaying the journal");
+            vault_index_reset(&vault->index);
+        }
+    }
+    vault_replay(vault, replay_from, bulk);
+    FURI_LOG_I(
+        "PassGen", "Vault opened: %lu entries, %d journaled, %lu bytes in %lu ms", vault->index.count, vault->journal_count, vault->end, furi_get_tick() - start);
+    return true;
+}
+
+// Checkpoint a long journal, then release the vault
+void vault_close(Vault* vault) {
+    if (vault->open && vault->journal_count >= VAULT_CHECKPOINT_ENTRIES) {
+        vault_checkpoint(vault);
+    }
+    if (vault->file) {
+        storage_file_close(vault->file);
+        storage_file_free(vault->file);
+        furi_record_close(RECORD_STORAGE);
+    }
+    vault_index_free(&vault->index);
+    secure_zero(&vault->keys, sizeof(vault->keys));
+    vault->unlocked = false;
+    vault->file = NULL;
+    vault->open = false;
+}
+
+// Seal a password with the session keys and save it under a name, replacing an older entry
+// of the same name
+bool vault_put(Vault* vault, const char* name, const char* password) {
+    size_t length = strlen(password) + 1;
+    if (!vault->open || !vault->unlocked || length > PASSGEN_MAX_LENGTH) {
+        return false;
+    }
+    uint8_t body[SEAL_NONCE_SIZE + SEAL_TAG_SIZE + PASSGEN_MAX_LENGTH];
+    uint8_t* sealed = &body[SEAL_NONCE_SIZE + SEAL_TAG_SIZE];
+    furi_hal_random_fill_buf(body, SEAL_NONCE_SIZE);
+    memcpy(sealed, password, length);
+    seal(&vault->keys, body, name, strlen(name), sealed, length, &body[SEAL_NONCE_SIZE]);
+    bool ok = vault_put_record(vault, VaultRecordSealed, name, body, SEAL_NONCE_SIZE + SEAL_TAG_SIZE + length, false);
+    secure_zero(body, sizeof(body));
+    return ok;
+}
+
+// Number of entries in the vault
+int vault_count(const Vault* vault) {
+    return vault->index.count;
+}
+
+// Load and decrypt the password of an index entry. Sealed entries need the vault unlocked and
+// fail if their tag does not match; entries in the old format still open until migrated.
+bool vault_get(Vault* vault, int index, char* password, size_t max_length) {
+    uint8_t payload[VAULT_ENTRY_MAX];
+    uint32_t length;
+    uint8_t type;
+    if (!vault->open || index < 0 || index >= vault_count(vault) ||
+        !vault_read_entry(vault, vault->index.slots[index].offset, payload, &length, &type)) {
+        return false;
+    }
+    const char* name = (const char*)&payload[1];
+    const uint8_t* body = &payload[1 + payload[0]];
+    size_t password_length = length - 1 - payload[0] - vault_entry_overhead(type);
+    unsigned char decrypted_password[PASSGEN_MAX_LENGTH];
+    bool ok = true;
+    if (type == VaultRecordSealed) {
+        memcpy(decrypted_password, body + SEAL_NONCE_SIZE + SEAL_TAG_SIZE, password_length);
+        ok = vault->unlocked &&
+             unseal(&vault->keys, body, body + SEAL_NONCE_SIZE, name, payload[0], decrypted_password, password_length);
+    } else {
+        xor_encrypt_decrypt(body + AES_KEY_SIZE, decrypted_password, body, password_length);
+    }
+    if (ok) {
+        decrypted_password[password_length - 1] = '\0';
+        strncpy(password, (char*)decrypted_password, max_length - 1);
+        password[max_length - 1] = '\0';
+    } else {
+        FURI_LOG_W("PassGen", "Entry %d does not match the session key", index);
+    }
+    secure_zero(decrypted_password, sizeof(decrypted_password));
+    secure_zero(payload, sizeof(payload));
+    return ok;
 }
 
-// Generate a random password ensuring at least one special character and one number
-// Generate a random password ensuring at least one special character and one number
-void generate_password(char* password, int length) {
-    size_t charsets_size = strlen(charsets);
+// Kernel tick in microseconds for the KDF calibration. Its last run lasts at least half the
+// target, so the 1 ms resolution is enough, and unlike the cycle counter it does not wrap.
+uint32_t kdf_clock_us(void) {
+    return furi_get_tick() * 1000;
+}
 
-    bool has_special = false;
-    bool has_digit = false;
+// Derive the session keys from the PIN with the stored parameters, false for a wrong PIN
+bool vault_unlock(Vault* vault, const char* pin) {
+    const VaultKeyFile* key = &vault->key;
+    size_t memory_size = kdf_memory_size(key->log2_n, key->r);
+    if (!vault->has_key) {
+        return false;
+    }
+    if (memmgr_heap_get_max_free_block() < memory_size) {
+        FURI_LOG_E("PassGen", "No free block of %u bytes for the KDF", memory_size);
+        return false;
+    }
+    uint32_t start = furi_get_tick();
+    uint32_t* memory = malloc(memory_size);
+    SessionKeys keys;
+    uint8_t verifier[SESSION_VERIFIER_SIZE];
+    session_derive(&keys, pin, key->salt, KDF_SALT_SIZE, key->log2_n, key->r, key->passes, memory);
+    free(memory);
+    session_verifier(&keys, verifier);
+    bool ok = crypto_equal(verifier, key->verifier, SESSION_VERIFIER_SIZE);
+    if (ok) {
+        vault->keys = keys;
+        vault->unlocked = true;
+    }
+    secure_zero(&keys, sizeof(keys));
+    FURI_LOG_I("PassGen", "KDF with %u bytes and %u passes took %lu ms", memory_size, key->passes, furi_get_tick() - start);
+    return ok;
+}
 
-    for(int i = 0; i < length; i++) {
-        password[i] = charsets[furi_hal_random_get() % charsets_size];
-        if (strchr("!$%&-", password[i])) {
-            has_special = true;
+// Set a new PIN: choose the KDF memory from the free heap (the largest size up to
+// KDF_LOG2_N_MAX that leaves half of the largest free block), calibrate the passes to
+// KDF_TARGET_MS on this device, derive the keys with a fresh salt and store the parameters
+bool vault_set_pin(Vault* vault, const char* pin) {
+    VaultKeyFile key = {.magic = VAULT_KEY_MAGIC, .log2_n = KDF_LOG2_N_MAX, .r = KDF_R};
+    size_t free_block = memmgr_heap_get_max_free_block();
+    while (key.log2_n > KDF_LOG2_N_MIN && kdf_memory_size(key.log2_n, key.r) > free_block / 2) {
+        key.log2_n--;
+    }
+    size_t memory_size = kdf_memory_size(key.log2_n, key.r);
+    if (memory_size > free_block / 2) {
+        FURI_LOG_E("PassGen", "No free block of %u bytes for the KDF", memory_size);
+        return false;
+    }
+    uint32_t* memory = malloc(memory_size);
+    uint32_t start = furi_get_tick();
+    key.passes = kdf_calibrate(key.log2_n, key.r, KDF_TARGET_MS * 1000, memory, kdf_clock_us);
+    FURI_LOG_I("PassGen", "KDF calibrated to %u passes of %u bytes in %lu ms", key.passes, memory_size, furi_get_tick() - start);
+    furi_hal_random_fill_buf(key.salt, KDF_SALT_SIZE);
+    SessionKeys keys;
+    session_derive(&keys, pin, key.salt, KDF_SALT_SIZE, key.log2_n, key.r, key.passes, memory);
+    free(memory);
+    session_verifier(&keys, key.verifier);
+
+    File* file = storage_file_alloc(vault->storage);
+    bool ok = storage_file_open(file, VAULT_KEY_PATH, FSAM_WRITE, FSOM_CREATE_ALWAYS) &&
+              storage_file_write(file, &key, sizeof(key)) == sizeof(key) && storage_file_sync(file);
+    storage_file_close(file);
+    storage_file_free(file);
+    if (ok) {
+        vault->key = key;
+        vault->has_key = true;
+        vault->keys = keys;
+        vault->unlocked = true;
+    }
+    secure_zero(&keys, sizeof(keys));
+    return ok;
+}
+
+// Whether any entry is sealed, i.e. the vault cannot be opened without its key file
+bool vault_has_sealed_entries(Vault* vault) {
+    for (uint32_t i = 0; i < vault->index.count; i++) {
+        VaultRecordHeader header;
+        if (vault_read_header(vault, vault->index.slots[i].offset, &header) && header.type == VaultRecordSealed) {
+            return true;
         }
-        if (isdigit((unsigned char)password[i])) {
-            has_digit = true;
+    }
+    return false;
+}
+
+// Rewrite the vault with only its current entries and an index, so replaced records are gone
+// from the card. The copy is renamed over the vault when complete; vault_open() finishes or
+// drops a copy left by an interruption.
+bool vault_compact(Vault* vault) {
+    uint32_t start = furi_get_tick();
+    VaultIndex* index = &vault->index;
+    File* old_file = vault->file;
+    uint32_t old_end = vault->end;
+    File* file = storage_file_alloc(vault->storage);
+    uint32_t* offsets = malloc((index->count + 1) * sizeof(uint32_t));
+    VaultHeader vault_header = {.magic = VAULT_MAGIC, .index_offset = 0};
+    uint32_t end = sizeof(vault_header);
+    bool ok = storage_file_open(file, VAULT_COMPACT_PATH, FSAM_READ_WRITE, FSOM_CREATE_ALWAYS) &&
+              storage_file_write(file, &vault_header, sizeof(vault_header)) == sizeof(vault_header);
+    for (uint32_t i = 0; i < index->count && ok; i++) {
+        uint8_t payload[VAULT_ENTRY_MAX];
+        uint32_t length;
+        uint8_t type;
+        ok = vault_read_entry(vault, index->slots[i].offset, payload, &length, &type);
+        if (ok) {
+            VaultRecordHeader header = {
+                .sync = VAULT_RECORD_SYNC,
+                .type = type,
+                .length = length,
+                .checksum = vault_crc32(0, payload, length),
+            };
+            ok = storage_file_write(file, &header, sizeof(header)) == sizeof(header) &&
+                 storage_file_write(file, payload, header.length) == header.length;
+            offsets[i] = end;
+            end += sizeof(header) + header.length;
         }
+        secure_zero(payload, sizeof(payload));
     }
 
-    // Ensure at least one special character and one number
-    if (!has_special) {
-        char special_chars[] = "!$%&-";
-        password[furi_hal_random_get() % length] = special_chars[furi_hal_random_get() % strlen(special_chars)];
+    // Point the index at the copy and let the checkpoint write its index and header. The old
+    // offsets are kept in case that fails.
+    if (ok) {
+        for (uint32_t i = 0; i < index->count; i++) {
+            uint32_t offset = index->slots[i].offset;
+            index->slots[i].offset = offsets[i];
+            offsets[i] = offset;
+        }
+        vault->file = file;
+        vault->end = end;
+        ok = vault_checkpoint(vault);
+        vault->file = old_file;
+        if (!ok) {
+            for (uint32_t i = 0; i < index->count; i++) {
+                index->slots[i].offset = offsets[i];
+            }
+            vault->end = old_end;
+        }
     }
-    if (!has_digit) {
-        char digits[] = "0123456789";
-        password[furi_hal_random_get() % length] = digits[furi_hal_random_get() % strlen(digits)];
+    storage_file_close(file);
+    storage_file_free(file);
+    free(offsets);
+    if (!ok) {
+        storage_common_remove(vault->storage, VAULT_COMPACT_PATH);
+        FURI_LOG_E("PassGen", "Vault compaction failed");
+        return false;
     }
+    storage_file_close(old_file);
+    vault->open = storage_common_remove(vault->storage, VAULT_PATH) == FSE_OK &&
+                  storage_common_rename(vault->storage, VAULT_COMPACT_PATH, VAULT_PATH) == FSE_OK &&
+                  storage_file_open(old_file, VAULT_PATH, FSAM_READ_WRITE, FSOM_OPEN_EXISTING);
+    FURI_LOG_I("PassGen", "Vault compacted from %lu to %lu bytes in %lu ms", old_end, vault->end, furi_get_tick() - start);
+    return vault->open;
+}
 
-    password[length] = '\0';
+// Entry being sealed by vault_migrate(), on the heap as sealing needs the stack
+typedef struct {
+    char name[MAX_FILENAME_LENGTH + 1];
+    char password[PASSGEN_MAX_LENGTH];
+} MigrateEntry;
+
+// Seal every entry still in the old format under the session key, then compact the vault and
+// delete the imported password files so the old plaintext keys are gone from the card. Returns
+// at once when the index holds no entries of the old format.
+int vault_migrate(Vault* vault) {
+    if (vault->legacy_count == 0) {
+        return 0;
+    }
+    int migrated = 0;
+    uint32_t failed = 0;
+    MigrateEntry* entry = malloc(sizeof(MigrateEntry));
+    for (int i = 0; i < vault_count(vault); i++) {
+        VaultRecordHeader header;
+        if (!vault_read_header(vault, vault->index.slots[i].offset, &header) || header.type != VaultRecordEntry) {
+            continue;
+        }
+        strncpy(entry->name, vault_index_name(&vault->index, i), MAX_FILENAME_LENGTH);
+        entry->name[MAX_FILENAME_LENGTH] = '\0';
+        if (vault_get(vault, i, entry->password, sizeof(entry->password)) && vault_put(vault, entry->name, entry->password)) {
+            migrated++;
+        } else {
+            failed++;
+        }
+        secure_zero(entry->password, sizeof(entry->password));
+    }
+    free(entry);
+    // The compacted index records what is left, so the next unlock skips the search
+    uint32_t legacy_count = vault->legacy_count;
+    vault->legacy_count = failed;
+    if (migrated == 0) {
+        if (failed != legacy_count) {
+            vault_checkpoint(vault);
+        }
+        return 0;
+    }
+    if (!vault_compact(vault)) {
+        vault->legacy_count = legacy_count;
+        return migrated;
+    }
+    for (int i = 0; i < vault_count(vault); i++) {
+        char path[MAX_FILENAME_LENGTH + sizeof(VAULT_DIRECTORY) + 1];
+        FileInfo file_info;
+        snprintf(path, sizeof(path), "%s/%s", VAULT_DIRECTORY, vault_index_name(&vault->index, i));
+        if (legacy_entry_name(vault_index_name(&vault->index, i)) &&
+            storage_common_stat(vault->storage, path, &file_info) == FSE_OK && file_info.size == LEGACY_ENTRY_SIZE) {
+            storage_common_remove(vault->storage, path);
+        }
+    }
+    FURI_LOG_I("PassGen", "Sealed %d entries of the old format", migrated);
+    return migrated;
 }
 
-// Display the password on the screen (placeholder function)
-void display_password(const char* password) {
-    printf("Password: %s\n", password);
+// Wipe every cached entry and forget pending prefetches
+void entry_cache_clear(EntryCache* cache) {
+    secure_zero(cache->entries, sizeof(cache->entries));
+    cache->prefetch_count = 0;
 }
 
-// Sort the file list using bubble sort
-void bubble_sort(char** list, int count) {
-    for (int i = 0; i < count - 1; i++) {
-        for (int j = 0; j < count - i - 1; j++) {
-            if (strcmp(list[j], list[j + 1]) > 0) {
-                char* temp = list[j];
-                list[j] = list[j + 1];
-                list[j + 1] = temp;
-            }
+// Find a vault entry in the cache, or wipe and return the least recently used slot for it
+CachedEntry* entry_cache_slot(EntryCache* cache, uint32_t offset, bool* hit) {
+    CachedEntry* oldest = &cache->entries[0];
+    for (int i = 0; i < ENTRY_CACHE_SIZE; i++) {
+        CachedEntry* entry = &cache->entries[i];
+        if (entry->valid && entry->offset == offset) {
+            *hit = true;
+            return entry;
         }
+        if (!entry->valid || (oldest->valid && entry->last_used < oldest->last_used)) {
+            oldest = entry;
+        }
+    }
+    secure_zero(oldest, sizeof(CachedEntry));
+    *hit = false;
+    return oldest;
+}
+
+// Load a decrypted entry through the cache, or only read it ahead when password is NULL.
+// Entries are keyed by record offset, so an entry saved again under the same name is a
+// new record and the old one just ages out.
+bool entry_cache_get(EntryCache* cache, Vault* vault, int index, char* password, size_t max_length) {
+    if (index < 0 || index >= vault_count(vault)) {
+        return false;
+    }
+    bool hit;
+    uint32_t offset = vault->index.slots[index].offset;
+    CachedEntry* entry = entry_cache_slot(cache, offset, &hit);
+    if (!hit) {
+        uint32_t start = furi_get_tick();
+        if (!vault_get(vault, index, entry->password, sizeof(entry->password))) {
+            return false;
+        }
+        entry->offset = offset;
+        entry->valid = true;
+        if (password) {
+            cache->misses++;
+        } else {
+            cache->prefetched++;
+        }
+        FURI_LOG_D("PassGen", "Entry %d read from the card in %lu ms", index, furi_get_tick() - start);
+    } else if (password) {
+        cache->hits++;
+    }
+    entry->last_used = ++cache->clock;
+    if (password) {
+        strncpy(password, entry->password, max_length - 1);
+        password[max_length - 1] = '\0';
+    }
+    return true;
+}
+
+// Queue entries to read ahead, replacing what was queued before
+void entry_cache_schedule(EntryCache* cache, const int* indices, int count) {
+    cache->prefetch_count = 0;
+    for (int i = 0; i < count && i < ENTRY_PREFETCH_MAX; i++) {
+        cache->prefetch[cache->prefetch_count++] = indices[i];
     }
 }
 
-// Load and sort the file list
-void load_file_list(App* app) {
+// Read one queued entry ahead, returns whether more are queued
+bool entry_cache_prefetch(EntryCache* cache, Vault* vault) {
+    if (cache->prefetch_count > 0) {
+        entry_cache_get(cache, vault, cache->prefetch[--cache->prefetch_count], NULL, 0);
+    }
+    return cache->prefetch_count > 0;
+}
+
+// Compile a policy and make it the active one
+bool policy_select(App* app, int index) {
+    if (!policy_compile(&app->policies[index], &app->policy_table)) {
+        FURI_LOG_W("PassGen", "Policy %s cannot be used", app->policies[index].name);
+        return false;
+    }
+    app->policy_selected = index;
+    return true;
+}
+
+// Write all policies back to the card
+void policy_store_save(App* app) {
+    char* text = malloc(POLICY_FILE_MAX + 1);
+    size_t length = policy_file_format(app->policies, app->policy_count, app->policy_selected, text, POLICY_FILE_MAX + 1);
     Storage* storage = furi_record_open(RECORD_STORAGE);
     File* file = storage_file_alloc(storage);
-    app->file_count = 0;
+    if (length > 0 && storage_file_open(file, POLICY_PATH, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        storage_file_write(file, text, length);
+        storage_file_close(file);
+    }
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+    free(text);
+}
+
+// Load the stored policies, writing the defaults when there are none
+void policy_store_load(App* app) {
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    char* text = malloc(POLICY_FILE_MAX + 1);
+    int selected = 0;
+    app->policy_count = 0;
+    if (storage_file_open(file, POLICY_PATH, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        size_t length = storage_file_read(file, text, POLICY_FILE_MAX);
+        text[length] = '\0';
+        app->policy_count = policy_file_parse(text, app->policies, POLICY_MAX, &selected);
+        storage_file_close(file);
+    }
+    free(text);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
 
-    const char* dir = "/ext/apps_assets/pwgen";
+    if (app->policy_count == 0) {
+        app->policy_count = sizeof(default_policies) / sizeof(default_policies[0]);
+        memcpy(app->policies, default_policies, sizeof(default_policies));
+        policy_store_save(app);
+    }
+    if (!policy_select(app, selected) && !policy_select(app, 0)) {
+        app->policy_table.size = 0;
+    }
+    app->policy_cursor = app->policy_selected;
+}
 
-    if(storage_dir_open(file, dir)) {
-        FileInfo file_info;
-        char file_name[MAX_FILENAME_LENGTH];
+// Generate a password following the active policy, false if the policy is too strict
+bool generate_password(App* app) {
+    app->message = "Policy too strict";
+    if (app->policy_table.size < 2) {
+        return false;
+    }
+    uint32_t words_used = app->entropy.words_used;
+    uint32_t attempts = policy_generate(&app->policy_table, &app->entropy, app->password);
+    FURI_LOG_D("PassGen", "Password drawn in %lu attempts from %lu words", attempts, app->entropy.words_used - words_used);
+    return attempts > 0;
+}
 
-        while(storage_dir_read(file, &file_info, file_name, sizeof(file_name))) {
-            if(file_info.size > 0) {
-                app->file_list = realloc(app->file_list, (app->file_count + 1) * sizeof(char*));
-                app->file_list[app->file_count] = strdup(file_name);
-                app->file_count++;
-            }
+// Append one word to the index being built
+void wordlist_write_record(const char* word, uint8_t length, void* context) {
+    WordlistWriter* writer = context;
+    if (writer->used + WORDLIST_RECORD_SIZE > sizeof(writer->buffer)) {
+        writer->ok = writer->ok && storage_file_write(writer->file, writer->buffer, writer->used) == writer->used;
+        writer->used = 0;
+    }
+    memset(&writer->buffer[writer->used], 0, WORDLIST_RECORD_SIZE);
+    memcpy(&writer->buffer[writer->used], word, length);
+    writer->used += WORDLIST_RECORD_SIZE;
+}
+
+// Build the word index in one pass over the wordlist, chunk by chunk. The header gets its
+// magic only after all records are written, so an interrupted build is rebuilt next time.
+bool wordlist_build(Wordlist* wordlist, uint32_t source_size, uint32_t source_timestamp) {
+    uint32_t start = furi_get_tick();
+    File* source = storage_file_alloc(wordlist->storage);
+    WordlistWriter* writer = malloc(sizeof(WordlistWriter));
+    uint8_t* chunk = malloc(WORDLIST_CHUNK_SIZE);
+    WordlistHeader header = {.count = 0, .source_size = source_size, .source_timestamp = source_timestamp};
+    writer->file = wordlist->index;
+    writer->used = 0;
+    writer->ok = true;
+    bool ok = storage_file_open(source, WORDLIST_PATH, FSAM_READ, FSOM_OPEN_EXISTING) &&
+              storage_file_open(wordlist->index, WORDLIST_INDEX_PATH, FSAM_READ_WRITE, FSOM_CREATE_ALWAYS) &&
+              storage_file_write(wordlist->index, &header, sizeof(header)) == sizeof(header);
+    if (ok) {
+        WordlistParser parser;
+        wordlist_parser_init(&parser, wordlist_write_record, writer);
+        size_t length;
+        while ((length = storage_file_read(source, chunk, WORDLIST_CHUNK_SIZE)) > 0) {
+            wordlist_parser_feed(&parser, chunk, length);
         }
+        wordlist_parser_finish(&parser);
+
+        memcpy(header.magic, WORDLIST_MAGIC, sizeof(header.magic));
+        header.count = parser.words;
+        ok = writer->ok && parser.words >= 2 &&
+             storage_file_write(wordlist->index, writer->buffer, writer->used) == writer->used &&
+             storage_file_seek(wordlist->index, 0, true) &&
+             storage_file_write(wordlist->index, &header, sizeof(header)) == sizeof(header) &&
+             storage_file_sync(wordlist->index);
+        FURI_LOG_I(
+            "PassGen", "Word index of %lu words built in %lu ms, %lu words too long", parser.words, furi_get_tick() - start, parser.skipped);
+    }
+    if (ok) {
+        wordlist->count = header.count;
+    }
+    storage_file_close(source);
+    storage_file_free(source);
+    free(chunk);
+    free(writer);
+    return ok;
+}
 
-        if (app->file_count > 1) {
-            bubble_sort(app->file_list, app->file_count);
+// Open the word index, building it first if the wordlist is new or has changed
+bool wordlist_open(Wordlist* wordlist) {
+    if (wordlist->open) {
+        return true;
+    }
+    FileInfo info;
+    uint32_t timestamp = 0;
+    if (storage_common_stat(wordlist->storage, WORDLIST_PATH, &info) != FSE_OK) {
+        FURI_LOG_W("PassGen", "No wordlist at %s", WORDLIST_PATH);
+        return false;
+    }
+    storage_common_timestamp(wordlist->storage, WORDLIST_PATH, &timestamp);
+
+    WordlistHeader header;
+    wordlist->open = storage_file_open(wordlist->index, WORDLIST_INDEX_PATH, FSAM_READ, FSOM_OPEN_EXISTING) &&
+                     storage_file_read(wordlist->index, &header, sizeof(header)) == sizeof(header) &&
+                     wordlist_header_current(&header, info.size, timestamp, storage_file_size(wordlist->index));
+    if (wordlist->open) {
+        wordlist->count = header.count;
+    } else {
+        storage_file_close(wordlist->index);
+        wordlist->open = wordlist_build(wordlist, info.size, timestamp);
+        if (!wordlist->open) {
+            storage_file_close(wordlist->index);
         }
+    }
+    return wordlist->open;
+}
 
-        storage_dir_close(file);
+// Read word number index: one seek to its record and one read of WORDLIST_RECORD_SIZE bytes
+bool wordlist_word(Wordlist* wordlist, uint32_t index, char* word) {
+    if (!storage_file_seek(wordlist->index, wordlist_record_offset(index), true) ||
+        storage_file_read(wordlist->index, word, WORDLIST_RECORD_SIZE) != WORDLIST_RECORD_SIZE) {
+        return false;
     }
+    word[WORDLIST_RECORD_SIZE - 1] = '\0';
+    return word[0] != '\0';
+}
 
-    storage_file_free(file);
-    furi_record_close(RECORD_STORAGE);
+void wordlist_close(Wordlist* wordlist) {
+    if (wordlist->open) {
+        storage_file_close(wordlist->index);
+        wordlist->open = false;
+    }
+}
+
+// Generate a Diceware passphrase of PASSPHRASE_WORDS words drawn uniformly from the wordlist
+bool generate_passphrase(App* app) {
+    app->message = "No wordlist found";
+    if (!wordlist_open(&app->wordlist)) {
+        return false;
+    }
+    uint32_t start = DWT->CYCCNT;
+    EntropySampler sampler;
+    entropy_sampler_init(&sampler, app->wordlist.count);
+    char word[WORDLIST_RECORD_SIZE];
+    size_t used = 0;
+    bool ok = true;
+    for (int i = 0; i < PASSPHRASE_WORDS && ok; i++) {
+        ok = wordlist_word(&app->wordlist, entropy_sample(&sampler, &app->entropy), word);
+        if (ok) {
+            if (i > 0) {
+                app->password[used++] = PASSPHRASE_SEPARATOR;
+            }
+            size_t length = strlen(word);
+            memcpy(&app->password[used], word, length);
+            used += length;
+        }
+    }
+    app->password[used] = '\0';
+    secure_zero(word, sizeof(word));
+    secure_zero(&sampler, sizeof(sampler));
+    if (!ok) {
+        app->message = "Wordlist read failed";
+        secure_zero(app->password, sizeof(app->password));
+        return false;
+    }
+    FURI_LOG_I(
+        "PassGen",
+        "Passphrase of %d words from %lu in %lu us",
+        PASSPHRASE_WORDS,
+        app->wordlist.count,
+        (DWT->CYCCNT - start) / furi_hal_cortex_instructions_per_microsecond());
+    return true;
+}
+
+// Run the KDF for the entered PIN: check it, or set it once both entries match. Called without
+// the mutex so the screen keeps showing the progress message meanwhile; keys pressed during
+// the run are dropped.
+void unlock_session(App* app) {
+    bool confirm = app->unlock_stage == UnlockConfirm;
+    bool same = !confirm || strcmp(app->pin, app->pin_first) == 0;
+    bool ok = same && (confirm ? vault_set_pin(&app->vault, app->pin) : vault_unlock(&app->vault, app->pin));
+    if (ok) {
+        vault_migrate(&app->vault);
+    }
+    furi_mutex_acquire(app->mutex, FuriWaitForever);
+    secure_zero(app->pin, sizeof(app->pin));
+    secure_zero(app->pin_first, sizeof(app->pin_first));
+    app->unlock_pending = false;
+    if (ok) {
+        app->state = StateMenu;
+        app->message = "";
+    } else if (confirm) {
+        app->unlock_stage = UnlockChoose;
+        app->message = same ? "PIN not saved" : "PINs differ";
+    } else {
+        app->message = "Wrong PIN";
+    }
+    furi_mutex_release(app->mutex);
+    furi_message_queue_reset(app->input_queue);
+}
+
+// Show the selected entry and queue its neighbours for reading ahead
+void show_entry(App* app) {
+    int count = vault_count(&app->vault);
+    if (entry_cache_get(&app->cache, &app->vault, app->selected_file, app->password, sizeof(app->password))) {
+        app->state = StateDisplayPassword;
+        int neighbours[ENTRY_PREFETCH_MAX] = {
+            (app->selected_file + count - 1) % count,
+            (app->selected_file + 1) % count,
+        };
+        entry_cache_schedule(&app->cache, neighbours, ENTRY_PREFETCH_MAX);
+    } else {
+        secure_zero(app->password, sizeof(app->password));
+    }
+}
+
+// Display the password on the screen (placeholder function)
+void display_password(const char* password) {
+    printf("Password: %s\n", password);
 }
 
 // Add a character to the filename
@@ -242,17 +1260,70 @@ void scroll_character(App* app, bool up) {
     app->filename[index] = charset[current_index];
 }
 
+// Draw a password over as many lines as needed, breaking passphrases after a separator
+void draw_password(Canvas* canvas, int y, const char* password) {
+    char line[PASSWORD_LINE_CHARS + 1];
+    size_t remaining = strlen(password);
+    while (remaining > 0) {
+        size_t length = remaining < PASSWORD_LINE_CHARS ? remaining : PASSWORD_LINE_CHARS;
+        if (length < remaining) {
+            for (size_t i = length; i-- > 1;) {
+                if (password[i] == PASSPHRASE_SEPARATOR) {
+                    length = i + 1;
+                    break;
+                }
+            }
+        }
+        memcpy(line, password, length);
+        line[length] = '\0';
+        canvas_draw_str(canvas, 2, y, line);
+        password += length;
+        remaining -= length;
+        y += 10;
+    }
+    secure_zero(line, sizeof(line));
+}
+
 // Render the screen based on the current state
 void render_callback(Canvas* canvas, void* ctx) {
     App* app = ctx;
+    furi_mutex_acquire(app->mutex, FuriWaitForever);
     canvas_clear(canvas);
 
     switch(app->state) {
+    case StateUnlock: {
+        static const char* const titles[] = {
+            [UnlockEnter] = "Enter PIN:",
+            [UnlockChoose] = "New PIN (" PIN_NUMBER_TEXT(PIN_LENGTH_MIN) "+):",
+            [UnlockConfirm] = "Repeat the PIN:",
+            [UnlockBlocked] = "Key file missing",
+        };
+        char masked[PIN_LENGTH_MAX + 1];
+        size_t length = strlen(app->pin);
+        memset(masked, '*', length);
+        masked[length] = '\0';
+        canvas_draw_str(canvas, 2, 10, titles[app->unlock_stage]);
+        canvas_draw_str(canvas, 2, 25, app->unlock_stage == UnlockBlocked ? "Restore vault.key" : masked);
+        if (app->unlock_stage == UnlockChoose && app->message[0] == '\0') {
+            // The limit of what the PIN protects against
+            canvas_draw_str(canvas, 2, 38, "A copy of the SD card");
+            canvas_draw_str(canvas, 2, 48, "allows offline guessing");
+        } else {
+            canvas_draw_str(canvas, 2, 40, app->message);
+        }
+        if (app->unlock_stage != UnlockBlocked) {
+            canvas_draw_str(canvas, 2, 60, "Short/long arrows, OK");
+        }
+        break;
+    }
+
     case StateMenu:
         canvas_draw_str(canvas, 2, 10, "Menu:");
-        canvas_draw_str(canvas, 10, 25, app->menu_option == 0 ? "> New Password" : "  New Password");
-        canvas_draw_str(canvas, 10, 40, app->menu_option == 1 ? "> Show Password" : "  Show Password");
-        canvas_draw_str(canvas, 10, 55, app->menu_option == 2 ? "> Exit" : "  Exit");
+        canvas_draw_str(canvas, 10, 20, app->menu_option == 0 ? "> New Password" : "  New Password");
+        canvas_draw_str(canvas, 10, 30, app->menu_option == 1 ? "> New Passphrase" : "  New Passphrase");
+        canvas_draw_str(canvas, 10, 40, app->menu_option == 2 ? "> Show Password" : "  Show Password");
+        canvas_draw_str(canvas, 10, 50, app->menu_option == 3 ? "> Policy" : "  Policy");
+        canvas_draw_str(canvas, 10, 60, app->menu_option == 4 ? "> Exit" : "  Exit");
         break;
 
     case StateEnterFilename:
@@ -261,59 +1332,85 @@ void render_callback(Canvas* canvas, void* ctx) {
         break;
 
     case StateGeneratePassword:
-        canvas_draw_str(canvas, 2, 10, "Generated Password:");
-        canvas_draw_str(canvas, 2, 25, app->password);
+        if (app->password[0] == '\0') {
+            canvas_draw_str(canvas, 2, 10, app->message);
+            canvas_draw_str(canvas, 2, 25, app->passphrase ? WORDLIST_PATH : app->policies[app->policy_selected].name);
+        } else {
+            canvas_draw_str(canvas, 2, 10, app->passphrase ? "Generated Passphrase:" : "Generated Password:");
+            draw_password(canvas, 22, app->password);
+        }
         break;
 
     case StateSelectFile:
-        if (app->file_count > 0) {
+        if (vault_count(&app->vault) > 0) {
             int y_position = 25;
             int max_visible_files = 3;
 
-            for (int i = 0; i < max_visible_files && i + app->selected_file < app->file_count; i++) {
+            for (int i = 0; i < max_visible_files && i + app->selected_file < vault_count(&app->vault); i++) {
                 int file_index = i + app->selected_file;
                 bool is_selected = file_index == app->selected_file;
                 canvas_draw_str(canvas, 10, y_position + (i * 15), is_selected ? "> " : "  ");
-                canvas_draw_str(canvas, 20, y_position + (i * 15), app->file_list[file_index]);
+                canvas_draw_str(canvas, 20, y_position + (i * 15), vault_index_name(&app->vault.index, file_index));
             }
 
             if (app->selected_file > 0) {
                 canvas_draw_str(canvas, 10, y_position + (max_visible_files * 15), "< Back");
             }
-            if (app->selected_file < app->file_count - 1) {
+            if (app->selected_file < vault_count(&app->vault) - 1) {
                 canvas_draw_str(canvas, 10, y_position + ((max_visible_files + 1) * 15), "Next >");
             }
         } else {
-            canvas_draw_str(canvas, 2, 10, "No files found");
+            canvas_draw_str(canvas, 2, 10, app->vault.open ? "No files found" : "Vault unavailable");
         }
         break;
 
     case StateDisplayPassword:
-        if (app->file_count > 0) {
-            canvas_draw_str(canvas, 2, 25, app->file_list[app->selected_file]);
-
-            char page_info[16];
-            snprintf(page_info, sizeof(page_info), "%d/%d", app->selected_file + 1, app->file_count);
+        if (vault_count(&app->vault) > 0) {
+            char page_info[16 + MAX_FILENAME_LENGTH];
+            snprintf(
+                page_info,
+                sizeof(page_info),
+                "%d/%d %s",
+                app->selected_file + 1,
+                vault_count(&app->vault),
+                vault_index_name(&app->vault.index, app->selected_file));
             canvas_draw_str(canvas, 2, 10, page_info);
 
-            canvas_draw_str(canvas, 2, 40, app->password);  
+            draw_password(canvas, 22, app->password);
         } else {
             canvas_draw_str(canvas, 2, 10, "No files loaded");
         }
         break;
 
+    case StateSelectPolicy: {
+        char description[32];
+        policy_describe(&app->policies[app->policy_cursor], description, sizeof(description));
+        canvas_draw_str(canvas, 2, 10, description);
+        int top = app->policy_cursor < POLICY_VISIBLE_ROWS ? 0 : app->policy_cursor - POLICY_VISIBLE_ROWS + 1;
+        for (int i = top; i < app->policy_count && i < top + POLICY_VISIBLE_ROWS; i++) {
+            int y = 22 + (i - top) * 12;
+            if (i == app->policy_selected) {
+                canvas_draw_str(canvas, 2, y, "*");
+            }
+            canvas_draw_str(canvas, 10, y, i == app->policy_cursor ? ">" : " ");
+            canvas_draw_str(canvas, 20, y, app->policies[i].name);
+        }
+        break;
+    }
+
     case StateExit:
         break;
 
     default:
         break;
     }
+    furi_mutex_release(app->mutex);
 }
 
 // Handle input events
 void input_callback(InputEvent* input_event, void* ctx) {
     App* app = ctx;
-    if(input_event->type == InputTypeShort) {
+    if(input_event->type == InputTypeShort || input_event->type == InputTypeLong) {
         furi_message_queue_put(app->input_queue, input_event, 0);
     }
 }
@@ -325,13 +1422,29 @@ App* app_init() {
     app->view_port = view_port_alloc();
     app->gui = furi_record_open(RECORD_GUI);
     app->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
-    app->state = StateMenu;
+    app->state = StateUnlock;
     app->menu_option = 0;
     memset(app->filename, 0, sizeof(app->filename));
     memset(app->password, 0, sizeof(app->password));
-    app->file_list = NULL;
-    app->file_count = 0;
     app->selected_file = 0;
+    memset(&app->cache, 0, sizeof(app->cache));
+    vault_open(&app->vault);
+    memset(app->pin, 0, sizeof(app->pin));
+    memset(app->pin_first, 0, sizeof(app->pin_first));
+    app->unlock_pending = false;
+    if (app->vault.has_key) {
+        app->unlock_stage = UnlockEnter;
+    } else {
+        // Without the key file sealed entries could never be opened again, so no new PIN
+        app->unlock_stage = vault_has_sealed_entries(&app->vault) ? UnlockBlocked : UnlockChoose;
+    }
+    entropy_pool_init(&app->entropy, furi_hal_random_fill_buf);
+    policy_store_load(app);
+    app->wordlist.storage = furi_record_open(RECORD_STORAGE);
+    app->wordlist.index = storage_file_alloc(app->wordlist.storage);
+    app->wordlist.open = false;
+    app->passphrase = false;
+    app->message = "";
     memset(app->char_set_index, 0, sizeof(app->char_set_index));
 
     app->filename[0] = charset[0];
@@ -345,12 +1458,15 @@ App* app_init() {
 
 // Free the app resources
 void app_free(App* app) {
-    if (app->file_list) {
-        for (int i = 0; i < app->file_count; i++) {
-            free(app->file_list[i]);
-        }
-        free(app->file_list);
-    }
+    FURI_LOG_I(
+        "PassGen", "Entry cache: %lu hits, %lu misses, %lu read ahead", app->cache.hits, app->cache.misses, app->cache.prefetched);
+    entry_cache_clear(&app->cache);
+    secure_zero(app->password, sizeof(app->password));
+    vault_close(&app->vault);
+    wordlist_close(&app->wordlist);
+    storage_file_free(app->wordlist.index);
+    furi_record_close(RECORD_STORAGE);
+    entropy_pool_clear(&app->entropy);
     gui_remove_view_port(app->gui, app->view_port);
     furi_record_close(RECORD_GUI);
     view_port_free(app->view_port);
@@ -370,23 +1486,74 @@ int32_t passwordgenerator_app(void) {
             break;
         }
 
-        if (furi_message_queue_get(app->input_queue, &input, FuriWaitForever) == FuriStatusOk) {
+        // While entries are queued for reading ahead, wait briefly and read them when no key comes
+        uint32_t timeout = app->cache.prefetch_count > 0 ? ENTRY_PREFETCH_IDLE_MS : FuriWaitForever;
+        if (furi_message_queue_get(app->input_queue, &input, timeout) != FuriStatusOk) {
+            furi_mutex_acquire(app->mutex, FuriWaitForever);
+            entry_cache_prefetch(&app->cache, &app->vault);
+            furi_mutex_release(app->mutex);
+        } else if (input.type == InputTypeLong && app->state != StateUnlock) {
+            // Long presses are only PIN symbols, every other screen works on short presses
+        } else {
+            furi_mutex_acquire(app->mutex, FuriWaitForever);
             switch (app->state) {
+            case StateUnlock: {
+                size_t length = strlen(app->pin);
+                if (input.key == InputKeyBack) {
+                    if (length > 0 && app->unlock_stage != UnlockBlocked) {
+                        app->pin[length - 1] = '\0';
+                    } else {
+                        app->state = StateExit;
+                    }
+                } else if (app->unlock_stage == UnlockBlocked || (input.type == InputTypeLong && input.key == InputKeyOk)) {
+                    break;
+                } else if (input.key == InputKeyOk) {
+                    if (length < PIN_LENGTH_MIN) {
+                        app->message = "At least " PIN_NUMBER_TEXT(PIN_LENGTH_MIN) " presses";
+                    } else if (app->unlock_stage == UnlockChoose) {
+                        memcpy(app->pin_first, app->pin, sizeof(app->pin));
+                        secure_zero(app->pin, sizeof(app->pin));
+                        app->unlock_stage = UnlockConfirm;
+                        app->message = "";
+                    } else {
+                        app->unlock_pending = true;
+                        app->message = app->unlock_stage == UnlockConfirm ? "Calibrating..." : "Unlocking...";
+                    }
+                } else if (length < PIN_LENGTH_MAX) {
+                    // Each direction is one PIN symbol, held longer it is another
+                    app->pin[length] = input.key == InputKeyUp   ? 'U' :
+                                       input.key == InputKeyDown ? 'D' :
+                                       input.key == InputKeyLeft ? 'L' :
+                                                                   'R';
+                    if (input.type == InputTypeLong) {
+                        app->pin[length] += 'a' - 'A';
+                    }
+                    app->message = "";
+                }
+                break;
+            }
+
             case StateMenu:
                 if (input.key == InputKeyUp) {
                     app->menu_option = (app->menu_option - 1 + MENU_OPTION_COUNT) % MENU_OPTION_COUNT;
                 } else if (input.key == InputKeyDown) {
                     app->menu_option = (app->menu_option + 1) % MENU_OPTION_COUNT;
                 } else if (input.key == InputKeyOk) {
-                    if (app->menu_option == 0) {
+                    if (app->menu_option == 0 || app->menu_option == 1) {
                         app->state = StateEnterFilename;
+                        app->passphrase = app->menu_option == 1;
                         memset(app->filename, 0, sizeof(app->filename));
                         app->filename[0] = charset[0];
                         app->char_set_index[0] = 0;
-                    } else if (app->menu_option == 1) {
-                        app->state = StateSelectFile;
-                        load_file_list(app);
                     } else if (app->menu_option == 2) {
+                        app->state = StateSelectFile;
+                        if (app->selected_file >= vault_count(&app->vault)) {
+                            app->selected_file = 0;
+                        }
+                    } else if (app->menu_option == 3) {
+                        app->state = StateSelectPolicy;
+                        app->policy_cursor = app->policy_selected;
+                    } else if (app->menu_option == 4) {
                         app->state = StateExit;
                     }
                 } else if (input.key == InputKeyBack) {
@@ -398,8 +1565,9 @@ int32_t passwordgenerator_app(void) {
                 if (input.key == InputKeyBack) {
                     app->state = StateMenu;
                 } else if (input.key == InputKeyOk) {
-                    generate_password(app->password, PASSGEN_MAX_LENGTH - 1);
-                    save_password_to_file(app->filename, app->password);
+                    if (app->passphrase ? generate_passphrase(app) : generate_password(app)) {
+                        vault_put(&app->vault, app->filename, app->password);
+                    }
                     app->state = StateGeneratePassword;
                 } else if (input.key == InputKeyRight) {
                     add_character_to_filename(app, charset[app->char_set_index[strlen(app->filename)]]);
@@ -421,16 +1589,16 @@ int32_t passwordgenerator_app(void) {
             case StateSelectFile:
                 if (input.key == InputKeyBack) {
                     app->state = StateMenu;
+                } else if (vault_count(&app->vault) == 0) {
+                    break;
                 } else if (input.key == InputKeyUp) {
-                    app->selected_file = (app->selected_file - 1 + app->file_count) % app->file_count;
+                    app->selected_file = (app->selected_file - 1 + vault_count(&app->vault)) % vault_count(&app->vault);
+                    entry_cache_schedule(&app->cache, &app->selected_file, 1);
                 } else if (input.key == InputKeyDown) {
-                    app->selected_file = (app->selected_file + 1) % app->file_count;
+                    app->selected_file = (app->selected_file + 1) % vault_count(&app->vault);
+                    entry_cache_schedule(&app->cache, &app->selected_file, 1);
                 } else if (input.key == InputKeyOk) {
-                    if (load_password_from_file(app->file_list[app->selected_file], app->password, sizeof(app->password))) {
-                        app->state = StateDisplayPassword;
-                    } else {
-                        memset(app->password, 0, sizeof(app->password));
-                    }
+                    show_entry(app);
                 }
                 break;
 
@@ -438,18 +1606,36 @@ int32_t passwordgenerator_app(void) {
                 if (input.key == InputKeyBack) {
                     app->state = StateSelectFile;
                 } else if (input.key == InputKeyLeft) {
-                    app->selected_file = (app->selected_file - 1 + app->file_count) % app->file_count;
-                    if (load_password_from_file(app->file_list[app->selected_file], app->password, sizeof(app->password))) {
-                        app->state = StateDisplayPassword;
-                    } else {
-                        memset(app->password, 0, sizeof(app->password));
-                    }
+                    app->selected_file = (app->selected_file - 1 + vault_count(&app->vault)) % vault_count(&app->vault);
+                    show_entry(app);
                 } else if (input.key == InputKeyRight) {
-                    app->selected_file = (app->selected_file + 1) % app->file_count;
-                    if (load_password_from_file(app->file_list[app->selected_file], app->password, sizeof(app->password))) {
-                        app->state = StateDisplayPassword;
-                    } else {
-                        memset(app->password, 0, sizeof(app->password));
+                    app->selected_file = (app->selected_file + 1) % vault_count(&app->vault);
+                    show_entry(app);
+                }
+                break;
+
+            case StateSelectPolicy:
+                if (input.key == InputKeyBack) {
+                    app->state = StateMenu;
+                } else if (input.key == InputKeyUp) {
+                    app->policy_cursor = (app->policy_cursor - 1 + app->policy_count) % app->policy_count;
+                } else if (input.key == InputKeyDown) {
+                    app->policy_cursor = (app->policy_cursor + 1) % app->policy_count;
+                } else if (input.key == InputKeyOk) {
+                    if (policy_select(app, app->policy_cursor)) {
+                        policy_store_save(app);
+                        app->state = StateMenu;
+                    }
+                } else if (input.key == InputKeyLeft || input.key == InputKeyRight) {
+                    // Left and right change the length of the highlighted policy
+                    PasswordPolicy changed = app->policies[app->policy_cursor];
+                    changed.length += input.key == InputKeyRight ? 1 : -1;
+                    if (policy_valid(&changed)) {
+                        app->policies[app->policy_cursor] = changed;
+                        if (app->policy_cursor == app->policy_selected) {
+                            policy_select(app, app->policy_selected);
+                        }
+                        policy_store_save(app);
                     }
                 }
                 break;
@@ -457,8 +1643,13 @@ int32_t passwordgenerator_app(void) {
             default:
                 break;
             }
+            furi_mutex_release(app->mutex);
 
             view_port_update(app->view_port);
+            if (app->unlock_pending) {
+                unlock_session(app);
+                view_port_update(app->view_port);
+            }
         }
     }
 
@@ -0,0 +1,506 @@
+#pragma once
+
+// Key derivation and entry sealing for the vault. The master PIN goes through scrypt (RFC 7914):
+// memory cost 128 * r * 2^log2_n bytes, time cost p passes that are run one after another, so the
+// time can be raised without needing more memory. The 64 derived bytes are the session keys: one
+// for an HMAC-SHA256 keystream in counter mode and one for an HMAC-SHA256 tag over nonce, name and
+// ciphertext. Independent of the firmware so tools/ can check it against the RFC test vectors.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SHA256_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+#define SEAL_NONCE_SIZE 16
+#define SEAL_TAG_SIZE 8
+#define SESSION_VERIFIER_SIZE 16
+#define KDF_PASSES_MAX 65535
+// Calibration measures at least this fraction of the target before scaling up
+#define KDF_CALIBRATION_SHARE 2
+
+// Microsecond clock for calibration, the kernel tick scaled to microseconds on the device
+typedef uint32_t (*KdfClock)(void);
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[SHA256_BLOCK_SIZE];
+    uint32_t used;
+} Sha256;
+
+typedef struct {
+    Sha256 inner;
+    Sha256 outer;
+} HmacSha256;
+
+// Hash states after the key block, so many messages under one key need only one Sha256 to work in
+typedef struct {
+    uint32_t inner[8];
+    uint32_t outer[8];
+} HmacSha256Key;
+
+typedef struct {
+    uint8_t encrypt[SHA256_SIZE];
+    uint8_t authenticate[SHA256_SIZE];
+} SessionKeys;
+
+static inline uint32_t crypto_rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t crypto_load_be32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline void crypto_store_be32(uint8_t* p, uint32_t x) {
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+static inline uint32_t crypto_load_le32(const uint8_t* p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void crypto_store_le32(uint8_t* p, uint32_t x) {
+    p[0] = x;
+    p[1] = x >> 8;
+    p[2] = x >> 16;
+    p[3] = x >> 24;
+}
+
+// Clear secrets in a way the compiler cannot drop as a dead store
+static inline void crypto_wipe(void* data, size_t length) {
+    volatile uint8_t* bytes = data;
+    while (length--) {
+        *bytes++ = 0;
+    }
+}
+
+static inline void sha256_compress(Sha256* sha, const uint8_t* block) {
+    static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+    uint32_t w[16];
+    uint32_t s[8];
+    memcpy(s, sha->state, sizeof(s));
+    for (int i = 0; i < 64; i++) {
+        if (i < 16) {
+            w[i] = crypto_load_be32(&block[i * 4]);
+        } else {
+            uint32_t w15 = w[(i - 15) & 15];
+            uint32_t w2 = w[(i - 2) & 15];
+            w[i & 15] += (crypto_rotr(w15, 7) ^ crypto_rotr(w15, 18) ^ (w15 >> 3)) + w[(i - 7) & 15] +
+                         (crypto_rotr(w2, 17) ^ crypto_rotr(w2, 19) ^ (w2 >> 10));
+        }
+        uint32_t t1 = s[7] + (crypto_rotr(s[4], 6) ^ crypto_rotr(s[4], 11) ^ crypto_rotr(s[4], 25)) +
+                      ((s[4] & s[5]) ^ (~s[4] & s[6])) + k[i] + w[i & 15];
+        uint32_t t2 = (crypto_rotr(s[0], 2) ^ crypto_rotr(s[0], 13) ^ crypto_rotr(s[0], 22)) +
+                      ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+        memmove(&s[1], &s[0], 7 * sizeof(uint32_t));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; i++) {
+        sha->state[i] += s[i];
+    }
+    crypto_wipe(w, sizeof(w));
+}
+
+static inline void sha256_init(Sha256* sha) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(sha->state, initial, sizeof(initial));
+    sha->length = 0;
+    sha->used = 0;
+}
+
+static inline void sha256_update(Sha256* sha, const void* data, size_t length) {
+    const uint8_t* bytes = data;
+    sha->length += length;
+    while (length > 0) {
+        size_t count = SHA256_BLOCK_SIZE - sha->used;
+        if (count > length) {
+            count = length;
+        }
+        memcpy(&sha->block[sha->used], bytes, count);
+        sha->used += count;
+        bytes += count;
+        length -= count;
+        if (sha->used == SHA256_BLOCK_SIZE) {
+            sha256_compress(sha, sha->block);
+            sha->used = 0;
+        }
+    }
+}
+
+static inline void sha256_final(Sha256* sha, uint8_t* digest) {
+    uint64_t bits = sha->length * 8;
+    uint8_t padding[SHA256_BLOCK_SIZE + 8] = {0x80};
+    size_t pad = (sha->used < 56 ? 56 : 120) - sha->used;
+    for (int i = 0; i < 8; i++) {
+        padding[pad + i] = bits >> (56 - 8 * i);
+    }
+    sha256_update(sha, padding, pad + 8);
+    for (int i = 0; i < 8; i++) {
+        crypto_store_be32(&digest[i * 4], sha->state[i]);
+    }
+    crypto_wipe(sha, sizeof(Sha256));
+}
+
+static inline void hmac_sha256_init(HmacSha256* hmac, const uint8_t* key, size_t length) {
+    uint8_t pad[SHA256_BLOCK_SIZE] = {0};
+    if (length > SHA256_BLOCK_SIZE) {
+        sha256_init(&hmac->inner);
+        sha256_update(&hmac->inner, key, length);
+        sha256_final(&hmac->inner, pad);
+    } else {
+        memcpy(pad, key, length);
+    }
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] ^= 0x36;
+    }
+    sha256_init(&hmac->inner);
+    sha256_update(&hmac->inner, pad, SHA256_BLOCK_SIZE);
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] ^= 0x36 ^ 0x5c;
+    }
+    sha256_init(&hmac->outer);
+    sha256_update(&hmac->outer, pad, SHA256_BLOCK_SIZE);
+    crypto_wipe(pad, sizeof(pad));
+}
+
+static inline void hmac_sha256_update(HmacSha256* hmac, const void* data, size_t length) {
+    sha256_update(&hmac->inner, data, length);
+}
+
+static inline void hmac_sha256_final(HmacSha256* hmac, uint8_t* mac) {
+    uint8_t inner[SHA256_SIZE];
+    sha256_final(&hmac->inner, inner);
+    sha256_update(&hmac->outer, inner, SHA256_SIZE);
+    sha256_final(&hmac->outer, mac);
+    crypto_wipe(inner, sizeof(inner));
+}
+
+// Continue a hash from a state saved right after its first block
+static inline void sha256_resume(Sha256* sha, const uint32_t* state) {
+    memcpy(sha->state, state, sizeof(sha->state));
+    sha->length = SHA256_BLOCK_SIZE;
+    sha->used = 0;
+}
+
+// Save the inner and outer states of an HMAC key, work is wiped afterwards
+static inline void hmac_sha256_key(HmacSha256Key* key, const uint8_t* secret, size_t length, Sha256* work) {
+    uint8_t pad[SHA256_BLOCK_SIZE] = {0};
+    if (length > SHA256_BLOCK_SIZE) {
+        sha256_init(work);
+        sha256_update(work, secret, length);
+        sha256_final(work, pad);
+    } else {
+        memcpy(pad, secret, length);
+    }
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] ^= 0x36;
+    }
+    sha256_init(work);
+    sha256_update(work, pad, SHA256_BLOCK_SIZE);
+    memcpy(key->inner, work->state, sizeof(key->inner));
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        pad[i] ^= 0x36 ^ 0x5c;
+    }
+    sha256_init(work);
+    sha256_update(work, pad, SHA256_BLOCK_SIZE);
+    memcpy(key->outer, work->state, sizeof(key->outer));
+    crypto_wipe(pad, sizeof(pad));
+    crypto_wipe(work, sizeof(Sha256));
+}
+
+// Append a 32-bit big-endian counter to the inner hash in work, then run the outer hash in the
+// same Sha256, so no second context is needed
+static inline void hmac_sha256_finish(const HmacSha256Key* key, Sha256* work, uint32_t counter, uint8_t* mac) {
+    uint8_t number[4];
+    crypto_store_be32(number, counter);
+    sha256_update(work, number, sizeof(number));
+    sha256_final(work, mac);
+    sha256_resume(work, key->outer);
+    sha256_update(work, mac, SHA256_SIZE);
+    sha256_final(work, mac);
+}
+
+// MAC of a message and a 32-bit big-endian counter under a saved key
+static inline void hmac_sha256_counter(
+    const HmacSha256Key* key, Sha256* work, const void* data, size_t length, uint32_t counter, uint8_t* mac) {
+    sha256_resume(work, key->inner);
+    sha256_update(work, data, length);
+    hmac_sha256_finish(key, work, counter, mac);
+}
+
+static inline void salsa20_8(uint32_t* b) {
+    uint32_t x[16];
+    memcpy(x, b, sizeof(x));
+    for (int i = 0; i < 8; i += 2) {
+#define SALSA_R(a, n) (((a) << (n)) | ((a) >> (32 - (n))))
+        x[4] ^= SALSA_R(x[0] + x[12], 7);
+        x[8] ^= SALSA_R(x[4] + x[0], 9);
+        x[12] ^= SALSA_R(x[8] + x[4], 13);
+        x[0] ^= SALSA_R(x[12] + x[8], 18);
+        x[9] ^= SALSA_R(x[5] + x[1], 7);
+        x[13] ^= SALSA_R(x[9] + x[5], 9);
+        x[1] ^= SALSA_R(x[13] + x[9], 13);
+        x[5] ^= SALSA_R(x[1] + x[13], 18);
+        x[14] ^= SALSA_R(x[10] + x[6], 7);
+        x[2] ^= SALSA_R(x[14] + x[10], 9);
+        x[6] ^= SALSA_R(x[2] + x[14], 13);
+        x[10] ^= SALSA_R(x[6] + x[2], 18);
+        x[3] ^= SALSA_R(x[15] + x[11], 7);
+        x[7] ^= SALSA_R(x[3] + x[15], 9);
+        x[11] ^= SALSA_R(x[7] + x[3], 13);
+        x[15] ^= SALSA_R(x[11] + x[7], 18);
+        x[1] ^= SALSA_R(x[0] + x[3], 7);
+        x[2] ^= SALSA_R(x[1] + x[0], 9);
+        x[3] ^= SALSA_R(x[2] + x[1], 13);
+        x[0] ^= SALSA_R(x[3] + x[2], 18);
+        x[6] ^= SALSA_R(x[5] + x[4], 7);
+        x[7] ^= SALSA_R(x[6] + x[5], 9);
+        x[4] ^= SALSA_R(x[7] + x[6], 13);
+        x[5] ^= SALSA_R(x[4] + x[7], 18);
+        x[11] ^= SALSA_R(x[10] + x[9], 7);
+        x[8] ^= SALSA_R(x[11] + x[10], 9);
+        x[9] ^= SALSA_R(x[8] + x[11], 13);
+        x[10] ^= SALSA_R(x[9] + x[8], 18);
+        x[12] ^= SALSA_R(x[15] + x[14], 7);
+        x[13] ^= SALSA_R(x[12] + x[15], 9);
+        x[14] ^= SALSA_R(x[13] + x[12], 13);
+        x[15] ^= SALSA_R(x[14] + x[13], 18);
+#undef SALSA_R
+    }
+    for (int i = 0; i < 16; i++) {
+        b[i] += x[i];
+    }
+}
+
+// scryptBlockMix of 2r 64-byte blocks from in to out
+static inline void scrypt_block_mix(const uint32_t* in, uint32_t* out, uint8_t r) {
+    uint32_t x[16];
+    memcpy(x, &in[(2 * r - 1) * 16], sizeof(x));
+    for (uint32_t i = 0; i < 2u * r; i++) {
+        for (int k = 0; k < 16; k++) {
+            x[k] ^= in[i * 16 + k];
+        }
+        salsa20_8(x);
+        memcpy(&out[((i & 1) * r + i / 2) * 16], x, sizeof(x));
+    }
+}
+
+// Bytes of working memory kdf_scrypt() needs
+static inline size_t kdf_memory_size(uint8_t log2_n, uint8_t r) {
+    return 128 * (size_t)r * ((1UL << log2_n) + 2);
+}
+
+// scryptROMix on one 128r-byte block, V and the scratch block Y are taken from memory
+static inline void scrypt_romix(uint8_t* block, uint8_t log2_n, uint8_t r, uint32_t* memory) {
+    size_t words = 32 * (size_t)r;
+    uint32_t n = 1UL << log2_n;
+    uint32_t* v = memory;
+    uint32_t* x = &memory[words * n];
+    uint32_t* y = x + words;
+    for (size_t k = 0; k < words; k++) {
+        x[k] = crypto_load_le32(&block[k * 4]);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        memcpy(&v[words * i], x, words * sizeof(uint32_t));
+        scrypt_block_mix(x, y, r);
+        memcpy(x, y, words * sizeof(uint32_t));
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t j = x[(2 * r - 1) * 16] & (n - 1);
+        for (size_t k = 0; k < words; k++) {
+            x[k] ^= v[words * j + k];
+        }
+        scrypt_block_mix(x, y, r);
+        memcpy(x, y, words * sizeof(uint32_t));
+    }
+    for (size_t k = 0; k < words; k++) {
+        crypto_store_le32(&block[k * 4], x[k]);
+    }
+}
+
+// scrypt into out. The p blocks are produced, mixed and absorbed into the final PBKDF2 one at a
+// time, so memory (kdf_memory_size() bytes, 4-byte aligned) does not grow with p.
+static inline void kdf_scrypt(
+    const uint8_t* password,
+    size_t password_length,
+    const uint8_t* salt,
+    size_t salt_length,
+    uint8_t log2_n,
+    uint8_t r,
+    uint32_t p,
+    uint32_t* memory,
+    uint8_t* out,
+    size_t out_length) {
+    size_t block_size = 128 * (size_t)r;
+    uint8_t* block = (uint8_t*)&memory[32 * (size_t)r * (1UL << log2_n)];
+    HmacSha256Key key;
+    Sha256 work;
+    Sha256 final;
+    hmac_sha256_key(&key, password, password_length, &work);
+    // The mixed blocks are the salt of the final PBKDF2, absorbed into its inner hash one by one
+    sha256_resume(&final, key.inner);
+    uint8_t mac[SHA256_SIZE];
+    for (uint32_t j = 0; j < p; j++) {
+        // Block j of PBKDF2-HMAC-SHA256(password, salt, 1, p * 128r) is made of 4r MACs
+        for (uint32_t k = 0; k < 4u * r; k++) {
+            hmac_sha256_counter(&key, &work, salt, salt_length, j * 4 * r + k + 1, &block[k * SHA256_SIZE]);
+        }
+        scrypt_romix(block, log2_n, r, memory);
+        sha256_update(&final, block, block_size);
+    }
+    for (uint32_t i = 1; out_length > 0; i++) {
+        size_t count = out_length < SHA256_SIZE ? out_length : SHA256_SIZE;
+        work = final;
+        hmac_sha256_finish(&key, &work, i, mac);
+        memcpy(out, mac, count);
+        out += count;
+        out_length -= count;
+    }
+    crypto_wipe(mac, sizeof(mac));
+    crypto_wipe(&key, sizeof(key));
+    crypto_wipe(&work, sizeof(work));
+    crypto_wipe(&final, sizeof(final));
+    crypto_wipe(memory, kdf_memory_size(log2_n, r));
+}
+
+// Derive the session keys from a PIN
+static inline void session_derive(
+    SessionKeys* keys,
+    const char* pin,
+    const uint8_t* salt,
+    size_t salt_length,
+    uint8_t log2_n,
+    uint8_t r,
+    uint32_t p,
+    uint32_t* memory) {
+    kdf_scrypt((const uint8_t*)pin, strlen(pin), salt, salt_length, log2_n, r, p, memory, (uint8_t*)keys, sizeof(SessionKeys));
+}
+
+// Number of passes p so one derivation takes about target_us with this memory. Passes are
+// doubled until a run lasts KDF_CALIBRATION_SHARE-th of the target, then scaled linearly. With
+// half of a 500 ms target, the 1 ms tick contributes under 0.5 % and the first-run overhead is
+// spread over a long run. kdf_bench lands within about 10 % of the target; an eighth of it missed
+// by a third. Calibrating costs between half and twice the target on top of the derivation.
+static inline uint32_t kdf_calibrate(uint8_t log2_n, uint8_t r, uint32_t target_us, uint32_t* memory, KdfClock clock) {
+    static const uint8_t sample[16] = {0};
+    uint8_t out[SHA256_SIZE];
+    uint32_t passes = 1;
+    uint32_t elapsed;
+    while (true) {
+        uint32_t start = clock();
+        kdf_scrypt(sample, sizeof(sample), sample, sizeof(sample), log2_n, r, passes, memory, out, sizeof(out));
+        elapsed = clock() - start;
+        if (elapsed >= target_us / KDF_CALIBRATION_SHARE || passes >= KDF_PASSES_MAX / 2) {
+            break;
+        }
+        passes *= 2;
+    }
+    uint64_t scaled = (uint64_t)passes * target_us / (elapsed ? elapsed : 1);
+    return scaled < 1 ? 1 : scaled > KDF_PASSES_MAX ? KDF_PASSES_MAX : (uint32_t)scaled;
+}
+
+// Value stored next to the KDF parameters to recognise a wrong PIN before touching entries
+static inline void session_verifier(const SessionKeys* keys, uint8_t* verifier) {
+    static const char label[] = "PassGen verifier";
+    HmacSha256 hmac;
+    uint8_t mac[SHA256_SIZE];
+    hmac_sha256_init(&hmac, keys->authenticate, SHA256_SIZE);
+    hmac_sha256_update(&hmac, label, sizeof(label) - 1);
+    hmac_sha256_final(&hmac, mac);
+    memcpy(verifier, mac, SESSION_VERIFIER_SIZE);
+    crypto_wipe(mac, sizeof(mac));
+}
+
+// Compare without stopping at the first difference
+static inline bool crypto_equal(const uint8_t* a, const uint8_t* b, size_t length) {
+    uint8_t difference = 0;
+    for (size_t i = 0; i < length; i++) {
+        difference |= a[i] ^ b[i];
+    }
+    return difference == 0;
+}
+
+// XOR data with the keystream HMAC(encrypt, nonce || counter)
+static inline void seal_keystream(const SessionKeys* keys, const uint8_t* nonce, uint8_t* data, size_t length) {
+    HmacSha256Key key;
+    Sha256 work;
+    uint8_t stream[SHA256_SIZE];
+    hmac_sha256_key(&key, keys->encrypt, SHA256_SIZE, &work);
+    for (uint32_t counter = 0; length > 0; counter++) {
+        size_t count = length < SHA256_SIZE ? length : SHA256_SIZE;
+        hmac_sha256_counter(&key, &work, nonce, SEAL_NONCE_SIZE, counter, stream);
+        for (size_t i = 0; i < count; i++) {
+            data[i] ^= stream[i];
+        }
+        data += count;
+        length -= count;
+    }
+    crypto_wipe(stream, sizeof(stream));
+    crypto_wipe(&key, sizeof(key));
+    crypto_wipe(&work, sizeof(work));
+}
+
+// Tag over nonce, name and ciphertext, so an entry cannot be moved to another name
+static inline void seal_tag(
+    const SessionKeys* keys,
+    const uint8_t* nonce,
+    const char* name,
+    size_t name_length,
+    const uint8_t* ciphertext,
+    size_t length,
+    uint8_t* tag) {
+    HmacSha256 hmac;
+    uint8_t mac[SHA256_SIZE];
+    uint8_t name_byte = name_length;
+    hmac_sha256_init(&hmac, keys->authenticate, SHA256_SIZE);
+    hmac_sha256_update(&hmac, nonce, SEAL_NONCE_SIZE);
+    hmac_sha256_update(&hmac, &name_byte, 1);
+    hmac_sha256_update(&hmac, name, name_length);
+    hmac_sha256_update(&hmac, ciphertext, length);
+    hmac_sha256_final(&hmac, mac);
+    memcpy(tag, mac, SEAL_TAG_SIZE);
+    crypto_wipe(mac, sizeof(mac));
+}
+
+// Encrypt in place and compute the tag
+static inline void seal(
+    const SessionKeys* keys, const uint8_t* nonce, const char* name, size_t name_length, uint8_t* data, size_t length, uint8_t* tag) {
+    seal_keystream(keys, nonce, data, length);
+    seal_tag(keys, nonce, name, name_length, data, length, tag);
+}
+
+// Check the tag and decrypt in place, false (data untouched) if the tag does not match
+static inline bool unseal(
+    const SessionKeys* keys,
+    const uint8_t* nonce,
+    const uint8_t* tag,
+    const char* name,
+    size_t name_length,
+    uint8_t* data,
+    size_t length) {
+    uint8_t expected[SEAL_TAG_SIZE];
+    seal_tag(keys, nonce, name, name_length, data, length, expected);
+    if (!crypto_equal(expected, tag, SEAL_TAG_SIZE)) {
+        return false;
+    }
+    seal_keystream(keys, nonce, data, length);
+    return true;
+}
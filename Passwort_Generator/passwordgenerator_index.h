@@ -0,0 +1,187 @@
+#pragma once
+
+// Sorted name index of the password vault. All names live in one string arena and a slot only
+// holds the arena offset of its name and the vault offset of its record, so building the index
+// costs no allocation per entry. Independent of the firmware so tools/ can benchmark it on a PC.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef VAULT_INDEX_REALLOC
+#define VAULT_INDEX_REALLOC realloc
+#endif
+#ifndef VAULT_INDEX_FREE
+#define VAULT_INDEX_FREE free
+#endif
+
+typedef struct {
+    uint32_t name;
+    uint32_t offset;
+} VaultSlot;
+
+typedef struct {
+    VaultSlot* slots;
+    uint32_t count;
+    uint32_t capacity;
+    char* names;
+    uint32_t names_used;
+    uint32_t names_capacity;
+} VaultIndex;
+
+// Name of a slot; the pointer is only valid until the next change to the index
+static inline const char* vault_index_name(const VaultIndex* index, uint32_t slot) {
+    return &index->names[index->slots[slot].name];
+}
+
+// Empty the index but keep its buffers for the next load
+static inline void vault_index_reset(VaultIndex* index) {
+    index->count = 0;
+    index->names_used = 0;
+}
+
+// Release the buffers
+static inline void vault_index_free(VaultIndex* index) {
+    VAULT_INDEX_FREE(index->slots);
+    VAULT_INDEX_FREE(index->names);
+    memset(index, 0, sizeof(VaultIndex));
+}
+
+// Make room for more slots and name bytes, growing each buffer at least twofold
+static inline bool vault_index_reserve(VaultIndex* index, uint32_t slots, uint32_t name_bytes) {
+    if (index->count + slots > index->capacity) {
+        uint32_t capacity = index->capacity ? index->capacity * 2 : 16;
+        if (capacity < index->count + slots) {
+            capacity = index->count + slots;
+        }
+        VaultSlot* grown = VAULT_INDEX_REALLOC(index->slots, capacity * sizeof(VaultSlot));
+        if (!grown) {
+            return false;
+        }
+        index->slots = grown;
+        index->capacity = capacity;
+    }
+    if (index->names_used + name_bytes > index->names_capacity) {
+        uint32_t capacity = index->names_capacity ? index->names_capacity * 2 : 256;
+        if (capacity < index->names_used + name_bytes) {
+            capacity = index->names_used + name_bytes;
+        }
+        char* grown = VAULT_INDEX_REALLOC(index->names, capacity);
+        if (!grown) {
+            return false;
+        }
+        index->names = grown;
+        index->names_capacity = capacity;
+    }
+    return true;
+}
+
+// Copy a name into the arena, returning its offset
+static inline uint32_t vault_index_store_name(VaultIndex* index, const char* name, size_t length) {
+    uint32_t offset = index->names_used;
+    memcpy(&index->names[offset], name, length);
+    index->names[offset + length] = '\0';
+    index->names_used += length + 1;
+    return offset;
+}
+
+// Append a slot without keeping the order; vault_index_sort() must follow
+static inline bool vault_index_append(VaultIndex* index, const char* name, size_t length, uint32_t offset) {
+    if (!vault_index_reserve(index, 1, length + 1)) {
+        return false;
+    }
+    index->slots[index->count].name = vault_index_store_name(index, name, length);
+    index->slots[index->count].offset = offset;
+    index->count++;
+    return true;
+}
+
+// Order by name, then by record offset so the latest record of a name sorts last
+static inline int vault_index_compare(const VaultIndex* index, const VaultSlot* a, const VaultSlot* b) {
+    int order = strcmp(&index->names[a->name], &index->names[b->name]);
+    if (order != 0) {
+        return order;
+    }
+    return a->offset < b->offset ? -1 : a->offset > b->offset;
+}
+
+static inline void vault_index_sift(VaultIndex* index, uint32_t root, uint32_t count) {
+    VaultSlot* slots = index->slots;
+    VaultSlot value = slots[root];
+    uint32_t child;
+    while ((child = 2 * root + 1) < count) {
+        if (child + 1 < count && vault_index_compare(index, &slots[child], &slots[child + 1]) < 0) {
+            child++;
+        }
+        if (vault_index_compare(index, &value, &slots[child]) >= 0) {
+            break;
+        }
+        slots[root] = slots[child];
+        root = child;
+    }
+    slots[root] = value;
+}
+
+// Sort in place with heapsort (O(n log n), no recursion and no extra memory), then keep only
+// the latest record of each name. Names of dropped slots stay in the arena until the next load.
+static inline void vault_index_sort(VaultIndex* index) {
+    VaultSlot* slots = index->slots;
+    for (uint32_t root = index->count / 2; root-- > 0;) {
+        vault_index_sift(index, root, index->count);
+    }
+    for (uint32_t end = index->count; end-- > 1;) {
+        VaultSlot top = slots[0];
+        slots[0] = slots[end];
+        slots[end] = top;
+        vault_index_sift(index, 0, end);
+    }
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < index->count; i++) {
+        if (i + 1 < index->count &&
+            strcmp(&index->names[slots[i].name], &index->names[slots[i + 1].name]) == 0) {
+            continue;
+        }
+        slots[kept++] = slots[i];
+    }
+    index->count = kept;
+}
+
+// Binary search for a name, returns its position or the position it would be inserted at
+static inline uint32_t vault_index_search(const VaultIndex* index, const char* name, bool* found) {
+    uint32_t low = 0;
+    uint32_t high = index->count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        int order = strcmp(vault_index_name(index, middle), name);
+        if (order == 0) {
+            *found = true;
+            return middle;
+        } else if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *found = false;
+    return low;
+}
+
+// Point a name at a record, inserting it in sorted order if it is new
+static inline bool vault_index_set(VaultIndex* index, const char* name, uint32_t offset) {
+    bool found;
+    uint32_t position = vault_index_search(index, name, &found);
+    if (found) {
+        index->slots[position].offset = offset;
+        return true;
+    }
+    size_t length = strlen(name);
+    if (!vault_index_reserve(index, 1, length + 1)) {
+        return false;
+    }
+    memmove(&index->slots[position + 1], &index->slots[position], (index->count - position) * sizeof(VaultSlot));
+    index->slots[position].name = vault_index_store_name(index, name, length);
+    index->slots[position].offset = offset;
+    index->count++;
+    return true;
+}
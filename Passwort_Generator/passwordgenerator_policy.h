@@ -0,0 +1,246 @@
+#pragma once
+
+// Password policies: length, enabled character classes, a minimum count per class and whether
+// look-alike characters are left out. A policy is compiled once into a 256-entry class table and
+// a flattened alphabet, so generating a password is one table lookup per character. Policies are
+// stored one per line as "name length classes upper lower digit special lookalikes", classes as
+// letters of POLICY_CLASS_LETTERS and a leading '*' marking the selected policy.
+// Independent of the firmware so tools/ can use it.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "passwordgenerator_random.h"
+
+#define POLICY_LENGTH_MIN 4
+#define POLICY_LENGTH_MAX 32
+#define POLICY_NAME_MAX 12
+#define POLICY_CLASS_NONE 0xFF
+#define POLICY_CLASS_LETTERS "ULDS"
+#define POLICY_CLASSES_ALL ((1 << PolicyClassCount) - 1)
+#define POLICY_FILE_HEADER \
+    "# name length classes(" POLICY_CLASS_LETTERS ") min-upper min-lower min-digit min-special no-lookalikes\n"
+// Passwords drawn before a policy counts as too strict to satisfy
+#define POLICY_ATTEMPTS_MAX 4096
+
+typedef enum {
+    PolicyClassUpper,
+    PolicyClassLower,
+    PolicyClassDigit,
+    PolicyClassSpecial,
+    PolicyClassCount,
+} PolicyClass;
+
+static const char* const policy_class_chars[PolicyClassCount] = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+    "abcdefghijklmnopqrstuvwxyz",
+    "0123456789",
+    "!$%&-",
+};
+
+// Characters easily confused with one another on screen or paper
+static const char policy_lookalikes[] = "0O1Il";
+
+typedef struct {
+    char name[POLICY_NAME_MAX + 1];
+    uint8_t length;
+    uint8_t classes;
+    uint8_t minimum[PolicyClassCount];
+    bool exclude_lookalikes;
+} PasswordPolicy;
+
+typedef struct {
+    uint8_t class_of[256];
+    char alphabet[96];
+    uint8_t size;
+    uint8_t length;
+    uint8_t minimum[PolicyClassCount];
+} PolicyTable;
+
+// Check the limits; a minimum of a disabled class is not allowed
+static inline bool policy_valid(const PasswordPolicy* policy) {
+    if (policy->length < POLICY_LENGTH_MIN || policy->length > POLICY_LENGTH_MAX || policy->classes == 0 ||
+        policy->classes > POLICY_CLASSES_ALL) {
+        return false;
+    }
+    uint32_t required = 0;
+    for (int class = 0; class < PolicyClassCount; class++) {
+        if (policy->minimum[class] > 0 && !(policy->classes & (1 << class))) {
+            return false;
+        }
+        required += policy->minimum[class];
+    }
+    return required <= policy->length;
+}
+
+// Build the class table and the alphabet of a policy
+static inline bool policy_compile(const PasswordPolicy* policy, PolicyTable* table) {
+    if (!policy_valid(policy)) {
+        return false;
+    }
+    memset(table->class_of, POLICY_CLASS_NONE, sizeof(table->class_of));
+    table->size = 0;
+    table->length = policy->length;
+    for (int class = 0; class < PolicyClassCount; class++) {
+        uint8_t before = table->size;
+        table->minimum[class] = policy->minimum[class];
+        if (!(policy->classes & (1 << class))) {
+            continue;
+        }
+        for (const char* c = policy_class_chars[class]; *c; c++) {
+            if (policy->exclude_lookalikes && strchr(policy_lookalikes, *c)) {
+                continue;
+            }
+            table->class_of[(uint8_t)*c] = class;
+            table->alphabet[table->size++] = *c;
+        }
+        if (table->size == before && policy->minimum[class] > 0) {
+            return false;
+        }
+    }
+    table->alphabet[table->size] = '\0';
+    return table->size >= 2;
+}
+
+// Generate a password of the policy length. Passwords missing a class minimum are redrawn
+// whole, so the result is uniform over all passwords meeting the policy. Returns the number of
+// passwords drawn, or 0 (and an empty password) after POLICY_ATTEMPTS_MAX failures.
+static inline uint32_t policy_generate(const PolicyTable* table, EntropyPool* pool, char* password) {
+    EntropySampler sampler;
+    entropy_sampler_init(&sampler, table->size);
+    for (uint32_t attempts = 1; attempts <= POLICY_ATTEMPTS_MAX; attempts++) {
+        uint8_t counts[PolicyClassCount] = {0};
+        for (uint8_t i = 0; i < table->length; i++) {
+            password[i] = table->alphabet[entropy_sample(&sampler, pool)];
+            counts[table->class_of[(uint8_t)password[i]]]++;
+        }
+        password[table->length] = '\0';
+        bool valid = true;
+        for (int class = 0; class < PolicyClassCount; class++) {
+            valid = valid && counts[class] >= table->minimum[class];
+        }
+        if (valid) {
+            sampler.value = 0;
+            return attempts;
+        }
+    }
+    sampler.value = 0;
+    memset(password, 0, table->length + 1);
+    return 0;
+}
+
+// Letters of the enabled classes into a buffer of PolicyClassCount + 1 bytes
+static inline void policy_class_letters(const PasswordPolicy* policy, char* classes) {
+    for (int class = 0; class < PolicyClassCount; class++) {
+        if (policy->classes & (1 << class)) {
+            *classes++ = POLICY_CLASS_LETTERS[class];
+        }
+    }
+    *classes = '\0';
+}
+
+// Short description like "16 ULDS 0011" for lists
+static inline void policy_describe(const PasswordPolicy* policy, char* text, size_t size) {
+    char classes[PolicyClassCount + 1];
+    char minimum[PolicyClassCount + 1];
+    policy_class_letters(policy, classes);
+    for (int class = 0; class < PolicyClassCount; class++) {
+        minimum[class] = policy->minimum[class] > 9 ? '+' : '0' + policy->minimum[class];
+    }
+    minimum[PolicyClassCount] = '\0';
+    snprintf(text, size, "%u %s %s%s", policy->length, classes, minimum, policy->exclude_lookalikes ? " -O0" : "");
+}
+
+// Parse one stored line, false for comments and malformed lines
+static inline bool policy_parse(const char* line, PasswordPolicy* policy, bool* selected) {
+    char classes[8];
+    unsigned int length;
+    unsigned int minimum[PolicyClassCount];
+    unsigned int exclude;
+    *selected = line[0] == '*';
+    if (*selected) {
+        line++;
+    }
+    if (line[0] == '#' ||
+        sscanf(line, "%12s %u %7s %u %u %u %u %u", policy->name, &length, classes, &minimum[0], &minimum[1], &minimum[2], &minimum[3], &exclude) != 8 ||
+        length > POLICY_LENGTH_MAX) {
+        return false;
+    }
+    policy->length = length;
+    policy->classes = 0;
+    for (const char* c = classes; *c; c++) {
+        const char* letter = strchr(POLICY_CLASS_LETTERS, *c);
+        if (!letter) {
+            return false;
+        }
+        policy->classes |= 1 << (letter - POLICY_CLASS_LETTERS);
+    }
+    for (int class = 0; class < PolicyClassCount; class++) {
+        if (minimum[class] > POLICY_LENGTH_MAX) {
+            return false;
+        }
+        policy->minimum[class] = minimum[class];
+    }
+    policy->exclude_lookalikes = exclude != 0;
+    return policy_valid(policy);
+}
+
+// Format a policy as one stored line including the newline, returns its length
+static inline int policy_format(const PasswordPolicy* policy, bool selected, char* line, size_t size) {
+    char classes[PolicyClassCount + 1];
+    policy_class_letters(policy, classes);
+    return snprintf(
+        line,
+        size,
+        "%s%s %u %s %u %u %u %u %u\n",
+        selected ? "*" : "",
+        policy->name,
+        policy->length,
+        classes,
+        policy->minimum[PolicyClassUpper],
+        policy->minimum[PolicyClassLower],
+        policy->minimum[PolicyClassDigit],
+        policy->minimum[PolicyClassSpecial],
+        policy->exclude_lookalikes);
+}
+
+// Format the whole policy file into text. Returns its length without the terminator, or 0 when
+// it does not fit into size bytes, so a truncated file is never written.
+static inline size_t policy_file_format(const PasswordPolicy* policies, int count, int selected, char* text, size_t size) {
+    size_t used = strlen(POLICY_FILE_HEADER);
+    if (used >= size) {
+        return 0;
+    }
+    memcpy(text, POLICY_FILE_HEADER, used + 1);
+    for (int i = 0; i < count; i++) {
+        int length = policy_format(&policies[i], i == selected, &text[used], size - used);
+        if (length < 0 || used + length >= size) {
+            return 0;
+        }
+        used += length;
+    }
+    return used;
+}
+
+// Parse the policy file in place, returns the number of policies read into policies
+static inline int policy_file_parse(char* text, PasswordPolicy* policies, int max, int* selected) {
+    int count = 0;
+    *selected = 0;
+    for (char* line = text; line && count < max;) {
+        char* next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        bool is_selected;
+        if (policy_parse(line, &policies[count], &is_selected)) {
+            if (is_selected) {
+                *selected = count;
+            }
+            count++;
+        }
+        line = next;
+    }
+    return count;
+}
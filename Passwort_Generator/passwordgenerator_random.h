@@ -0,0 +1,87 @@
+#pragma once
+
+// Entropy pool and unbiased character sampling for password generation. The pool fetches
+// ENTROPY_POOL_WORDS words per call to the hardware RNG. A sampler turns one accepted word into
+// several characters: for an alphabet of n characters it uses the largest k with n^k <= 2^32,
+// rejects words at or above the largest multiple of n^k and reads k base-n digits from the rest,
+// so every character is exactly uniform. Independent of the firmware so tools/ can measure it.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ENTROPY_POOL_WORDS 16
+
+// Fills a buffer from the random source, furi_hal_random_fill_buf() on the device
+typedef void (*EntropyFill)(uint8_t* buffer, uint32_t length);
+
+typedef struct {
+    uint32_t words[ENTROPY_POOL_WORDS];
+    uint32_t position;
+    EntropyFill fill;
+    uint32_t refills;
+    uint32_t words_used;
+} EntropyPool;
+
+typedef struct {
+    uint32_t size;
+    uint32_t per_word;
+    uint64_t span;
+    uint64_t limit;
+    uint32_t value;
+    uint32_t left;
+} EntropySampler;
+
+static inline void entropy_pool_init(EntropyPool* pool, EntropyFill fill) {
+    memset(pool, 0, sizeof(EntropyPool));
+    pool->fill = fill;
+    pool->position = ENTROPY_POOL_WORDS;
+}
+
+// Take the next word, refilling the whole pool when it is used up. Used words are cleared.
+static inline uint32_t entropy_pool_word(EntropyPool* pool) {
+    if (pool->position == ENTROPY_POOL_WORDS) {
+        pool->fill((uint8_t*)pool->words, sizeof(pool->words));
+        pool->position = 0;
+        pool->refills++;
+    }
+    uint32_t word = pool->words[pool->position];
+    pool->words[pool->position++] = 0;
+    pool->words_used++;
+    return word;
+}
+
+// Drop the unused entropy
+static inline void entropy_pool_clear(EntropyPool* pool) {
+    memset(pool->words, 0, sizeof(pool->words));
+    pool->position = ENTROPY_POOL_WORDS;
+}
+
+// Prepare a sampler for indices in [0, size), size must be at least 2
+static inline void entropy_sampler_init(EntropySampler* sampler, uint32_t size) {
+    sampler->size = size;
+    sampler->per_word = 0;
+    sampler->span = 1;
+    while (sampler->span * size <= (1ULL << 32)) {
+        sampler->span *= size;
+        sampler->per_word++;
+    }
+    sampler->limit = (1ULL << 32) / sampler->span * sampler->span;
+    sampler->left = 0;
+}
+
+// Next uniform index, drawing a new word only after per_word indices
+static inline uint32_t entropy_sample(EntropySampler* sampler, EntropyPool* pool) {
+    if (sampler->left == 0) {
+        uint32_t word;
+        do {
+            word = entropy_pool_word(pool);
+        } while (word >= sampler->limit);
+        sampler->value = sampler->span == (1ULL << 32) ? word : (uint32_t)(word % sampler->span);
+        sampler->left = sampler->per_word;
+    }
+    uint32_t index = sampler->value % sampler->size;
+    sampler->value /= sampler->size;
+    sampler->left--;
+    return index;
+}
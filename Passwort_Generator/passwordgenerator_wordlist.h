@@ -0,0 +1,146 @@
+#pragma once
+
+// Word index for Diceware passphrases. A wordlist on the SD card is turned into an index file of
+// fixed-width records, one per word, so word i is found with one seek to a computed position and
+// one short read, without holding the list in memory. The index is built by a streaming parser
+// that accepts one word per line, optionally after dice numbers as in the EFF lists
+// ("11111<TAB>abacus"). Independent of the firmware so tools/ can build and measure it.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define WORDLIST_MAGIC "PWWI"
+// Word bytes plus terminator; longer words are skipped when building
+#define WORDLIST_RECORD_SIZE 16
+#define PASSPHRASE_WORDS 6
+#define PASSPHRASE_SEPARATOR '-'
+
+// Index file header, followed by count records. Size and timestamp of the wordlist tell
+// whether the index is still current.
+typedef struct __attribute__((packed)) {
+    char magic[4];
+    uint32_t count;
+    uint32_t source_size;
+    uint32_t source_timestamp;
+} WordlistHeader;
+
+typedef void (*WordlistEmit)(const char* word, uint8_t length, void* context);
+
+typedef enum {
+    WordlistLineStart,
+    WordlistToken,
+    WordlistSpace,
+    WordlistSkipLine,
+} WordlistState;
+
+typedef struct {
+    WordlistState state;
+    char word[WORDLIST_RECORD_SIZE];
+    uint8_t length;
+    bool all_digits;
+    bool after_dice;
+    bool too_long;
+    uint32_t words;
+    uint32_t skipped;
+    WordlistEmit emit;
+    void* context;
+} WordlistParser;
+
+static inline void wordlist_parser_init(WordlistParser* parser, WordlistEmit emit, void* context) {
+    memset(parser, 0, sizeof(WordlistParser));
+    parser->emit = emit;
+    parser->context = context;
+}
+
+static inline bool wordlist_is_space(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Add a byte to the current token, marking tokens that do not fit a record
+static inline void wordlist_token_add(WordlistParser* parser, uint8_t c) {
+    if (parser->length < WORDLIST_RECORD_SIZE - 1) {
+        parser->word[parser->length++] = c;
+        parser->all_digits = parser->all_digits && c >= '0' && c <= '9';
+    } else {
+        parser->too_long = true;
+        parser->all_digits = false;
+    }
+}
+
+// A token ends at whitespace or the end of the line. Digits alone followed by more on the
+// line are the dice number; anything else is the word and the rest of the line is ignored.
+static inline void wordlist_end_token(WordlistParser* parser, bool line_end) {
+    if (parser->all_digits && !parser->after_dice && !line_end) {
+        parser->after_dice = true;
+        parser->state = WordlistSpace;
+    } else {
+        if (parser->too_long) {
+            parser->skipped++;
+        } else if (parser->length > 0) {
+            parser->word[parser->length] = '\0';
+            parser->emit(parser->word, parser->length, parser->context);
+            parser->words++;
+        }
+        parser->state = WordlistSkipLine;
+    }
+    parser->length = 0;
+    parser->too_long = false;
+}
+
+// Parse the next chunk of the wordlist
+static inline void wordlist_parser_feed(WordlistParser* parser, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = data[i];
+        if (c == '\n') {
+            if (parser->state == WordlistToken) {
+                wordlist_end_token(parser, true);
+            }
+            parser->state = WordlistLineStart;
+            parser->after_dice = false;
+            continue;
+        }
+        switch (parser->state) {
+        case WordlistLineStart:
+        case WordlistSpace:
+            if (c == '#' && parser->state == WordlistLineStart) {
+                parser->state = WordlistSkipLine;
+            } else if (!wordlist_is_space(c)) {
+                parser->state = WordlistToken;
+                parser->all_digits = true;
+                wordlist_token_add(parser, c);
+            }
+            break;
+        case WordlistToken:
+            if (wordlist_is_space(c)) {
+                wordlist_end_token(parser, false);
+            } else {
+                wordlist_token_add(parser, c);
+            }
+            break;
+        case WordlistSkipLine:
+            break;
+        }
+    }
+}
+
+// Flush a last line without a newline
+static inline void wordlist_parser_finish(WordlistParser* parser) {
+    if (parser->state == WordlistToken) {
+        wordlist_end_token(parser, true);
+    }
+    parser->state = WordlistLineStart;
+}
+
+// Position of a record in the index file
+static inline uint32_t wordlist_record_offset(uint32_t index) {
+    return sizeof(WordlistHeader) + index * WORDLIST_RECORD_SIZE;
+}
+
+// Check a header against the wordlist it was built from and the size of the index file
+static inline bool wordlist_header_current(
+    const WordlistHeader* header, uint32_t source_size, uint32_t source_timestamp, uint32_t index_size) {
+    return memcmp(header->magic, WORDLIST_MAGIC, sizeof(header->magic)) == 0 && header->count >= 2 &&
+           header->source_size == source_size && header->source_timestamp == source_timestamp &&
+           wordlist_record_offset(header->count) == index_size;
+}
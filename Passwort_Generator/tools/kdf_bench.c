@@ -0,0 +1,133 @@
+// Checks the scrypt implementation of the app against the RFC 7914 test vectors, then runs the
+// same calibration as the app on the PC: for each memory size kdf_calibrate() picks the number of
+// passes that reaches the target unlock time, and one derivation with it is timed. Also measures
+// sealing and unsealing one entry with the session keys, which is what every Show costs once
+// the vault is unlocked.
+//
+// Build:  cc -O2 -o kdf_bench tools/kdf_bench.c
+// Run:    kdf_bench [target_ms]   (default 500, as in the app)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../passwordgenerator_crypto.h"
+
+#define KDF_TARGET_MS 500
+#define KDF_R 1
+#define SEAL_ROUNDS 10000
+
+typedef struct {
+    const char* password;
+    const char* salt;
+    uint8_t log2_n;
+    uint8_t r;
+    uint32_t p;
+    const char* expected;
+} Vector;
+
+static const Vector vectors[] = {
+    {"", "", 4, 1, 1,
+     "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+     "fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906"},
+    {"password", "NaCl", 10, 8, 16,
+     "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+     "2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640"},
+    {"pleaseletmein", "SodiumChloride", 14, 8, 1,
+     "7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2"
+     "d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887"},
+};
+
+static double elapsed_us(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static uint32_t clock_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000u + now.tv_nsec / 1000;
+}
+
+static bool check_vector(const Vector* vector) {
+    uint32_t* memory = malloc(kdf_memory_size(vector->log2_n, vector->r));
+    uint8_t out[64];
+    char hex[sizeof(out) * 2 + 1];
+    kdf_scrypt(
+        (const uint8_t*)vector->password,
+        strlen(vector->password),
+        (const uint8_t*)vector->salt,
+        strlen(vector->salt),
+        vector->log2_n,
+        vector->r,
+        vector->p,
+        memory,
+        out,
+        sizeof(out));
+    free(memory);
+    for (size_t i = 0; i < sizeof(out); i++) {
+        sprintf(&hex[i * 2], "%02x", out[i]);
+    }
+    bool ok = strcmp(hex, vector->expected) == 0;
+    printf("scrypt(\"%s\", \"%s\", N=%u, r=%u, p=%u): %s\n", vector->password, vector->salt, 1u << vector->log2_n, vector->r, vector->p, ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    int target_ms = argc > 1 ? atoi(argv[1]) : KDF_TARGET_MS;
+    if (argc > 2 || target_ms <= 0) {
+        fprintf(stderr, "usage: %s [target_ms]\n", argv[0]);
+        return 1;
+    }
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        ok = check_vector(&vectors[i]) && ok;
+    }
+    if (!ok) {
+        return 1;
+    }
+
+    // Calibration as in the app, then one derivation with the chosen passes
+    static const uint8_t salt[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    SessionKeys keys;
+    for (uint8_t log2_n = 5; log2_n <= 10; log2_n++) {
+        uint32_t* memory = malloc(kdf_memory_size(log2_n, KDF_R));
+        uint32_t p = kdf_calibrate(log2_n, KDF_R, target_ms * 1000u, memory, clock_us);
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        session_derive(&keys, "UdLRuDlRUd", salt, sizeof(salt), log2_n, KDF_R, p, memory);
+        double unlock_us = elapsed_us(&start);
+        printf(
+            "%6zu bytes: %5u passes -> unlock %7.1f ms%s\n",
+            kdf_memory_size(log2_n, KDF_R),
+            p,
+            unlock_us / 1000,
+            p == KDF_PASSES_MAX ? " (pass limit)" : "");
+        free(memory);
+    }
+
+    // Per-entry cost once the keys are cached
+    uint8_t nonce[SEAL_NONCE_SIZE] = {0};
+    uint8_t tag[SEAL_TAG_SIZE];
+    char password[25] = "Xy7!pQ2$mN4&rT8-kL3%wZ9a";
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < SEAL_ROUNDS; i++) {
+        nonce[0] = i;
+        seal(&keys, nonce, "ENTRY", 5, (uint8_t*)password, sizeof(password), tag);
+        if (!unseal(&keys, nonce, tag, "ENTRY", 5, (uint8_t*)password, sizeof(password))) {
+            fprintf(stderr, "unseal failed\n");
+            return 1;
+        }
+    }
+    printf("seal + unseal of a %zu-byte entry: %.2f us\n", sizeof(password), elapsed_us(&start) / SEAL_ROUNDS);
+    seal(&keys, nonce, "ENTRY", 5, (uint8_t*)password, sizeof(password), tag);
+    bool moved = unseal(&keys, nonce, tag, "OTHER", 5, (uint8_t*)password, sizeof(password));
+    password[0] ^= 1;
+    bool changed = unseal(&keys, nonce, tag, "ENTRY", 5, (uint8_t*)password, sizeof(password));
+    printf("renamed entry rejected: %s, changed ciphertext rejected: %s\n", moved ? "no" : "yes", changed ? "no" : "yes");
+    crypto_wipe(&keys, sizeof(keys));
+    return 0;
+}
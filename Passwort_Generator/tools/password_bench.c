@@ -0,0 +1,215 @@
+// Measures on the PC how fast passwords are generated and how often the random source is called,
+// for the old per-character generator and for the policy engine of the app. A splitmix64
+// generator stands in for the hardware RNG; only the number of calls and words matters.
+//
+// Build:  cc -O2 -o password_bench tools/password_bench.c
+// Run:    password_bench [policies.txt]   (default: the policies the app starts with)
+//
+// The policies are first saved and loaded back the way the app stores them, with the last one
+// selected and lengthened, and the run stops if anything differs.
+//
+//   modulo  one furi_hal_random_get() per character reduced with %, then up to four more calls
+//           to patch in a missing special character or digit (the old generate_password, run
+//           with the length of the first policy and checked against it)
+//   policy  policy_generate(): ENTROPY_POOL_WORDS words per source call, several unbiased
+//           characters per word, whole passwords redrawn until every class minimum holds
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../passwordgenerator_policy.h"
+
+#define BENCHMARK_MIN_SECONDS 0.5
+#define POLICY_MAX 8
+#define POLICY_FILE_MAX 1024
+
+// Same policies as default_policies in passwordgenerator.c
+static const char default_policies[] = "*Default 16 ULDS 0 0 1 1 0\n"
+                                       "Strong 24 ULDS 2 2 2 2 1\n"
+                                       "Readable 12 ULD 1 1 1 0 1\n"
+                                       "PIN 6 D 0 0 0 0 0\n";
+
+static const char charsets[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789!$%&-";
+static const char* const required_sets[] = {"!$%&-", "0123456789"};
+
+static uint64_t source_state = 1;
+static uint64_t source_calls;
+static uint64_t source_words;
+
+static uint32_t source_next(void) {
+    uint64_t z = (source_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (z ^ (z >> 31)) >> 32;
+}
+
+static uint32_t random_get(void) {
+    source_calls++;
+    source_words++;
+    return source_next();
+}
+
+static void random_fill(uint8_t* buffer, uint32_t length) {
+    source_calls++;
+    for (uint32_t i = 0; i < length; i += sizeof(uint32_t)) {
+        uint32_t word = source_next();
+        memcpy(&buffer[i], &word, length - i < sizeof(word) ? length - i : sizeof(word));
+        source_words++;
+    }
+}
+
+static uint32_t modulo_password(char* password, int length) {
+    size_t charsets_size = strlen(charsets);
+    bool has_special = false;
+    bool has_digit = false;
+    for (int i = 0; i < length; i++) {
+        password[i] = charsets[random_get() % charsets_size];
+        has_special = has_special || strchr(required_sets[0], password[i]);
+        has_digit = has_digit || strchr(required_sets[1], password[i]);
+    }
+    if (!has_special) {
+        password[random_get() % length] = required_sets[0][random_get() % strlen(required_sets[0])];
+    }
+    if (!has_digit) {
+        password[random_get() % length] = required_sets[1][random_get() % strlen(required_sets[1])];
+    }
+    password[length] = '\0';
+    return 1;
+}
+
+static EntropyPool pool;
+static PolicyTable table;
+
+static uint32_t policy_password(char* password, int length) {
+    (void)length;
+    return policy_generate(&table, &pool, password);
+}
+
+// Check every class minimum through the class table
+static bool meets_policy(const char* password) {
+    uint8_t counts[PolicyClassCount] = {0};
+    for (const char* c = password; *c; c++) {
+        if (table.class_of[(uint8_t)*c] == POLICY_CLASS_NONE) {
+            return false;
+        }
+        counts[table.class_of[(uint8_t)*c]]++;
+    }
+    for (int class = 0; class < PolicyClassCount; class++) {
+        if (counts[class] < table.minimum[class]) {
+            return false;
+        }
+    }
+    return strlen(password) == table.length;
+}
+
+static void benchmark(const char* name, const char* method, uint32_t (*generate)(char*, int), int length) {
+    char password[256];
+    uint64_t passwords = 0;
+    uint64_t attempts = 0;
+    uint64_t invalid = 0;
+    source_calls = 0;
+    source_words = 0;
+    entropy_pool_init(&pool, random_fill);
+
+    double seconds;
+    clock_t start = clock();
+    do {
+        for (int i = 0; i < 1000; i++) {
+            attempts += generate(password, length);
+            passwords++;
+            if (!meets_policy(password)) {
+                invalid++;
+            }
+        }
+        seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    } while (seconds < BENCHMARK_MIN_SECONDS);
+
+    // Words the pool fetched but did not use yet are not counted against it
+    uint64_t words = source_words - (generate == policy_password ? ENTROPY_POOL_WORDS - pool.position : 0);
+    printf(
+        "%-12s %2d %-7s %9.0f passwords/s %7.3f source calls %6.2f words %6.2f attempts per password%s\n",
+        name,
+        length,
+        method,
+        passwords / seconds,
+        (double)source_calls / passwords,
+        (double)words / passwords,
+        (double)attempts / passwords,
+        invalid ? " (rule violated)" : "");
+}
+
+// Save the policies as policy_store_save() does and load them back as policy_store_load() does
+static bool round_trip(const PasswordPolicy* policies, int count) {
+    PasswordPolicy changed[POLICY_MAX];
+    PasswordPolicy loaded[POLICY_MAX];
+    char text[POLICY_FILE_MAX + 1];
+    int selected = count - 1;
+    memcpy(changed, policies, count * sizeof(PasswordPolicy));
+    if (changed[selected].length < POLICY_LENGTH_MAX) {
+        changed[selected].length++;
+    }
+    size_t length = policy_file_format(changed, count, selected, text, sizeof(text));
+    int loaded_selected;
+    int loaded_count = length > 0 ? policy_file_parse(text, loaded, POLICY_MAX, &loaded_selected) : 0;
+    bool ok = loaded_count == count && loaded_selected == selected;
+    for (int i = 0; i < loaded_count && ok; i++) {
+        ok = strcmp(loaded[i].name, changed[i].name) == 0 && loaded[i].length == changed[i].length &&
+             loaded[i].classes == changed[i].classes &&
+             memcmp(loaded[i].minimum, changed[i].minimum, sizeof(loaded[i].minimum)) == 0 &&
+             loaded[i].exclude_lookalikes == changed[i].exclude_lookalikes;
+    }
+    printf("save and load: %zu bytes, %d of %d policies back%s\n", length, loaded_count, count, ok ? "" : " (MISMATCH)");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    char text[POLICY_FILE_MAX];
+    size_t size = strlen(default_policies);
+    memcpy(text, default_policies, size + 1);
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [policies.txt]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2) {
+        FILE* file = fopen(argv[1], "r");
+        if (!file) {
+            perror(argv[1]);
+            return 1;
+        }
+        size = fread(text, 1, sizeof(text) - 1, file);
+        text[size] = '\0';
+        fclose(file);
+    }
+
+    PasswordPolicy policies[POLICY_MAX];
+    int selected;
+    int count = policy_file_parse(text, policies, POLICY_MAX, &selected);
+    if (count == 0 || !round_trip(policies, count)) {
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        char description[32];
+        if (!policy_compile(&policies[i], &table)) {
+            fprintf(stderr, "%s: policy cannot be used\n", policies[i].name);
+            continue;
+        }
+        EntropySampler sampler;
+        entropy_sampler_init(&sampler, table.size);
+        policy_describe(&policies[i], description, sizeof(description));
+        printf(
+            "%s (%s): %u characters, %u per accepted word, %.2f%% of words rejected\n",
+            policies[i].name,
+            description,
+            table.size,
+            sampler.per_word,
+            100.0 * (double)((1ULL << 32) - sampler.limit) / (double)(1ULL << 32));
+        if (i == 0) {
+            benchmark(policies[i].name, "modulo", modulo_password, table.length);
+        }
+        benchmark(policies[i].name, "policy", policy_password, table.length);
+    }
+    return 0;
+}
@@ -0,0 +1,239 @@
+// Measures on the PC how long building the list of saved passwords takes and how much heap it
+// needs, for the old per-name list and for the arena-backed vault index of the app.
+//
+// Build:  cc -O2 -o vault_bench tools/vault_bench.c
+// Run:    vault_bench [count ...]   (default 100 1000 10000)
+//
+// Each count runs on the same shuffled names with three strategies:
+//   list    one strdup per name, the array grown by one per name, then bubble sort (the old Show
+//           Password screen, which rebuilt the list on every visit)
+//   insert  one strdup per name, sorted insert with memmove (a vault replay before the arena)
+//   arena   names appended to one arena, then one heapsort (vault_index_append/vault_index_sort)
+// plus "reload", an arena load into the buffers of the previous one after vault_index_reset.
+// Peak heap counts VAULT_BENCH_BLOCK_OVERHEAD bytes per live block, like the firmware allocator.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static size_t heap_live;
+static size_t heap_peak;
+static size_t heap_allocations;
+
+#define VAULT_BENCH_BLOCK_OVERHEAD 8
+#define BENCHMARK_MIN_SECONDS 0.2
+
+// Allocator that remembers each block size in front of the block
+static void* bench_realloc(void* block, size_t size) {
+    size_t* header = block ? (size_t*)block - 1 : NULL;
+    if (header) {
+        heap_live -= *header + VAULT_BENCH_BLOCK_OVERHEAD;
+    }
+    header = realloc(header, sizeof(size_t) + size);
+    if (!header) {
+        return NULL;
+    }
+    *header = size;
+    heap_live += size + VAULT_BENCH_BLOCK_OVERHEAD;
+    heap_allocations++;
+    if (heap_live > heap_peak) {
+        heap_peak = heap_live;
+    }
+    return header + 1;
+}
+
+static void bench_free(void* block) {
+    if (block) {
+        size_t* header = (size_t*)block - 1;
+        heap_live -= *header + VAULT_BENCH_BLOCK_OVERHEAD;
+        free(header);
+    }
+}
+
+static char* bench_strdup(const char* name) {
+    size_t length = strlen(name) + 1;
+    char* copy = bench_realloc(NULL, length);
+    memcpy(copy, name, length);
+    return copy;
+}
+
+#define VAULT_INDEX_REALLOC bench_realloc
+#define VAULT_INDEX_FREE bench_free
+#include "../passwordgenerator_index.h"
+
+typedef struct {
+    size_t peak;
+    size_t allocations;
+} HeapUse;
+
+static void heap_start(void) {
+    heap_peak = heap_live;
+    heap_allocations = 0;
+}
+
+static HeapUse heap_stop(size_t base) {
+    HeapUse use = {heap_peak - base, heap_allocations};
+    return use;
+}
+
+static void list_build(char** names, int count) {
+    char** list = NULL;
+    for (int i = 0; i < count; i++) {
+        list = bench_realloc(list, (i + 1) * sizeof(char*));
+        list[i] = bench_strdup(names[i]);
+    }
+    for (int i = 0; i < count - 1; i++) {
+        for (int j = 0; j < count - i - 1; j++) {
+            if (strcmp(list[j], list[j + 1]) > 0) {
+                char* temp = list[j];
+                list[j] = list[j + 1];
+                list[j + 1] = temp;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        bench_free(list[i]);
+    }
+    bench_free(list);
+}
+
+typedef struct {
+    char* name;
+    uint32_t offset;
+} InsertSlot;
+
+static void insert_build(char** names, int count) {
+    InsertSlot* slots = NULL;
+    int used = 0;
+    int capacity = 0;
+    for (int i = 0; i < count; i++) {
+        int low = 0;
+        int high = used;
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (strcmp(slots[middle].name, names[i]) < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (used == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            slots = bench_realloc(slots, capacity * sizeof(InsertSlot));
+        }
+        memmove(&slots[low + 1], &slots[low], (used - low) * sizeof(InsertSlot));
+        slots[low].name = bench_strdup(names[i]);
+        slots[low].offset = i;
+        used++;
+    }
+    for (int i = 0; i < used; i++) {
+        bench_free(slots[i].name);
+    }
+    bench_free(slots);
+}
+
+static void arena_build(VaultIndex* index, char** names, int count) {
+    vault_index_reset(index);
+    for (int i = 0; i < count; i++) {
+        vault_index_append(index, names[i], strlen(names[i]), i);
+    }
+    vault_index_sort(index);
+}
+
+static void arena_once(char** names, int count) {
+    VaultIndex index = {0};
+    arena_build(&index, names, count);
+    vault_index_free(&index);
+}
+
+// Run a strategy until BENCHMARK_MIN_SECONDS have passed, returns ms per run
+static double measure(void (*build)(char**, int), char** names, int count, HeapUse* use) {
+    size_t base = heap_live;
+    heap_start();
+    build(names, count);
+    *use = heap_stop(base);
+
+    int runs = 0;
+    double seconds;
+    clock_t start = clock();
+    do {
+        build(names, count);
+        runs++;
+        seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    } while (seconds < BENCHMARK_MIN_SECONDS);
+    return seconds * 1000 / runs;
+}
+
+static void report(const char* strategy, int count, double ms, HeapUse use) {
+    printf(
+        "%6d %-7s %10.3f ms %9zu bytes peak %7zu allocations %6.1f bytes/entry\n",
+        count,
+        strategy,
+        ms,
+        use.peak,
+        use.allocations,
+        (double)use.peak / count);
+}
+
+static void benchmark(int count) {
+    char** names = malloc(count * sizeof(char*));
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "%c%c%c-site%d", 'a' + rand() % 26, 'a' + rand() % 26, 'a' + rand() % 26, i);
+        names[i] = strdup(name);
+    }
+
+    HeapUse use;
+    report("list", count, measure(list_build, names, count, &use), use);
+    report("insert", count, measure(insert_build, names, count, &use), use);
+    report("arena", count, measure(arena_once, names, count, &use), use);
+
+    VaultIndex index = {0};
+    arena_build(&index, names, count);
+    size_t base = heap_live;
+    heap_start();
+    int runs = 0;
+    double seconds;
+    clock_t start = clock();
+    do {
+        arena_build(&index, names, count);
+        runs++;
+        seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    } while (seconds < BENCHMARK_MIN_SECONDS);
+    use = heap_stop(base);
+    use.allocations /= runs;
+    report("reload", count, seconds * 1000 / runs, use);
+
+    for (int i = 1; i < (int)index.count; i++) {
+        if (strcmp(vault_index_name(&index, i - 1), vault_index_name(&index, i)) >= 0) {
+            fprintf(stderr, "index not sorted at %d\n", i);
+            exit(1);
+        }
+    }
+    vault_index_free(&index);
+    for (int i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+int main(int argc, char** argv) {
+    static const int defaults[] = {100, 1000, 10000};
+    srand(1);
+    printf(" count strategy       time            heap peak\n");
+    if (argc < 2) {
+        for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++) {
+            benchmark(defaults[i]);
+        }
+    }
+    for (int i = 1; i < argc; i++) {
+        int count = atoi(argv[i]);
+        if (count <= 0) {
+            fprintf(stderr, "usage: %s [count ...]\n", argv[0]);
+            return 1;
+        }
+        benchmark(count);
+    }
+    return 0;
+}
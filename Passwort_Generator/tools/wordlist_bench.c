@@ -0,0 +1,181 @@
+// Builds the word index of a Diceware wordlist on the PC the same way the app does (streaming,
+// WORDLIST_CHUNK_SIZE bytes at a time) and measures how long 6-word passphrases take when every
+// word costs one seek and one read of the index file.
+//
+// Build:  cc -O2 -o wordlist_bench tools/wordlist_bench.c
+// Run:    wordlist_bench [-n words] [-p phrases] [wordlist.txt [index]]
+//   -n  size of the generated EFF-style list when no wordlist is given (default 7776)
+//   -p  passphrases to generate (default 10000)
+// Without an index path the index is written to a temporary file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../passwordgenerator_random.h"
+#include "../passwordgenerator_wordlist.h"
+
+#define WORDLIST_CHUNK_SIZE 256
+
+typedef struct {
+    FILE* file;
+    uint8_t buffer[WORDLIST_CHUNK_SIZE];
+    size_t used;
+} Writer;
+
+static uint64_t seeks;
+static uint64_t reads;
+
+static void write_record(const char* word, uint8_t length, void* context) {
+    Writer* writer = context;
+    if (writer->used + WORDLIST_RECORD_SIZE > sizeof(writer->buffer)) {
+        fwrite(writer->buffer, 1, writer->used, writer->file);
+        writer->used = 0;
+    }
+    memset(&writer->buffer[writer->used], 0, WORDLIST_RECORD_SIZE);
+    memcpy(&writer->buffer[writer->used], word, length);
+    writer->used += WORDLIST_RECORD_SIZE;
+}
+
+static void random_fill(uint8_t* buffer, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        buffer[i] = rand();
+    }
+}
+
+static double elapsed_us(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+// EFF-style list: five dice digits, a tab and a made-up word of 3 to 9 letters
+static FILE* generate_wordlist(int count) {
+    FILE* file = tmpfile();
+    for (int i = 0; i < count; i++) {
+        int dice = i;
+        char digits[6];
+        for (int d = 4; d >= 0; d--) {
+            digits[d] = '1' + dice % 6;
+            dice /= 6;
+        }
+        digits[5] = '\0';
+        int length = 3 + rand() % 7;
+        fprintf(file, "%s\t", digits);
+        for (int c = 0; c < length; c++) {
+            fputc('a' + rand() % 26, file);
+        }
+        fprintf(file, "%d\n", i);
+    }
+    rewind(file);
+    return file;
+}
+
+int main(int argc, char** argv) {
+    int generated = 7776;
+    int phrases = 10000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:")) != -1) {
+        if (opt == 'n') {
+            generated = atoi(optarg);
+        } else if (opt == 'p') {
+            phrases = atoi(optarg);
+        } else {
+            fprintf(stderr, "usage: %s [-n words] [-p phrases] [wordlist.txt [index]]\n", argv[0]);
+            return 1;
+        }
+    }
+    FILE* source = optind < argc ? fopen(argv[optind], "rb") : generate_wordlist(generated);
+    FILE* index = optind + 1 < argc ? fopen(argv[optind + 1], "w+b") : tmpfile();
+    if (!source || !index) {
+        perror("open");
+        return 1;
+    }
+
+    // Build: header without magic, records, then the final header
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    WordlistHeader header = {.count = 0};
+    fwrite(&header, sizeof(header), 1, index);
+    Writer writer = {.file = index};
+    WordlistParser parser;
+    wordlist_parser_init(&parser, write_record, &writer);
+    uint8_t chunk[WORDLIST_CHUNK_SIZE];
+    size_t length;
+    size_t source_size = 0;
+    while ((length = fread(chunk, 1, sizeof(chunk), source)) > 0) {
+        wordlist_parser_feed(&parser, chunk, length);
+        source_size += length;
+    }
+    wordlist_parser_finish(&parser);
+    fwrite(writer.buffer, 1, writer.used, index);
+    memcpy(header.magic, WORDLIST_MAGIC, sizeof(header.magic));
+    header.count = parser.words;
+    header.source_size = source_size;
+    fseek(index, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, index);
+    fflush(index);
+    double build_us = elapsed_us(&start);
+    fseek(index, 0, SEEK_END);
+    long index_size = ftell(index);
+    printf(
+        "wordlist: %zu bytes, %u words, %u too long; index: %ld bytes built in %.1f ms (%zu bytes of parser state)\n",
+        source_size,
+        parser.words,
+        parser.skipped,
+        index_size,
+        build_us / 1000,
+        sizeof(parser));
+    if (!wordlist_header_current(&header, source_size, 0, index_size)) {
+        fprintf(stderr, "index does not match its header\n");
+        return 1;
+    }
+
+    // Generate: one seek and one record read per word
+    EntropyPool pool;
+    entropy_pool_init(&pool, random_fill);
+    EntropySampler sampler;
+    entropy_sampler_init(&sampler, header.count);
+    double total_us = 0;
+    double max_us = 0;
+    char phrase[PASSPHRASE_WORDS * WORDLIST_RECORD_SIZE];
+    for (int p = 0; p < phrases; p++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        size_t used = 0;
+        for (int w = 0; w < PASSPHRASE_WORDS; w++) {
+            char word[WORDLIST_RECORD_SIZE];
+            fseek(index, wordlist_record_offset(entropy_sample(&sampler, &pool)), SEEK_SET);
+            seeks++;
+            if (fread(word, 1, WORDLIST_RECORD_SIZE, index) != WORDLIST_RECORD_SIZE) {
+                fprintf(stderr, "short read\n");
+                return 1;
+            }
+            reads++;
+            word[WORDLIST_RECORD_SIZE - 1] = '\0';
+            if (w > 0) {
+                phrase[used++] = PASSPHRASE_SEPARATOR;
+            }
+            memcpy(&phrase[used], word, strlen(word));
+            used += strlen(word);
+        }
+        phrase[used] = '\0';
+        double us = elapsed_us(&start);
+        total_us += us;
+        max_us = us > max_us ? us : max_us;
+    }
+    printf(
+        "%d passphrases of %d words: %.2f us average, %.2f us max, %.1f seeks and %.1f reads of %d bytes per phrase\n",
+        phrases,
+        PASSPHRASE_WORDS,
+        total_us / phrases,
+        max_us,
+        (double)seeks / phrases,
+        (double)reads / phrases,
+        WORDLIST_RECORD_SIZE);
+    printf("example: %s\n", phrase);
+    fclose(source);
+    fclose(index);
+    return 0;
+}